@@ -1,10 +1,5 @@
 #!/bin/sh
 
-is_process_running() {
-    local process_name="$1"
-    pgrep "$process_name" > /dev/null 2>&1
-}
-
 alert() {
     TITLE="$1"
     TEXT="$2"
@@ -17,28 +12,17 @@ alert() {
     lipc-set-prop com.lab126.pillow pillowAlert "$JSON"
 }
 
-# Check if KinAMP is running in background
-if is_process_running "KinAMP-minimal"; then
-    echo "Kinamp is running in background. Stopping it..."
-    pkill "KinAMP-minimal"
-    sleep 2
-    if is_process_running "KinAMP-minimal"; then
-        echo "Process didn't terminate gracefully. Force killing..."
-        pkill -9 "KinAMP_minimal"
-    fi
-    alert "KinAMP","Background music playback stopped"
-else
-    echo "Starting KinAMP GUI..."
-    lipc-set-prop -s com.lab126.btfd BTenable 0:1
-    sleep 1
-    cd /nmt/us/KinAMP
-    ./KinAMP
-    exit_code=$?
-    
-    # Check if exit code is 10
-    if [ $exit_code -eq 10 ]; then
-        # Pillow dialog
-        alert "KinAMP","Continuing playing music in background.<br/>Click the KinAMP booklet again to stop."
-        ./KinAMP-minimal &
-    fi
+# The GUI attaches to the playback daemon if one is already running
+# (background mode), or starts it
+echo "Starting KinAMP GUI..."
+lipc-set-prop -s com.lab126.btfd BTenable 0:1
+sleep 1
+cd /mnt/us/KinAMP
+./KinAMP
+exit_code=$?
+
+# Exit code 10: the GUI closed, the daemon keeps playing
+if [ $exit_code -eq 10 ]; then
+    # Pillow dialog
+    alert "KinAMP","Continuing playing music in background.<br/>Click the KinAMP booklet again to get back to the player."
 fi
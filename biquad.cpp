@@ -0,0 +1,100 @@
+#include "biquad.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BIQUAD_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BIQUAD_USE_SSE 1
+#endif
+
+BiquadCoeffs biquad_identity() {
+    BiquadCoeffs c = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    return c;
+}
+
+void biquad_reset(StereoBiquadState* state) {
+    state->z1[0] = state->z1[1] = 0.0f;
+    state->z2[0] = state->z2[1] = 0.0f;
+}
+
+// Denormals make IIR tails on silent passages very slow on some CPUs.
+// Flush the state once per block rather than per sample.
+static inline float flush_denormal(float v) {
+    return (v > -1e-15f && v < 1e-15f) ? 0.0f : v;
+}
+
+#if BIQUAD_USE_NEON
+void biquad_process_stereo(float* samples, size_t frames,
+                           const BiquadCoeffs& c, StereoBiquadState* state) {
+    const float32x2_t b0 = vdup_n_f32(c.b0), b1 = vdup_n_f32(c.b1), b2 = vdup_n_f32(c.b2);
+    const float32x2_t a1 = vdup_n_f32(c.a1), a2 = vdup_n_f32(c.a2);
+    float32x2_t z1 = vld1_f32(state->z1);
+    float32x2_t z2 = vld1_f32(state->z2);
+
+    for (size_t i = 0; i < frames; ++i) {
+        float32x2_t x = vld1_f32(samples);
+        float32x2_t y = vmla_f32(z1, b0, x);
+        z1 = vmls_f32(vmla_f32(z2, b1, x), a1, y);
+        z2 = vmls_f32(vmul_f32(b2, x), a2, y);
+        vst1_f32(samples, y);
+        samples += 2;
+    }
+
+    vst1_f32(state->z1, z1);
+    vst1_f32(state->z2, z2);
+    for (int ch = 0; ch < 2; ++ch) {
+        state->z1[ch] = flush_denormal(state->z1[ch]);
+        state->z2[ch] = flush_denormal(state->z2[ch]);
+    }
+}
+#elif BIQUAD_USE_SSE
+// The low two lanes carry L/R; the upper lanes are unused.
+void biquad_process_stereo(float* samples, size_t frames,
+                           const BiquadCoeffs& c, StereoBiquadState* state) {
+    const __m128 b0 = _mm_set1_ps(c.b0), b1 = _mm_set1_ps(c.b1), b2 = _mm_set1_ps(c.b2);
+    const __m128 a1 = _mm_set1_ps(c.a1), a2 = _mm_set1_ps(c.a2);
+    __m128 z1 = _mm_castpd_ps(_mm_load_sd((const double*)state->z1));
+    __m128 z2 = _mm_castpd_ps(_mm_load_sd((const double*)state->z2));
+
+    for (size_t i = 0; i < frames; ++i) {
+        __m128 x = _mm_castpd_ps(_mm_load_sd((const double*)samples));
+        __m128 y = _mm_add_ps(z1, _mm_mul_ps(b0, x));
+        z1 = _mm_sub_ps(_mm_add_ps(z2, _mm_mul_ps(b1, x)), _mm_mul_ps(a1, y));
+        z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+        _mm_store_sd((double*)samples, _mm_castps_pd(y));
+        samples += 2;
+    }
+
+    _mm_store_sd((double*)state->z1, _mm_castps_pd(z1));
+    _mm_store_sd((double*)state->z2, _mm_castps_pd(z2));
+    for (int ch = 0; ch < 2; ++ch) {
+        state->z1[ch] = flush_denormal(state->z1[ch]);
+        state->z2[ch] = flush_denormal(state->z2[ch]);
+    }
+}
+#else
+void biquad_process_stereo(float* samples, size_t frames,
+                           const BiquadCoeffs& c, StereoBiquadState* state) {
+    float z1l = state->z1[0], z1r = state->z1[1];
+    float z2l = state->z2[0], z2r = state->z2[1];
+
+    for (size_t i = 0; i < frames; ++i) {
+        float xl = samples[0], xr = samples[1];
+        float yl = c.b0 * xl + z1l;
+        float yr = c.b0 * xr + z1r;
+        z1l = c.b1 * xl - c.a1 * yl + z2l;
+        z1r = c.b1 * xr - c.a1 * yr + z2r;
+        z2l = c.b2 * xl - c.a2 * yl;
+        z2r = c.b2 * xr - c.a2 * yr;
+        samples[0] = yl;
+        samples[1] = yr;
+        samples += 2;
+    }
+
+    state->z1[0] = flush_denormal(z1l);
+    state->z1[1] = flush_denormal(z1r);
+    state->z2[0] = flush_denormal(z2l);
+    state->z2[1] = flush_denormal(z2r);
+}
+#endif
@@ -0,0 +1,29 @@
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include <stddef.h>
+
+// Normalised biquad coefficients (a0 == 1):
+//   y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]
+struct BiquadCoeffs {
+    float b0, b1, b2;
+    float a1, a2;
+};
+
+// Transposed direct form II state for one stereo biquad.
+// Index 0 is the left channel, 1 the right channel.
+struct StereoBiquadState {
+    float z1[2];
+    float z2[2];
+};
+
+BiquadCoeffs biquad_identity();
+void biquad_reset(StereoBiquadState* state);
+
+// Filter `frames` frames of interleaved stereo float PCM in place.
+// The two channels are processed together in one SIMD register
+// (NEON on ARM, SSE on x86), with a scalar fallback elsewhere.
+void biquad_process_stereo(float* samples, size_t frames,
+                           const BiquadCoeffs& coeffs, StereoBiquadState* state);
+
+#endif // BIQUAD_H
@@ -1,35 +1,80 @@
 #include <glib.h>
+#include <glib-unix.h>
 #include <gst/gst.h>
 #include <vector>
 #include <string>
 #include <algorithm>
-#include <random>
 #include <fstream>
 #include <wordexp.h>
 #include <unistd.h>
 #include <signal.h>
 #include <cstring>
 #include <memory>
+#include <unordered_set>
+#include <sys/stat.h>
 
+#include "control_socket.h"
+#include "folder_scanner.h"
+#include "library_watcher.h"
+#include "lipc_service.h"
+#include "m3u_reader.h"
 #include "music_backend.h"
+#include "playback_queue.h"
 
-// Reuse the strategy enum
-enum PlaybackStrategy {
-    NORMAL,
-    REPEAT,
-    RANDOM
+// Playback state as last read from the backend. "status" is answered
+// from this, so clients polling it never wait on GStreamer.
+struct StatusSnapshot {
+    bool valid;
+    const char* mode;       // playing, paused or stopped
+    int index;
+    gint64 position;        // ns, at `taken`
+    gint64 taken;           // g_get_monotonic_time()
+    float speed;
+    std::string filepath;
 };
 
 struct CliState {
     MusicBackend* backend;
-    std::vector<std::string> playlist;
-    int current_index;
-    PlaybackStrategy strategy;
+    PlaybackQueue queue;
     GMainLoop* loop;
     bool explicit_playlist; // True if playlist was passed as arg
+    float volume_db;
+    ReplayGainMode replaygain_mode;
+    bool loudness_scan; // Measure untagged files in the background
+    std::string eq_preset;
+    std::vector<EqPreset> eq_presets; // User presets from .kinamp.conf
+    float speed;
+    float crossfade;  // Seconds, 0 = off
+    SilenceMode silence_trim;
+    int queued_index; // Song the backend will crossfade into, -1 = none
+    bool daemon;      // Stay up when idle, waiting for control commands
+    StatusSnapshot status;
+    LipcService* lipc;        // NULL when LIPC is unavailable
+    ControlServer* control;   // NULL when the socket is unavailable
+    unsigned playlist_version; // Bumped when the playlist file is rewritten here
+    // Library watching (library_watch= in .kinamp.conf, --watch=)
+    std::vector<std::string> watch_roots;
+    LibraryWatcher* watcher;            // NULL when no folder is watched
+    FolderScanner* rescanner;
+    std::vector<std::string> rescan_pending;    // Roots waiting for a rescan
+    std::string rescan_root;                    // Being rescanned, empty = none
+    std::vector<std::string> rescan_known;      // Its files before the rescan
+    bool rescan_indexed;                        // rescan_known is from the index
+    std::vector<std::string> rescan_files;      // Its files now
+    // Folder given to "load", read in the background
+    FolderScanner* importer;
+    std::string import_folder;                  // Being read, empty = none
+    std::vector<std::string> import_files;      // Found so far
 };
 
-// Global pointer for signal handling
+// Speed change per SIGUSR1 (faster) / SIGUSR2 (slower)
+static const float SPEED_STEP = 0.25f;
+
+// Re-read the status snapshot from the backend after this long (us); in
+// between, the position is extrapolated from the clock
+static const gint64 STATUS_RESYNC = 2000000;
+
+// Global pointer for the speed signal handler
 static CliState* g_state = nullptr;
 
 // --- Helper: Expand ~ in paths ---
@@ -50,21 +95,27 @@ std::string get_config_path(const char* filename) {
     return path;
 }
 
+bool is_folder(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
 // --- Helper: Load Playlist ---
-bool load_playlist(const std::string& filepath, std::vector<std::string>& playlist) {
-    std::ifstream infile(filepath.c_str());
-    if (!infile.is_open()) return false;
-
-    std::string line;
-    while (std::getline(infile, line)) {
-        if (!line.empty()) {
-            // Basic trimming could be added here if needed
-            if (line[line.length()-1] == '\r') {
-                line.erase(line.length()-1);
-            }
-            playlist.push_back(line);
-        }
-    }
+// `path` is an M3U file, or a folder: then every music file below it, as
+// Add Folder in KinAMP does. Folders that did not change since they were
+// last scanned are taken from the library index instead of being read.
+// Waits for the whole folder: only for the command line, the "load"
+// command reads folders in the background (start_import()).
+bool load_playlist(const std::string& path, PathList* playlist) {
+    if (!is_folder(path)) return read_m3u(path.c_str(), playlist);
+
+    FolderScanner scanner;
+    scanner.set_index_path(get_config_path(".kinamp_library.idx"));
+    if (!scanner.start(path)) return false;
+    scanner.join();
+    std::vector<std::string> files;
+    scanner.take_files(&files);
+    for (size_t i = 0; i < files.size(); ++i) playlist->append(files[i].c_str());
     return true;
 }
 
@@ -76,79 +127,521 @@ void load_default_state(CliState* state) {
         std::string line;
         while (std::getline(conffile, line)) {
             if (line.find("current_index=") == 0) {
-                state->current_index = atoi(line.substr(14).c_str());
+                state->queue.set_current(atoi(line.substr(14).c_str()));
             }
             if (line.find("playback_strategy=") == 0) {
                 int strat = atoi(line.substr(18).c_str());
-                state->strategy = (PlaybackStrategy)strat;
+                state->queue.set_strategy((PlaybackStrategy)strat);
+            }
+            if (line.find("volume_db=") == 0) {
+                state->volume_db = atof(line.substr(10).c_str());
+            }
+            if (line.find("replaygain_mode=") == 0) {
+                state->replaygain_mode = (ReplayGainMode)atoi(line.substr(16).c_str());
+            }
+            if (line.find("loudness_scan=") == 0) {
+                state->loudness_scan = atoi(line.substr(14).c_str()) != 0;
+            }
+            if (line.find("eq_preset=") == 0) {
+                state->eq_preset = line.substr(10);
+            }
+            if (line.find("speed=") == 0) {
+                state->speed = atof(line.substr(6).c_str());
+            }
+            if (line.find("crossfade=") == 0) {
+                state->crossfade = atof(line.substr(10).c_str());
+            }
+            if (line.find("silence_trim=") == 0) {
+                state->silence_trim = (SilenceMode)atoi(line.substr(13).c_str());
+            }
+            if (line.find("library_watch=") == 0) {
+                state->watch_roots.push_back(line.substr(14));
+            }
+            EqPreset preset;
+            if (eq_parse_preset_line(line, &preset)) {
+                state->eq_presets.push_back(preset);
             }
         }
         conffile.close();
     }
 }
 
+// Tell the backend what comes next so it can crossfade into it
+void queue_next(CliState* state) {
+    state->queued_index = state->backend->get_crossfade() > 0.0f ? state->queue.peek_next() : -1;
+    state->backend->queue_next_file(state->queued_index >= 0 ? state->queue.get_path(state->queued_index) : NULL);
+}
+
 // --- Logic: Play Next ---
+void play_index(CliState* state, int index, uint64_t start_frame) {
+    state->queue.set_current(index);
+    state->status.valid = false;
+    std::string file = state->queue.get_path(index);
+    g_print("Playing [%d/%d]: %s\n", index + 1, state->queue.size(), file.c_str());
+    state->backend->play_file(file.c_str(), start_frame);
+    queue_next(state);
+}
+
 void play_next(CliState* state) {
-    if (state->playlist.empty()) {
+    if (state->queue.empty()) {
         g_print("Playlist is empty.\n");
-        g_main_loop_quit(state->loop);
+        if (!state->daemon) g_main_loop_quit(state->loop);
         return;
     }
 
-    int next_index = -1;
-
-    switch (state->strategy) {
-        case NORMAL:
-            if (state->current_index + 1 < (int)state->playlist.size()) {
-                next_index = state->current_index + 1;
-            } else {
-                // End of playlist
-                g_print("End of playlist reached.\n");
-                g_main_loop_quit(state->loop);
-                return;
-            }
-            break;
-        case REPEAT:
-            if (state->current_index + 1 < (int)state->playlist.size()) {
-                next_index = state->current_index + 1;
-            } else {
-                // Loop back to start
-                next_index = 0;
-            }
-            break;
-        case RANDOM: {
-            // Simple random pick
-            std::random_device rd;
-            std::mt19937 gen(rd());
-            std::uniform_int_distribution<> distrib(0, state->playlist.size() - 1);
-            next_index = distrib(gen);
-            break;
-        }
+    // The track queued for crossfading, if any
+    int next_index = state->queue.peek_next();
+    if (next_index < 0) {
+        // End of playlist; the daemon waits for its clients
+        g_print("End of playlist reached.\n");
+        if (!state->daemon) g_main_loop_quit(state->loop);
+        return;
     }
 
-    if (next_index >= 0) {
-        state->current_index = next_index;
-        std::string file = state->playlist[next_index];
-        g_print("Playing [%d/%zu]: %s\n", next_index + 1, state->playlist.size(), file.c_str());
-        state->backend->play_file(file.c_str());
+    play_index(state, next_index, 0);
+}
+
+std::string status_reply(CliState* state);
+bool start_import(CliState* state, const std::string& folder);
+void stop_import(CliState* state);
+
+// Make `playlist` the one to play from, keeping the current song's index
+// valid if it is still listed
+void replace_playlist(CliState* state, PathList& playlist) {
+    state->queue.replace(playlist);
+    if (state->loudness_scan) state->backend->start_loudness_scan(state->queue.get_tracks());
+    if (state->backend->is_playing) queue_next(state);
+    state->status.valid = false;
+}
+
+// Tell subscribed clients and LIPC listeners about state changes
+void announce_status(CliState* state) {
+    std::string reply = status_reply(state);
+    if (state->control) {
+        state->control->broadcast("EVENT" + reply.substr(2));
+    }
+    PlayerStatus status;
+    if (state->lipc && parse_player_status(reply, &status)) {
+        state->lipc->update(status);
     }
 }
 
 // --- Callback: End Of Stream ---
 void on_eos_callback(void* user_data) {
     CliState* state = (CliState*)user_data;
+    state->status.valid = false;
     // Backend has already stopped playback of current track.
     // Trigger next song.
     play_next(state);
+    announce_status(state);
+}
+
+// --- Callback: Crossfaded into the queued song ---
+void on_track_change_callback(const char* filepath, void* user_data) {
+    CliState* state = (CliState*)user_data;
+    state->status.valid = false;
+    if (state->queued_index >= 0) {
+        state->queue.set_current(state->queued_index);
+    }
+    g_print("Playing [%d/%d]: %s\n", state->queue.get_current() + 1, state->queue.size(), filepath);
+    queue_next(state);
+    announce_status(state);
+}
+
+// --- Control Socket ---
+void refresh_status(CliState* state) {
+    MusicBackend* backend = state->backend;
+    StatusSnapshot& status = state->status;
+    status.mode = backend->is_paused ? "paused" : (backend->is_playing ? "playing" : "stopped");
+    status.index = state->queue.get_current();
+    status.position = backend->get_position();
+    status.taken = g_get_monotonic_time();
+    status.speed = backend->get_speed();
+    status.filepath = backend->is_playing ? backend->get_current_filepath() : "";
+    status.valid = true;
+}
+
+std::string status_reply(CliState* state) {
+    StatusSnapshot& status = state->status;
+    gint64 now = g_get_monotonic_time();
+    if (!status.valid || now - status.taken > STATUS_RESYNC) {
+        refresh_status(state);
+    }
+
+    gint64 position = status.position;
+    if (strcmp(status.mode, "playing") == 0) {
+        position += (gint64)((now - status.taken) * 1000 * (double)status.speed);
+    }
+    char reply[160];
+    snprintf(reply, sizeof(reply), "OK state=%s index=%d position=%lld speed=%.2f playlist=%u file=", status.mode,
+             status.index, (long long)(position / GST_MSECOND), status.speed, state->playlist_version);
+    return std::string(reply) + status.filepath;
+}
+
+std::string run_control_command(CliState* state, const std::string& line) {
+    MusicBackend* backend = state->backend;
+
+    size_t space = line.find(' ');
+    std::string command = line.substr(0, space);
+    std::string arg = space != std::string::npos ? line.substr(space + 1) : "";
+
+    if (command == "status") {
+        return status_reply(state);
+    }
+    // Anything else may change what status reports
+    state->status.valid = false;
+
+    if (command == "seek") {
+        if (!backend->is_playing) return "ERR not playing";
+        char* end;
+        double seconds = strtod(arg.c_str(), &end);
+        if (end == arg.c_str()) return "ERR bad position";
+        gint64 position = (gint64)(seconds * GST_SECOND);
+        if (arg[0] == '+' || arg[0] == '-') position += backend->get_position();
+        backend->seek(position);
+        queue_next(state);
+        return "OK";
+    }
+    if (command == "play") {
+        // "play resume" leaves a playing song alone
+        if (arg == "resume" && backend->is_playing && !backend->is_paused) return "OK";
+        if ((arg.empty() || arg == "resume") && backend->is_paused) {
+            backend->pause();
+            return "OK";
+        }
+        char resume[8] = "";
+        int index = state->queue.get_current();
+        if (arg == "resume") {
+            strcpy(resume, "resume");
+        } else if (!arg.empty()) {
+            sscanf(arg.c_str(), "%d %7s", &index, resume);
+        }
+        if (index < 0) index = 0;
+        if (index >= state->queue.size()) return "ERR no such song";
+        const char* file = state->queue.get_path(index);
+        play_index(state, index, strcmp(resume, "resume") == 0 ? backend->get_resume_frame(file) : 0);
+        return "OK";
+    }
+    if (command == "pause") {
+        backend->pause();
+        return "OK";
+    }
+    if (command == "stop") {
+        backend->stop();
+        return "OK";
+    }
+    if (command == "next") {
+        play_next(state);
+        return "OK";
+    }
+    if (command == "prev") {
+        if (state->queue.get_current() > 0) play_index(state, state->queue.get_current() - 1, 0);
+        return "OK";
+    }
+    if (command == "load") {
+        // A folder can take minutes to read the first time: its songs
+        // replace the playlist once it is done, with a new playlist version
+        if (is_folder(arg)) {
+            return start_import(state, arg) ? "OK" : "ERR cannot read folder";
+        }
+        PathList playlist;
+        if (!read_m3u(arg.c_str(), &playlist)) return "ERR cannot read playlist";
+        // The last load wins
+        stop_import(state);
+        replace_playlist(state, playlist);
+        return "OK";
+    }
+    if (command == "strategy") {
+        if (arg == "repeat") state->queue.set_strategy(REPEAT);
+        else if (arg == "shuffle") state->queue.set_strategy(RANDOM);
+        else state->queue.set_strategy(NORMAL);
+        if (backend->is_playing) queue_next(state);
+        return "OK";
+    }
+    if (command == "volume") {
+        if (arg.empty()) {
+            char reply[32];
+            snprintf(reply, sizeof(reply), "OK %.1f", backend->get_volume_db());
+            return reply;
+        }
+        backend->set_volume_db(atof(arg.c_str()));
+        return "OK";
+    }
+    if (command == "speed") {
+        backend->set_speed(atof(arg.c_str()));
+        return "OK";
+    }
+    if (command == "crossfade") {
+        backend->set_crossfade(atof(arg.c_str()));
+        if (backend->is_playing) queue_next(state);
+        return "OK";
+    }
+    if (command == "replaygain") {
+        if (arg == "off") backend->set_replaygain_mode(REPLAYGAIN_OFF);
+        else if (arg == "album") backend->set_replaygain_mode(REPLAYGAIN_ALBUM);
+        else backend->set_replaygain_mode(REPLAYGAIN_TRACK);
+        return "OK";
+    }
+    if (command == "silence") {
+        if (arg == "edges") backend->set_silence_trim(SILENCE_EDGES);
+        else if (arg == "speech") backend->set_silence_trim(SILENCE_SPEECH);
+        else backend->set_silence_trim(SILENCE_OFF);
+        return "OK";
+    }
+    if (command == "eq") {
+        EqPreset preset;
+        if (!arg.empty() && !eq_parse_preset_line(arg, &preset)) return "ERR bad preset";
+        backend->set_eq_bands(preset.bands);
+        return "OK";
+    }
+    if (command == "powersave") {
+        backend->set_low_power(atoi(arg.c_str()) != 0);
+        return "OK";
+    }
+    if (command == "scan") {
+        state->loudness_scan = atoi(arg.c_str()) != 0;
+        if (state->loudness_scan) {
+            backend->start_loudness_scan(state->queue.get_tracks());
+        } else {
+            backend->stop_loudness_scan();
+        }
+        return "OK";
+    }
+    if (command == "quit") {
+        backend->stop();
+        g_main_loop_quit(state->loop);
+        return "OK";
+    }
+    return "ERR unknown command";
+}
+
+// Shared by the control socket and the LIPC service
+std::string handle_control_command(const std::string& line, void* user_data) {
+    CliState* state = (CliState*)user_data;
+    std::string reply = run_control_command(state, line);
+    if (line != "status") announce_status(state);
+    return reply;
+}
+
+// --- Library Watching ---
+// Watched folders are kept in sync with the playlist: files deleted from
+// them leave the playlist before playback gets to them, and files added to
+// a folder the playlist already plays from are appended. A change is
+// picked up by rescanning the folder's root with the library index, so
+// only the folders that changed are read, and diffing the files before
+// and after.
+
+// Write the daemon's playlist where KinAMP reads it, atomically, so the
+// GUI never sees half of it
+bool write_default_playlist(CliState* state) {
+    std::string path = get_config_path(".kinamp_playlist.m3u");
+    std::string tmp_path = path + ".tmp";
+    std::ofstream outfile(tmp_path.c_str());
+    if (!outfile.is_open()) return false;
+    const PathList& tracks = state->queue.get_tracks();
+    for (int i = 0; i < tracks.size(); ++i) {
+        outfile << tracks.get(i) << '\n';
+    }
+    outfile.close();
+    if (outfile.fail() || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        perror("Library: Failed to write playlist");
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Drop the playlist entries below the rescanned root that are gone, and
+// append its new files if the playlist already plays from there
+void apply_rescan(CliState* state) {
+    const std::string& root = state->rescan_root;
+    std::string prefix = root + "/";
+    std::unordered_set<std::string> found(state->rescan_files.begin(), state->rescan_files.end());
+
+    const PathList& tracks = state->queue.get_tracks();
+    PathList updated;
+    std::vector<int> new_index(tracks.size(), -1);
+    std::unordered_set<std::string> listed;
+    int below_root = 0;
+    int removed = 0;
+    for (int i = 0; i < tracks.size(); ++i) {
+        const char* path = tracks.get(i);
+        if (strncmp(path, prefix.c_str(), prefix.size()) == 0) {
+            ++below_root;
+            if (!found.count(path)) {
+                g_print("Library: Removed %s\n", path);
+                ++removed;
+                continue;
+            }
+            listed.insert(path);
+        }
+        new_index[i] = updated.size();
+        updated.append(path);
+    }
+
+    // New means unknown to the index before; a first scan of the root
+    // knows nothing, and must not add the whole folder
+    int added = 0;
+    if (below_root > 0 && state->rescan_indexed) {
+        std::unordered_set<std::string> known(state->rescan_known.begin(), state->rescan_known.end());
+        for (size_t i = 0; i < state->rescan_files.size(); ++i) {
+            const std::string& path = state->rescan_files[i];
+            if (known.count(path) || listed.count(path)) continue;
+            g_print("Library: Added %s\n", path.c_str());
+            updated.append(path.c_str());
+            ++added;
+        }
+    }
+    if (removed == 0 && added == 0) return;
+
+    // Stay on the current song; if it went, playback goes on with the
+    // next one that is left
+    int current = state->queue.get_current();
+    int mapped = -1;
+    if (current >= 0 && current < tracks.size()) {
+        for (int i = current; i < tracks.size() && mapped < 0; ++i) {
+            if (new_index[i] >= 0) mapped = i == current ? new_index[i] : new_index[i] - 1;
+        }
+        if (mapped < 0) mapped = updated.size() - added - 1;
+    }
+    state->queue.replace(updated);
+    state->queue.set_current(mapped);
+    g_print("Library: %s: %d removed, %d added, %d songs\n", root.c_str(), removed, added, state->queue.size());
+
+    if (!state->explicit_playlist && write_default_playlist(state)) {
+        ++state->playlist_version;
+    }
+    if (state->loudness_scan) state->backend->start_loudness_scan(state->queue.get_tracks());
+    if (state->backend->is_playing) queue_next(state);
+    state->status.valid = false;
+    announce_status(state);
+}
+
+void start_rescan(CliState* state);
+
+// Collect the rescan's files on the main loop; once it is done, apply it
+// and watch the folders it found
+gboolean rescan_idle_cb(gpointer data) {
+    CliState* state = (CliState*)data;
+    if (state->rescan_root.empty()) return FALSE;
+    bool done = !state->rescanner->is_running();
+    state->rescanner->take_files(&state->rescan_files);
+    if (!done) return FALSE;
+    state->rescanner->join();
+
+    // Unmounted during the scan: nothing was really deleted
+    if (is_folder(state->rescan_root)) apply_rescan(state);
+    LibraryIndex index;
+    index.open(get_config_path(".kinamp_library.idx"));
+    state->watcher->watch_tree(index, state->rescan_root);
+
+    state->rescan_root.clear();
+    state->rescan_known.clear();
+    state->rescan_files.clear();
+    start_rescan(state);
+    return FALSE;
+}
+
+// Scan thread
+void on_rescan_progress(void* user_data) {
+    g_idle_add(rescan_idle_cb, user_data);
+}
+
+void start_rescan(CliState* state) {
+    while (state->rescan_root.empty() && !state->rescan_pending.empty()) {
+        std::string root = state->rescan_pending.front();
+        state->rescan_pending.erase(state->rescan_pending.begin());
+        // A missing root is reported again when it comes back
+        if (!is_folder(root)) continue;
+
+        LibraryIndex index;
+        index.open(get_config_path(".kinamp_library.idx"));
+        state->rescan_known.clear();
+        state->rescan_files.clear();
+        state->rescan_indexed = index.list_tree(root, NULL, &state->rescan_known);
+        index.close();
+        if (state->rescanner->start(root)) state->rescan_root = root;
+    }
+}
+
+void on_library_changed(const std::string& path, void* user_data) {
+    CliState* state = (CliState*)user_data;
+    std::string root = path;
+    while (root.size() > 1 && root[root.size() - 1] == '/') root.erase(root.size() - 1);
+    std::vector<std::string>& pending = state->rescan_pending;
+    if (std::find(pending.begin(), pending.end(), root) == pending.end()) pending.push_back(root);
+    start_rescan(state);
+}
+
+// --- Folder Import ---
+// "load <folder>" reads the folder on a FolderScanner thread, like the
+// rescans above, so the daemon keeps answering its clients meanwhile.
+
+// Collect the import's files on the main loop; once it is done, they
+// become the playlist
+gboolean import_idle_cb(gpointer data) {
+    CliState* state = (CliState*)data;
+    if (state->import_folder.empty()) return FALSE;
+    bool done = !state->importer->is_running();
+    state->importer->take_files(&state->import_files);
+    if (!done) return FALSE;
+    state->importer->join();
+
+    PathList playlist;
+    for (size_t i = 0; i < state->import_files.size(); ++i) {
+        playlist.append(state->import_files[i].c_str());
+    }
+    g_print("Loaded %s: %d songs\n", state->import_folder.c_str(), playlist.size());
+    state->import_folder.clear();
+    state->import_files.clear();
+    replace_playlist(state, playlist);
+
+    // Clients only learn about it from the playlist file
+    if (!state->explicit_playlist && write_default_playlist(state)) {
+        ++state->playlist_version;
+    }
+    announce_status(state);
+    return FALSE;
+}
+
+// Scan thread
+void on_import_progress(void* user_data) {
+    g_idle_add(import_idle_cb, user_data);
+}
+
+bool start_import(CliState* state, const std::string& folder) {
+    stop_import(state);
+    if (!state->importer->start(folder)) return false;
+    state->import_folder = folder;
+    return true;
+}
+
+void stop_import(CliState* state) {
+    if (state->import_folder.empty()) return;
+    state->importer->stop();
+    state->import_folder.clear();
+    state->import_files.clear();
 }
 
 // --- Signal Handler ---
-void handle_sigint(int sig) {
-    (void)sig;
+// SIGINT and SIGTERM (pkill) arrive here through the main loop, not in
+// signal context: stopping locks the backend, joins the decoder thread and
+// writes the resume point. The caches are saved once main() leaves the loop.
+gboolean on_stop_signal(gpointer data) {
+    CliState* state = (CliState*)data;
+    g_print("\nStopping...\n");
+    state->backend->stop();
+    g_main_loop_quit(state->loop);
+    return TRUE;
+}
+
+// SIGUSR1/SIGUSR2 change the speed of the running track, e.g.
+// `pkill -USR1 KinAMP-minimal`. Only touches an atomic, so it is
+// safe in signal context.
+void handle_speed_signal(int sig) {
     if (g_state) {
-        g_print("\nStopping...\n");
-        g_state->backend->stop();
-        g_main_loop_quit(g_state->loop);
+        float speed = g_state->backend->get_speed();
+        g_state->backend->set_speed(sig == SIGUSR1 ? speed + SPEED_STEP : speed - SPEED_STEP);
     }
 }
 
@@ -161,23 +654,80 @@ int main(int argc, char* argv[]) {
     CliState state;
     state.backend = &backend;
     state.loop = loop;
-    state.current_index = -1;
-    state.strategy = NORMAL; // Default
     state.explicit_playlist = false;
+    state.volume_db = 0.0f;
+    state.replaygain_mode = REPLAYGAIN_TRACK;
+    state.loudness_scan = false;
+    state.speed = 1.0f;
+    state.crossfade = 0.0f;
+    state.silence_trim = SILENCE_OFF;
+    state.queued_index = -1;
+    state.daemon = false;
+    state.status.valid = false;
+    state.lipc = NULL;
+    state.control = NULL;
+    state.playlist_version = 0;
+    state.watcher = NULL;
+    state.rescanner = NULL;
+    state.rescan_indexed = false;
+    state.importer = NULL;
     g_state = &state;
 
     // 2. Parse Arguments
     std::string playlist_arg;
     bool strategy_overridden = false;
+    bool volume_overridden = false;
+    bool replaygain_overridden = false;
+    bool eq_overridden = false;
+    bool speed_overridden = false;
+    bool crossfade_overridden = false;
+    bool silence_overridden = false;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--repeat") {
-            state.strategy = REPEAT;
+            state.queue.set_strategy(REPEAT);
             strategy_overridden = true;
         } else if (arg == "--shuffle") {
-            state.strategy = RANDOM;
+            state.queue.set_strategy(RANDOM);
             strategy_overridden = true;
+        } else if (arg.find("--volume=") == 0) {
+            // Volume in dB, e.g. --volume=-12 or --volume=+6 (pre-amp)
+            state.volume_db = atof(arg.substr(9).c_str());
+            volume_overridden = true;
+        } else if (arg.find("--replaygain=") == 0) {
+            std::string mode = arg.substr(13);
+            if (mode == "off") state.replaygain_mode = REPLAYGAIN_OFF;
+            else if (mode == "album") state.replaygain_mode = REPLAYGAIN_ALBUM;
+            else state.replaygain_mode = REPLAYGAIN_TRACK;
+            replaygain_overridden = true;
+        } else if (arg.find("--eq=") == 0) {
+            // Preset name, e.g. --eq="BT headset"; --eq=Flat turns it off
+            state.eq_preset = arg.substr(5);
+            eq_overridden = true;
+        } else if (arg.find("--speed=") == 0) {
+            // Playback speed, e.g. --speed=1.5 (pitch is preserved)
+            state.speed = atof(arg.substr(8).c_str());
+            speed_overridden = true;
+        } else if (arg.find("--crossfade=") == 0) {
+            // Crossfade length in seconds (1-12), --crossfade=0 turns it off
+            state.crossfade = atof(arg.substr(12).c_str());
+            crossfade_overridden = true;
+        } else if (arg.find("--trim-silence=") == 0) {
+            // off, edges (start/end of tracks) or speech (also long pauses)
+            std::string mode = arg.substr(15);
+            if (mode == "edges") state.silence_trim = SILENCE_EDGES;
+            else if (mode == "speech") state.silence_trim = SILENCE_SPEECH;
+            else state.silence_trim = SILENCE_OFF;
+            silence_overridden = true;
+        } else if (arg == "--scan") {
+            state.loudness_scan = true;
+        } else if (arg.find("--watch=") == 0) {
+            // Music folder to keep the playlist in sync with; repeatable
+            state.watch_roots.push_back(arg.substr(8));
+        } else if (arg == "--daemon") {
+            // Long-lived backend for KinAMP, controlled over CONTROL_SOCKET_PATH
+            state.daemon = true;
         } else if (arg[0] != '-') {
             playlist_arg = arg;
             state.explicit_playlist = true;
@@ -185,59 +735,180 @@ int main(int argc, char* argv[]) {
     }
 
     // 3. Load Configuration/Playlist
+    PathList playlist;
+    int saved_index = -1;   // Playlist index saved by the last session
     if (state.explicit_playlist) {
-        if (!load_playlist(playlist_arg, state.playlist)) {
+        if (!load_playlist(playlist_arg, &playlist)) {
             g_printerr("Error: Could not load playlist '%s'\n", playlist_arg.c_str());
             return 1;
         }
         // When explicit playlist is used, start from 0 unless logic changes.
-        state.current_index = -1; 
+        state.queue.replace(playlist);
     } else {
         // Load default config
         std::string default_pl = get_config_path(".kinamp_playlist.m3u");
-        if (!load_playlist(default_pl, state.playlist)) {
+        if (!read_m3u(default_pl.c_str(), &playlist) && !state.daemon) {
             g_printerr("Error: Could not load default playlist '%s'\n", default_pl.c_str());
             return 1;
         }
+        state.queue.replace(playlist);
         
         // Load previous state (index, strategy)
         // Only load strategy if not overridden by CLI flags
         CliState saved_state;
-        saved_state.current_index = 0;
-        saved_state.strategy = NORMAL;
+        saved_state.queue.set_current(0);
+        saved_state.volume_db = 0.0f;
+        saved_state.replaygain_mode = REPLAYGAIN_TRACK;
+        saved_state.loudness_scan = false;
+        saved_state.speed = 1.0f;
+        saved_state.crossfade = 0.0f;
+        saved_state.silence_trim = SILENCE_OFF;
         load_default_state(&saved_state);
 
-        state.current_index = saved_state.current_index - 1; // -1 because play_next increments
+        saved_index = saved_state.queue.get_current();
+        state.queue.set_current(saved_index - 1); // -1 because play_next moves on
         if (!strategy_overridden) {
-            state.strategy = saved_state.strategy;
+            state.queue.set_strategy(saved_state.queue.get_strategy());
+        }
+        if (!volume_overridden) {
+            state.volume_db = saved_state.volume_db;
+        }
+        if (!replaygain_overridden) {
+            state.replaygain_mode = saved_state.replaygain_mode;
+        }
+        state.loudness_scan = state.loudness_scan || saved_state.loudness_scan;
+        if (!eq_overridden) {
+            state.eq_preset = saved_state.eq_preset;
+        }
+        state.eq_presets = saved_state.eq_presets;
+        if (!speed_overridden) {
+            state.speed = saved_state.speed;
+        }
+        if (!crossfade_overridden) {
+            state.crossfade = saved_state.crossfade;
+        }
+        if (!silence_overridden) {
+            state.silence_trim = saved_state.silence_trim;
         }
+        state.watch_roots.insert(state.watch_roots.end(), saved_state.watch_roots.begin(),
+                                 saved_state.watch_roots.end());
     }
 
-    if (state.playlist.empty()) {
+    if (state.queue.empty() && !state.daemon) {
         g_printerr("Error: Playlist is empty.\n");
         return 1;
     }
 
+    // The daemon is useless without its socket; a plain CLI run just
+    // cannot be remote controlled if another instance holds it
+    ControlServer control;
+    if (state.daemon) {
+        // Outlive the GUI that spawned us
+        setsid();
+    }
+    if (control.start(CONTROL_SOCKET_PATH, handle_control_command, &state)) {
+        state.control = &control;
+    } else {
+        if (state.daemon) return 1;
+        g_printerr("Warning: Control socket unavailable\n");
+    }
+    LipcService lipc;
+    if (lipc.open(LIPC_SERVICE_NAME, handle_control_command, &state)) {
+        state.lipc = &lipc;
+    }
+
     // 4. Setup Signal Handling
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = handle_sigint;
-    sigaction(SIGINT, &sa, NULL);
+    g_unix_signal_add(SIGINT, on_stop_signal, &state);
+    g_unix_signal_add(SIGTERM, on_stop_signal, &state); // Let pkill flush caches on the way out
+
+    struct sigaction speed_sa;
+    memset(&speed_sa, 0, sizeof(speed_sa));
+    speed_sa.sa_handler = handle_speed_signal;
+    sigaction(SIGUSR1, &speed_sa, NULL);
+    sigaction(SIGUSR2, &speed_sa, NULL);
 
     // 5. Start Playback
     backend.set_eos_callback(on_eos_callback, &state);
+    backend.set_track_change_callback(on_track_change_callback, &state);
+    backend.set_crossfade(state.crossfade);
+    backend.set_volume_db(state.volume_db);
+    backend.set_replaygain_mode(state.replaygain_mode);
+    backend.set_speed(state.speed);
+    const EqPreset* eq_preset = eq_find_preset(state.eq_presets, state.eq_preset);
+    if (eq_preset) {
+        backend.set_eq_bands(eq_preset->bands);
+    } else if (!state.eq_preset.empty()) {
+        g_printerr("Warning: Unknown EQ preset '%s'\n", state.eq_preset.c_str());
+    }
+    backend.open_gain_cache(get_config_path(".kinamp_gain.cache"));
+    backend.open_silence_cache(get_config_path(".kinamp_silence.cache"));
+    backend.open_resume_file(get_config_path(".kinamp_resume"));
+    backend.set_silence_trim(state.silence_trim);
+    if (state.loudness_scan) {
+        backend.start_loudness_scan(state.queue.get_tracks());
+    }
 
     g_print("KinAMP-minimal started.\n");
-    g_print("Playlist size: %zu\n", state.playlist.size());
-    g_print("Strategy: %s\n", state.strategy == NORMAL ? "Normal" : (state.strategy == REPEAT ? "Repeat" : "Shuffle"));
+    PlaybackStrategy strategy = state.queue.get_strategy();
+    g_print("Playlist size: %d\n", state.queue.size());
+    g_print("Strategy: %s\n", strategy == NORMAL ? "Normal" : (strategy == REPEAT ? "Repeat" : "Shuffle"));
+    g_print("Volume: %+.1f dB\n", backend.get_volume_db());
+    g_print("Speed: %.2fx\n", backend.get_speed());
+    if (backend.get_crossfade() > 0.0f) {
+        g_print("Crossfade: %.0f s\n", backend.get_crossfade());
+    } else {
+        g_print("Crossfade: Off\n");
+    }
+    static const char* SILENCE_NAMES[] = { "Off", "Edges", "Speech" };
+    g_print("Silence trim: %s\n", SILENCE_NAMES[backend.get_silence_trim()]);
+    g_print("EQ: %s\n", eq_preset ? eq_preset->name.c_str() : "Flat");
+
+    // Kick off the first song: where the last session (GUI or CLI) left
+    // off if that file is in the playlist. The daemon waits to be told.
+    std::string resume_file = backend.get_resume_filepath();
+    int resume_index = resume_file.empty() ? -1 : state.queue.find(resume_file, saved_index);
+    if (state.daemon) {
+        if (resume_index >= 0) state.queue.set_current(resume_index);
+    } else if (resume_index >= 0) {
+        play_index(&state, resume_index, backend.get_resume_frame(resume_file.c_str()));
+    } else {
+        play_next(&state);
+    }
+
+    announce_status(&state);
 
-    // Kick off the first song
-    play_next(&state);
+    FolderScanner importer;
+    importer.set_index_path(get_config_path(".kinamp_library.idx"));
+    importer.set_callback(on_import_progress, &state);
+    state.importer = &importer;
+
+    // Follow the library folders; the first rescan catches up with what
+    // changed while we were not running
+    LibraryWatcher watcher;
+    FolderScanner rescanner;
+    if (!state.watch_roots.empty()) {
+        rescanner.set_index_path(get_config_path(".kinamp_library.idx"));
+        rescanner.set_callback(on_rescan_progress, &state);
+        state.rescanner = &rescanner;
+        if (watcher.start(state.watch_roots, on_library_changed, &state)) {
+            state.watcher = &watcher;
+            for (size_t i = 0; i < state.watch_roots.size(); ++i) {
+                on_library_changed(state.watch_roots[i], &state);
+            }
+        }
+    }
 
     // 6. Run Loop
     g_main_loop_run(loop);
 
     // 7. Cleanup
+    importer.stop();
+    rescanner.stop();
+    watcher.stop();
+    state.control = NULL;
+    control.stop();
+    state.lipc = NULL;
+    lipc.close();
     g_main_loop_unref(loop);
     
     return 0;
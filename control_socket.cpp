@@ -0,0 +1,408 @@
+#include "control_socket.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// Longest command line accepted; a playlist path fits easily
+static const size_t MAX_LINE = 8192;
+
+// Reply timeout for clients
+static const int REQUEST_TIMEOUT_MS = 1000;
+
+static bool make_address(const char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) return false;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+// Write all of `data`; false if the peer went away
+static bool write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// =================================================================================
+// ControlServer Implementation
+// =================================================================================
+
+GSourceFuncs ControlServer::source_funcs = {
+    ControlServer::source_prepare,
+    ControlServer::source_check,
+    ControlServer::source_dispatch,
+    NULL,
+    NULL,
+    NULL
+};
+
+ControlServer::ControlServer()
+    : source(NULL), callback(NULL), user_data(NULL)
+{
+    listen_poll.fd = -1;
+    listen_poll.events = G_IO_IN;
+    listen_poll.revents = 0;
+}
+
+ControlServer::~ControlServer() {
+    stop();
+}
+
+bool ControlServer::start(const char* path, ControlCommandCallback cb, void* data) {
+    struct sockaddr_un addr;
+    if (!make_address(path, &addr)) return false;
+
+    // A socket file nobody answers on is left over from a crash
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0) {
+        bool alive = ::connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        close(probe);
+        if (alive) {
+            g_printerr("Control: %s is already served by another process\n", path);
+            return false;
+        }
+    }
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+        perror("Control: Failed to listen");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    socket_path = path;
+    callback = cb;
+    user_data = data;
+    listen_poll.fd = fd;
+    listen_poll.revents = 0;
+
+    source = (Source*)g_source_new(&source_funcs, sizeof(Source));
+    source->server = this;
+    g_source_add_poll(&source->base, &listen_poll);
+    g_source_attach(&source->base, NULL);
+    g_print("Control: Listening on %s\n", path);
+    return true;
+}
+
+void ControlServer::stop() {
+    while (!clients.empty()) {
+        close_client(clients.back());
+    }
+    if (source) {
+        g_source_remove_poll(&source->base, &listen_poll);
+        g_source_destroy(&source->base);
+        g_source_unref(&source->base);
+        source = NULL;
+    }
+    if (listen_poll.fd >= 0) {
+        close(listen_poll.fd);
+        listen_poll.fd = -1;
+        unlink(socket_path.c_str());
+    }
+}
+
+void ControlServer::accept_client() {
+    int fd = accept(listen_poll.fd, NULL, NULL);
+    if (fd < 0) return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    Client* client = new Client();
+    client->poll.fd = fd;
+    client->poll.events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+    client->poll.revents = 0;
+    client->subscribed = false;
+    client->dead = false;
+    g_source_add_poll(&source->base, &client->poll);
+    clients.push_back(client);
+}
+
+void ControlServer::close_client(Client* client) {
+    clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+    g_source_remove_poll(&source->base, &client->poll);
+    close(client->poll.fd);
+    delete client;
+}
+
+// Run all complete command lines the client has sent; false = drop it
+bool ControlServer::serve_client(Client* client) {
+    char buf[1024];
+    ssize_t n = read(client->poll.fd, buf, sizeof(buf));
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return true;
+    if (n <= 0) return false;
+    client->input.append(buf, n);
+
+    std::string replies;
+    size_t start = 0, end;
+    while ((end = client->input.find('\n', start)) != std::string::npos) {
+        std::string command = client->input.substr(start, end - start);
+        start = end + 1;
+        if (!command.empty() && command[command.size() - 1] == '\r') command.erase(command.size() - 1);
+        if (command.empty()) continue;
+
+        if (command == "subscribe") {
+            // Start the stream with the current state
+            client->subscribed = true;
+            replies += "OK\n";
+            std::string status = callback("status", user_data);
+            if (status.compare(0, 3, "OK ") == 0) replies += "EVENT" + status.substr(2) + '\n';
+            continue;
+        }
+        replies += callback(command, user_data);
+        replies += '\n';
+        // The command's events may have found the client gone
+        if (client->dead) return false;
+    }
+    client->input.erase(0, start);
+
+    // Replies are a few dozen bytes: a client whose socket buffer is full
+    // is not reading them and gets dropped rather than queued for
+    if (!replies.empty() && !write_all(client->poll.fd, replies.data(), replies.size())) return false;
+    if (client->input.size() > MAX_LINE) {
+        g_printerr("Control: Command too long, dropping client\n");
+        return false;
+    }
+    return true;
+}
+
+void ControlServer::broadcast(const std::string& line) {
+    std::string data = line + '\n';
+    for (size_t i = 0; i < clients.size(); ++i) {
+        Client* client = clients[i];
+        if (!client->subscribed || client->dead) continue;
+        if (!write_all(client->poll.fd, data.data(), data.size())) client->dead = true;
+    }
+}
+
+void ControlServer::close_dead_clients() {
+    std::vector<Client*> gone;
+    for (size_t i = 0; i < clients.size(); ++i) {
+        if (clients[i]->dead) gone.push_back(clients[i]);
+    }
+    for (size_t i = 0; i < gone.size(); ++i) {
+        close_client(gone[i]);
+    }
+}
+
+void ControlServer::dispatch() {
+    // Commands may stop() the server (quit); work on a copy
+    std::vector<Client*> ready;
+    for (size_t i = 0; i < clients.size(); ++i) {
+        if (clients[i]->poll.revents) ready.push_back(clients[i]);
+    }
+    bool incoming = listen_poll.revents & G_IO_IN;
+    listen_poll.revents = 0;
+
+    for (size_t i = 0; i < ready.size(); ++i) {
+        if (std::find(clients.begin(), clients.end(), ready[i]) == clients.end()) continue;
+        ready[i]->poll.revents = 0;
+        if (ready[i]->dead) continue;
+        if (!serve_client(ready[i])) ready[i]->dead = true;
+    }
+    close_dead_clients();
+    if (incoming && source) accept_client();
+}
+
+gboolean ControlServer::source_prepare(GSource* source, gint* timeout) {
+    ControlServer* self = ((Source*)source)->server;
+    *timeout = -1;
+    // Broadcasts outside dispatch() leave dead clients to close
+    for (size_t i = 0; i < self->clients.size(); ++i) {
+        if (self->clients[i]->dead) return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean ControlServer::source_check(GSource* source) {
+    ControlServer* self = ((Source*)source)->server;
+    if (self->listen_poll.revents) return TRUE;
+    for (size_t i = 0; i < self->clients.size(); ++i) {
+        if (self->clients[i]->poll.revents || self->clients[i]->dead) return TRUE;
+    }
+    return FALSE;
+}
+
+gboolean ControlServer::source_dispatch(GSource* source, GSourceFunc callback, gpointer user_data) {
+    (void)callback;
+    (void)user_data;
+    ((Source*)source)->server->dispatch();
+    return TRUE;
+}
+
+// =================================================================================
+// ControlClient Implementation
+// =================================================================================
+
+ControlClient::ControlClient()
+    : fd(-1), channel(NULL), watch_id(0), event_callback(NULL), event_user_data(NULL)
+{
+}
+
+ControlClient::~ControlClient() {
+    disconnect();
+}
+
+bool ControlClient::connect(const char* path) {
+    disconnect();
+    struct sockaddr_un addr;
+    if (!make_address(path, &addr)) return false;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = REQUEST_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (REQUEST_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return true;
+}
+
+void ControlClient::disconnect() {
+    if (watch_id > 0) {
+        g_source_remove(watch_id);
+        watch_id = 0;
+    }
+    if (channel) {
+        g_io_channel_unref(channel);
+        channel = NULL;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    input.clear();
+}
+
+bool ControlClient::is_connected() const {
+    return fd >= 0;
+}
+
+bool ControlClient::request(const std::string& command, std::string* reply) {
+    if (fd < 0) return false;
+
+    std::string line = command + '\n';
+    if (!write_all(fd, line.data(), line.size())) {
+        g_printerr("Control: Daemon went away\n");
+        disconnect();
+        return false;
+    }
+
+    size_t end;
+    while ((end = input.find('\n')) == std::string::npos) {
+        char buf[1024];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            g_printerr("Control: No reply to '%s'\n", command.c_str());
+            disconnect();
+            return false;
+        }
+        input.append(buf, n);
+    }
+    std::string answer = input.substr(0, end);
+    input.erase(0, end + 1);
+
+    bool ok = answer.compare(0, 2, "OK") == 0;
+    if (!ok) g_printerr("Control: '%s' failed: %s\n", command.c_str(), answer.c_str());
+    if (reply) *reply = answer;
+    return ok;
+}
+
+bool ControlClient::status(PlayerStatus* status) {
+    std::string reply;
+    return request("status", &reply) && parse_player_status(reply, status);
+}
+
+bool ControlClient::subscribe(PlayerEventCallback callback, void* user_data) {
+    if (!request("subscribe", NULL)) return false;
+    event_callback = callback;
+    event_user_data = user_data;
+    channel = g_io_channel_unix_new(fd);
+    watch_id = g_io_add_watch(channel, (GIOCondition)(G_IO_IN | G_IO_HUP | G_IO_ERR), event_func, this);
+    // Events sent right behind the reply may be buffered already
+    deliver_events();
+    return true;
+}
+
+void ControlClient::deliver_events() {
+    size_t end;
+    while ((end = input.find('\n')) != std::string::npos) {
+        PlayerStatus status;
+        bool ok = parse_player_status(input.substr(0, end), &status);
+        input.erase(0, end + 1);
+        if (ok) event_callback(&status, event_user_data);
+    }
+}
+
+gboolean ControlClient::event_func(GIOChannel* channel, GIOCondition condition, gpointer data) {
+    (void)channel;
+    ControlClient* self = static_cast<ControlClient*>(data);
+
+    char buf[1024];
+    ssize_t n = (condition & G_IO_IN) ? read(self->fd, buf, sizeof(buf)) : 0;
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return TRUE;
+    if (n <= 0) {
+        // Returning FALSE removes the watch
+        self->watch_id = 0;
+        self->disconnect();
+        self->event_callback(NULL, self->event_user_data);
+        return FALSE;
+    }
+    self->input.append(buf, n);
+    self->deliver_events();
+    return TRUE;
+}
+
+bool parse_player_status(const std::string& reply, PlayerStatus* status) {
+    status->playing = false;
+    status->paused = false;
+    status->index = -1;
+    status->position_ms = 0;
+    status->speed = 1.0f;
+    status->playlist = 0;
+    status->filepath.clear();
+
+    // The path may contain spaces, so it comes last and runs to the end
+    size_t file = reply.find(" file=");
+    std::string fields = reply.substr(0, file);
+    if (file != std::string::npos) status->filepath = reply.substr(file + 6);
+
+    // "OK ..." for replies, "EVENT ..." for events
+    char state[16] = "";
+    int index = -1;
+    long long position = 0;
+    float speed = 1.0f;
+    unsigned playlist = 0;
+    if (sscanf(fields.c_str(), "%*s state=%15s index=%d position=%lld speed=%f playlist=%u", state, &index,
+               &position, &speed, &playlist) < 3) {
+        return false;
+    }
+    status->speed = speed;
+    status->playlist = playlist;
+    status->paused = strcmp(state, "paused") == 0;
+    status->playing = status->paused || strcmp(state, "playing") == 0;
+    status->index = index;
+    status->position_ms = position;
+    return true;
+}
@@ -0,0 +1,150 @@
+#ifndef CONTROL_SOCKET_H
+#define CONTROL_SOCKET_H
+
+#include <glib.h>
+#include <string>
+#include <vector>
+
+// Where KinAMP-minimal listens for its clients
+#define CONTROL_SOCKET_PATH "/tmp/kinamp_control.sock"
+
+// Control protocol: plain text over a Unix stream socket, one command per
+// line, answered by exactly one line, "OK[ <data>]" or "ERR <message>".
+// Several commands may be sent at once; their replies come back in order,
+// in a single write.
+//
+//   play [<index> [resume]]   Resume if paused, else play the song at
+//                             <index> (default: the current one);
+//                             "resume" continues from the saved position
+//   play resume               Resume if paused, keep playing if playing,
+//                             else the current song from its saved position
+//   pause                     Toggle pause
+//   stop | next | prev
+//   seek <s> | seek +<s> | seek -<s>
+//                             Jump to (or by) a position in seconds
+//   load <m3u or folder path> Replace the playlist. A folder is read in
+//                             the background: it replaces the playlist
+//                             when done, with a new status playlist=<n>
+//   strategy normal|repeat|shuffle
+//   volume [<dB>]             Set (-60..+12, clamped); without argument
+//                             "OK <dB>"
+//   speed <x> | crossfade <s>
+//   replaygain off|track|album | silence off|edges|speech
+//   eq [<preset line>]        As stored in .kinamp.conf; none = flat
+//   scan 0|1                  Background loudness scan of the playlist
+//   powersave 0|1             Deep, low-wakeup buffering (screen off)
+//   status                    "OK state=<playing|paused|stopped>
+//                             index=<i> position=<ms> speed=<x>
+//                             playlist=<n> file=<path>"; <n> changes when
+//                             the daemon edited the playlist file itself
+//                             (folder loaded, watched folders changed)
+//   subscribe                 "OK", then the connection only carries
+//                             events: "EVENT <status fields>" for the
+//                             current state and after every change
+//                             (track, pause, seek, EOS, ...)
+//   quit                      Stop playback and exit the daemon
+
+// Handles one command line (without the newline) and returns the reply
+typedef std::string (*ControlCommandCallback)(const std::string& command, void* user_data);
+
+// --- ControlServer Class ---
+// Listening side. A single GSource polls the listening socket and all
+// clients, so it runs on the GLib main loop with no threads; it only uses
+// g_source_add_poll(), which the Kindle's old GLib has.
+class ControlServer {
+public:
+    ControlServer();
+    ~ControlServer();
+
+    // Listen on `socket_path`. Fails if another process already serves it.
+    bool start(const char* socket_path, ControlCommandCallback callback, void* user_data);
+    void stop();
+
+    // Send `line` to all subscribed clients. Those that cannot take it are
+    // closed on the next dispatch, not here: this may run from a command
+    // that is being served.
+    void broadcast(const std::string& line);
+
+private:
+    struct Client {
+        GPollFD poll;
+        std::string input;      // Partial command line
+        bool subscribed;        // Event stream only
+        bool dead;              // A write failed; closed by dispatch()
+    };
+
+    struct Source {
+        GSource base;
+        ControlServer* server;
+    };
+
+    std::string socket_path;
+    GPollFD listen_poll;
+    Source* source;
+    std::vector<Client*> clients;
+    ControlCommandCallback callback;
+    void* user_data;
+
+    static GSourceFuncs source_funcs;
+
+    void accept_client();
+    bool serve_client(Client* client);
+    void close_client(Client* client);
+    void close_dead_clients();
+    void dispatch();
+    static gboolean source_prepare(GSource* source, gint* timeout);
+    static gboolean source_check(GSource* source);
+    static gboolean source_dispatch(GSource* source, GSourceFunc callback, gpointer user_data);
+};
+
+// Snapshot of the daemon's playback state, as reported by "status"
+struct PlayerStatus {
+    bool playing;
+    bool paused;
+    int index;              // Playlist index, -1 = none
+    gint64 position_ms;
+    float speed;
+    unsigned playlist;      // Bumped when the daemon changes the playlist itself
+    std::string filepath;
+};
+
+// Parse a status reply or event line
+bool parse_player_status(const std::string& reply, PlayerStatus* status);
+
+// Receives subscribed events; `status` is NULL when the daemon went away
+typedef void (*PlayerEventCallback)(const PlayerStatus* status, void* user_data);
+
+// --- ControlClient Class ---
+// Connecting side. Requests block for at most a second.
+class ControlClient {
+public:
+    ControlClient();
+    ~ControlClient();
+
+    bool connect(const char* socket_path);
+    void disconnect();
+    bool is_connected() const;
+
+    // Send `command` and wait for its reply line. False if the daemon
+    // answered with an error or is gone.
+    bool request(const std::string& command, std::string* reply);
+
+    bool status(PlayerStatus* status);
+
+    // Turn this connection into an event stream, delivered to `callback`
+    // from the GLib main loop. No requests can be sent on it afterwards.
+    bool subscribe(PlayerEventCallback callback, void* user_data);
+
+private:
+    int fd;
+    std::string input;      // Bytes after the last complete reply
+    GIOChannel* channel;
+    guint watch_id;
+    PlayerEventCallback event_callback;
+    void* event_user_data;
+
+    void deliver_events();
+    static gboolean event_func(GIOChannel* channel, GIOCondition condition, gpointer data);
+};
+
+#endif // CONTROL_SOCKET_H
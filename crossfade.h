@@ -0,0 +1,43 @@
+#ifndef CROSSFADE_H
+#define CROSSFADE_H
+
+#include <stddef.h>
+
+// --- Crossfade Class ---
+// Equal-power crossfade of two interleaved stereo float streams: the
+// outgoing track follows cos(t), the incoming one sin(t), t going from 0
+// to pi/2 over the fade, so the summed power stays constant.
+class Crossfade {
+public:
+    static constexpr float MIN_SECONDS = 1.0f;
+    static constexpr float MAX_SECONDS = 12.0f;
+
+    Crossfade();
+
+    // Begin a fade of `length` frames. The incoming stream is additionally
+    // scaled by `in_gain` (its level relative to the outgoing track).
+    void start(size_t length, float in_gain);
+    void stop();
+
+    bool is_active() const;
+
+    // True once the outgoing stream has faded out completely.
+    bool is_done() const;
+
+    // Mix `frames` frames of `in` into `out` (the outgoing stream) and
+    // advance the fade.
+    void process(float* out, const float* in, size_t frames);
+
+private:
+    bool active;
+    size_t length;
+    size_t position;
+    float in_gain;
+};
+
+// out[i] = out[i] * g_out + in[i] * g_in, with both gains moving linearly
+// by their step per frame. NEON / SSE / scalar.
+void crossfade_mix_stereo(float* out, const float* in, size_t frames,
+                          float out_gain, float out_step, float in_gain, float in_step);
+
+#endif // CROSSFADE_H
@@ -0,0 +1,134 @@
+#include "eq_preset.h"
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+
+// Band limits. Presets come from .kinamp.conf and the control socket, and
+// past these a band is unstable (Q near 0) or overflows the cascade (huge
+// gains).
+static const float MIN_FREQ = 10.0f;
+static const float MAX_GAIN_DB = 24.0f;
+static const float MIN_Q = 0.1f;
+static const float MAX_Q = 10.0f;
+
+// NaN maps to `lo`
+static float clamp_param(float value, float lo, float hi) {
+    return value > hi ? hi : (value >= lo ? value : lo);
+}
+
+EqBand eq_clamp_band(const EqBand& band, float max_freq) {
+    EqBand clamped = band;
+    clamped.freq = clamp_param(band.freq, MIN_FREQ < max_freq ? MIN_FREQ : max_freq, max_freq);
+    clamped.gain_db = clamp_param(band.gain_db, -MAX_GAIN_DB, MAX_GAIN_DB);
+    clamped.q = clamp_param(band.q, MIN_Q, MAX_Q);
+    return clamped;
+}
+
+static EqBand make_band(EqBandType type, float freq, float gain_db, float q) {
+    EqBand band = { type, freq, gain_db, q };
+    return band;
+}
+
+const std::vector<EqPreset>& eq_builtin_presets() {
+    static std::vector<EqPreset> presets;
+    if (presets.empty()) {
+        EqPreset p;
+        p.name = "Flat";
+        presets.push_back(p);
+
+        p.name = "Bass boost";
+        p.bands.clear();
+        p.bands.push_back(make_band(EQ_LOW_SHELF, 100, 6, 0.7f));
+        presets.push_back(p);
+
+        p.name = "Treble boost";
+        p.bands.clear();
+        p.bands.push_back(make_band(EQ_HIGH_SHELF, 8000, 6, 0.7f));
+        presets.push_back(p);
+
+        // Less boom and more presence for speech (audiobooks, lectures)
+        p.name = "Voice";
+        p.bands.clear();
+        p.bands.push_back(make_band(EQ_LOW_SHELF, 120, -6, 0.7f));
+        p.bands.push_back(make_band(EQ_PEAK, 2500, 4, 1.0f));
+        p.bands.push_back(make_band(EQ_HIGH_SHELF, 8000, -2, 0.7f));
+        presets.push_back(p);
+
+        // Typical cheap Bluetooth headset: thin bass, harsh upper mids,
+        // rolled-off air
+        p.name = "BT headset";
+        p.bands.clear();
+        p.bands.push_back(make_band(EQ_LOW_SHELF, 80, 5, 0.7f));
+        p.bands.push_back(make_band(EQ_PEAK, 250, -2, 1.0f));
+        p.bands.push_back(make_band(EQ_PEAK, 1000, 1, 1.0f));
+        p.bands.push_back(make_band(EQ_PEAK, 3500, -3, 1.4f));
+        p.bands.push_back(make_band(EQ_HIGH_SHELF, 10000, 3, 0.7f));
+        presets.push_back(p);
+    }
+    return presets;
+}
+
+static const char* band_type_name(EqBandType type) {
+    switch (type) {
+        case EQ_LOW_SHELF: return "lowshelf";
+        case EQ_HIGH_SHELF: return "highshelf";
+        default: return "peak";
+    }
+}
+
+bool eq_parse_preset_line(const std::string& line, EqPreset* preset) {
+    const std::string prefix = "eq_preset.";
+    if (line.compare(0, prefix.size(), prefix) != 0) return false;
+    size_t eq = line.find('=', prefix.size());
+    if (eq == std::string::npos || eq == prefix.size()) return false;
+
+    preset->name = line.substr(prefix.size(), eq - prefix.size());
+    preset->bands.clear();
+
+    size_t pos = eq + 1;
+    while (pos < line.size()) {
+        size_t end = line.find(',', pos);
+        if (end == std::string::npos) end = line.size();
+        std::string item = line.substr(pos, end - pos);
+        pos = end + 1;
+
+        char type[16];
+        EqBand band;
+        if (sscanf(item.c_str(), "%15[a-z]:%f:%f:%f", type, &band.freq, &band.gain_db, &band.q) != 4) {
+            g_printerr("Equalizer: Ignoring band '%s' in preset '%s'\n", item.c_str(), preset->name.c_str());
+            continue;
+        }
+        std::string t = type;
+        if (t == "lowshelf") band.type = EQ_LOW_SHELF;
+        else if (t == "highshelf") band.type = EQ_HIGH_SHELF;
+        else band.type = EQ_PEAK;
+        if (!isfinite(band.freq) || !isfinite(band.gain_db) || !isfinite(band.q) || band.freq <= 0.0f) {
+            g_printerr("Equalizer: Ignoring band '%s' in preset '%s'\n", item.c_str(), preset->name.c_str());
+            continue;
+        }
+        preset->bands.push_back(eq_clamp_band(band, EQ_MAX_FREQ));
+    }
+    return true;
+}
+
+std::string eq_format_preset_line(const EqPreset& preset) {
+    std::string line = "eq_preset." + preset.name + "=";
+    char buf[64];
+    for (size_t i = 0; i < preset.bands.size(); ++i) {
+        const EqBand& b = preset.bands[i];
+        snprintf(buf, sizeof(buf), "%s%s:%g:%g:%g", i ? "," : "", band_type_name(b.type), b.freq, b.gain_db, b.q);
+        line += buf;
+    }
+    return line;
+}
+
+const EqPreset* eq_find_preset(const std::vector<EqPreset>& presets, const std::string& name) {
+    for (size_t i = 0; i < presets.size(); ++i) {
+        if (presets[i].name == name) return &presets[i];
+    }
+    const std::vector<EqPreset>& builtin = eq_builtin_presets();
+    for (size_t i = 0; i < builtin.size(); ++i) {
+        if (builtin[i].name == name) return &builtin[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,49 @@
+#ifndef EQ_PRESET_H
+#define EQ_PRESET_H
+
+#include <string>
+#include <vector>
+
+// Equalizer band sets and their text form, without the DSP: KinAMP only
+// edits and forwards presets, the Equalizer class (equalizer.h) runs them.
+
+enum EqBandType {
+    EQ_PEAK,
+    EQ_LOW_SHELF,
+    EQ_HIGH_SHELF
+};
+
+struct EqBand {
+    EqBandType type;
+    float freq;     // Centre / corner frequency in Hz
+    float gain_db;
+    float q;
+};
+
+struct EqPreset {
+    std::string name;
+    std::vector<EqBand> bands;  // Empty = flat (EQ bypassed)
+};
+
+// Highest band frequency a preset may ask for; eq_band_coeffs() also caps
+// it at 0.45x the sample rate
+static const float EQ_MAX_FREQ = 20000.0f;
+
+// `band` clamped to 10 Hz..`max_freq`, +-24 dB and Q 0.1..10
+EqBand eq_clamp_band(const EqBand& band, float max_freq);
+
+// Built-in presets; the first one is "Flat".
+const std::vector<EqPreset>& eq_builtin_presets();
+
+// Presets are stored in .kinamp.conf as
+//   eq_preset.<name>=<type>:<freq>:<gain dB>:<q>,...
+// with type one of peak, lowshelf, highshelf. Bands with a non-numeric or
+// non-positive frequency are dropped; the others are clamped to
+// 10 Hz..20 kHz, +-24 dB and Q 0.1..10.
+bool eq_parse_preset_line(const std::string& line, EqPreset* preset);
+std::string eq_format_preset_line(const EqPreset& preset);
+
+// Find a preset by name in `presets`, then among the built-ins.
+const EqPreset* eq_find_preset(const std::vector<EqPreset>& presets, const std::string& name);
+
+#endif // EQ_PRESET_H
@@ -0,0 +1,135 @@
+#include "equalizer.h"
+#include <complex>
+#include <math.h>
+
+// Triple buffer index word: slot index plus a "fresh coefficients" flag
+static const int SLOT_MASK = 3;
+static const int NEW_DATA = 4;
+
+// Frequencies (log-spaced, 20 Hz - 20 kHz) at which the cascade's response
+// is sampled to work out how much headroom a band set needs
+static const int HEADROOM_POINTS = 64;
+
+// Highest band frequency, as a fraction of the sample rate: the cookbook
+// filters go unstable towards Nyquist
+static const float MAX_FREQ_OF_RATE = 0.45f;
+
+Equalizer::Equalizer(unsigned sample_rate)
+    : sample_rate(sample_rate), middle(1), back(2), front(0), active_count(0)
+{
+    for (int i = 0; i < 3; ++i) slots[i].count = 0;
+    reset();
+}
+
+BiquadCoeffs eq_band_coeffs(const EqBand& band, unsigned sample_rate) {
+    EqBand b = eq_clamp_band(band, MAX_FREQ_OF_RATE * sample_rate);
+    double a = pow(10.0, b.gain_db / 40.0);
+    double w0 = 2.0 * M_PI * b.freq / sample_rate;
+    double cs = cos(w0);
+    double alpha = sin(w0) / (2.0 * b.q);
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (b.type) {
+        case EQ_LOW_SHELF: {
+            double sq = 2.0 * sqrt(a) * alpha;
+            b0 = a * ((a + 1) - (a - 1) * cs + sq);
+            b1 = 2 * a * ((a - 1) - (a + 1) * cs);
+            b2 = a * ((a + 1) - (a - 1) * cs - sq);
+            a0 = (a + 1) + (a - 1) * cs + sq;
+            a1 = -2 * ((a - 1) + (a + 1) * cs);
+            a2 = (a + 1) + (a - 1) * cs - sq;
+            break;
+        }
+        case EQ_HIGH_SHELF: {
+            double sq = 2.0 * sqrt(a) * alpha;
+            b0 = a * ((a + 1) + (a - 1) * cs + sq);
+            b1 = -2 * a * ((a - 1) + (a + 1) * cs);
+            b2 = a * ((a + 1) + (a - 1) * cs - sq);
+            a0 = (a + 1) - (a - 1) * cs + sq;
+            a1 = 2 * ((a - 1) - (a + 1) * cs);
+            a2 = (a + 1) - (a - 1) * cs - sq;
+            break;
+        }
+        case EQ_PEAK:
+        default:
+            b0 = 1 + alpha * a;
+            b1 = -2 * cs;
+            b2 = 1 - alpha * a;
+            a0 = 1 + alpha / a;
+            a1 = -2 * cs;
+            a2 = 1 - alpha / a;
+            break;
+    }
+
+    BiquadCoeffs c;
+    c.b0 = (float)(b0 / a0);
+    c.b1 = (float)(b1 / a0);
+    c.b2 = (float)(b2 / a0);
+    c.a1 = (float)(a1 / a0);
+    c.a2 = (float)(a2 / a0);
+    return c;
+}
+
+// Peak gain (dB) of the whole cascade across the audible range
+static double cascade_peak_db(const BiquadCoeffs* bands, int count, unsigned sample_rate) {
+    double peak = -HUGE_VAL;
+    for (int i = 0; i < HEADROOM_POINTS; ++i) {
+        double f = 20.0 * pow(1000.0, (double)i / (HEADROOM_POINTS - 1));
+        if (f >= sample_rate / 2.0) break;
+        std::complex<double> z1 = std::polar(1.0, -2.0 * M_PI * f / sample_rate);
+        std::complex<double> z2 = z1 * z1;
+        double mag = 1.0;
+        for (int b = 0; b < count; ++b) {
+            const BiquadCoeffs& c = bands[b];
+            mag *= std::abs((double)c.b0 + (double)c.b1 * z1 + (double)c.b2 * z2) /
+                   std::abs(1.0 + (double)c.a1 * z1 + (double)c.a2 * z2);
+        }
+        double db = 20.0 * log10(mag);
+        if (db > peak) peak = db;
+    }
+    return peak;
+}
+
+void Equalizer::set_bands(const std::vector<EqBand>& bands) {
+    std::lock_guard<std::mutex> guard(writer_lock);
+
+    CoeffSet& set = slots[back];
+    set.count = 0;
+    for (size_t i = 0; i < bands.size() && set.count < MAX_BANDS; ++i) {
+        set.bands[set.count++] = eq_band_coeffs(bands[i], sample_rate);
+    }
+
+    // Boosts would clip loud passages; pull the first band down by the
+    // cascade's peak gain so the EQ never adds level.
+    if (set.count > 0) {
+        double peak_db = cascade_peak_db(set.bands, set.count, sample_rate);
+        if (peak_db > 0.0) {
+            float scale = (float)pow(10.0, -peak_db / 20.0);
+            set.bands[0].b0 *= scale;
+            set.bands[0].b1 *= scale;
+            set.bands[0].b2 *= scale;
+        }
+    }
+
+    back = middle.exchange(back | NEW_DATA, std::memory_order_acq_rel) & SLOT_MASK;
+}
+
+void Equalizer::process(float* samples, size_t frames) {
+    if (middle.load(std::memory_order_acquire) & NEW_DATA) {
+        front = middle.exchange(front, std::memory_order_acq_rel) & SLOT_MASK;
+        // Bands that were already running keep their history (no click);
+        // newly enabled ones start from silence.
+        int count = slots[front].count;
+        for (int i = active_count; i < count; ++i) biquad_reset(&state[i]);
+        active_count = count;
+    }
+
+    const CoeffSet& set = slots[front];
+    for (int i = 0; i < active_count; ++i) {
+        biquad_process_stereo(samples, frames, set.bands[i], &state[i]);
+    }
+}
+
+void Equalizer::reset() {
+    for (int i = 0; i < MAX_BANDS; ++i) biquad_reset(&state[i]);
+}
@@ -0,0 +1,61 @@
+#ifndef EQUALIZER_H
+#define EQUALIZER_H
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+
+#include "biquad.h"
+#include "eq_preset.h"
+
+// --- Equalizer Class ---
+// Parametric EQ for interleaved stereo float PCM: a cascade of up to
+// MAX_BANDS biquads, each running both channels in one SIMD register.
+//
+// Coefficients are computed by set_bands() on the caller's thread and
+// handed to the audio thread through a triple buffer, so process() never
+// blocks and never sees a half-written band set.
+class Equalizer {
+public:
+    static const int MAX_BANDS = 10;
+
+    explicit Equalizer(unsigned sample_rate);
+
+    // Replace the band set (extra bands beyond MAX_BANDS are ignored).
+    // An empty set bypasses the EQ. Any thread.
+    void set_bands(const std::vector<EqBand>& bands);
+
+    // Filter `frames` stereo frames in place. Audio thread only.
+    void process(float* samples, size_t frames);
+
+    // Clear the filter history, e.g. at a track change. Audio thread only.
+    void reset();
+
+private:
+    struct CoeffSet {
+        int count;
+        BiquadCoeffs bands[MAX_BANDS];
+    };
+
+    const unsigned sample_rate;
+
+    // Triple buffer: the writer fills slots[back], then swaps it with
+    // `middle`; the audio thread swaps `front` with `middle` when the
+    // NEW_DATA bit is set.
+    CoeffSet slots[3];
+    std::atomic<int> middle;
+    int back;                   // Writer side, guarded by writer_lock
+    int front;                  // Audio thread side
+    std::mutex writer_lock;
+
+    // Audio thread state
+    StereoBiquadState state[MAX_BANDS];
+    int active_count;
+};
+
+// RBJ "Audio EQ Cookbook" coefficients for one band. The band is clamped
+// to 10 Hz..0.45x the sample rate, +-24 dB and Q 0.1..10 first.
+BiquadCoeffs eq_band_coeffs(const EqBand& band, unsigned sample_rate);
+
+#endif // EQUALIZER_H
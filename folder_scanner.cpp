@@ -0,0 +1,492 @@
+#include "folder_scanner.h"
+#include <glib.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <deque>
+
+// Hand files over once this many are waiting...
+static const size_t PUBLISH_FILES = 256;
+// ...or at least this often, so the playlist fills up steadily (ms)
+static const long PUBLISH_INTERVAL_MS = 300;
+
+// Directory readers: more only helps while the others wait for the disk
+static const int MAX_SCAN_THREADS = 4;
+
+// How long an idle reader sleeps before looking for work again (ms)
+static const int IDLE_WAIT_MS = 2;
+
+// Folder mtimes this close to the scan are not trusted (vfat: 2 s steps)
+static const int64_t RACY_MTIME_NS = 2000000000LL;
+
+static bool is_music_file(const char* name) {
+    return library_format_from_name(name) != LIBRARY_FORMAT_UNKNOWN;
+}
+
+static int64_t stat_mtime_ns(const struct stat& st) {
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+static long elapsed_ms(const struct timespec& since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since.tv_sec) * 1000 + (now.tv_nsec - since.tv_nsec) / 1000000;
+}
+
+// A folder of the tree being walked. Readers fill it in; the scan thread
+// hands its files out and frees it once everything before it is out.
+struct FolderScanner::ScanNode {
+    ScanNode* parent;
+    std::string path;
+    size_t name_offset;                 // Last component of `path`
+    int fd;                             // Kept open while subfolders wait for openat()
+    std::atomic<int> unopened;          // Subfolders not opened yet
+    bool scanned;                       // `children` and `files` are filled in
+    std::vector<ScanNode*> children;    // Sorted; NULL once freed
+    std::vector<std::string> files;     // Sorted
+
+    // For the library index
+    int64_t mtime;                      // ns, 0 = unknown
+    int index_dir;                      // Unchanged folder of the index, -1 = not used
+    bool opened;                        // Read from disk
+    std::vector<LibraryFileStat> stats; // Of `files`, when read from disk
+
+    ScanNode(ScanNode* parent, const std::string& path, size_t name_offset)
+        : parent(parent), path(path), name_offset(name_offset), fd(-1), unopened(0), scanned(false),
+          mtime(0), index_dir(-1), opened(false) {}
+};
+
+// A reader's own folders: it works from the back, others steal from the
+// front, i.e. the folders furthest from what the scan thread waits for
+struct FolderScanner::WorkQueue {
+    std::mutex mutex;
+    std::deque<ScanNode*> nodes;
+};
+
+struct FolderScanner::WorkerArg {
+    FolderScanner* self;
+    int worker;
+};
+
+FolderScanner::FolderScanner()
+    : stop_flag(false), running(false), found_count(0), thread_id(0),
+      callback(NULL), callback_user_data(NULL), writer(NULL), scan_start(0), dirs_read(0), dirs_reused(0),
+      outstanding(0)
+{
+    memset(&last_publish, 0, sizeof(last_publish));
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = (int)std::max(1L, std::min(cpus, (long)MAX_SCAN_THREADS));
+}
+
+FolderScanner::~FolderScanner() {
+    stop();
+}
+
+void FolderScanner::set_callback(FolderScanCallback new_callback, void* user_data) {
+    callback = new_callback;
+    callback_user_data = user_data;
+}
+
+bool FolderScanner::start(const std::string& new_folder) {
+    stop();
+
+    folder = new_folder;
+    stop_flag = false;
+    running = true;
+    found_count = 0;
+
+    if (pthread_create(&thread_id, NULL, thread_func, this) != 0) {
+        perror("FolderScanner: Failed to create thread");
+        running = false;
+        thread_id = 0;
+        return false;
+    }
+    return true;
+}
+
+void FolderScanner::stop() {
+    if (thread_id == 0) return;
+
+    stop_flag = true;
+    {
+        // Wake the scan thread if it waits for a folder
+        std::lock_guard<std::mutex> lock(scanned_mutex);
+        scanned_cond.notify_all();
+    }
+    pthread_join(thread_id, NULL);
+    thread_id = 0;
+    running = false;
+
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    pending.clear();
+}
+
+bool FolderScanner::is_running() const {
+    return running;
+}
+
+void FolderScanner::set_thread_count(int count) {
+    thread_count = std::max(1, count);
+}
+
+void FolderScanner::set_index_path(const std::string& path) {
+    index_path = path;
+}
+
+void FolderScanner::join() {
+    if (thread_id == 0) return;
+    pthread_join(thread_id, NULL);
+    thread_id = 0;
+}
+
+int FolderScanner::get_found_count() const {
+    return found_count;
+}
+
+void FolderScanner::take_files(std::vector<std::string>* files) {
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    if (files->empty()) {
+        files->swap(pending);
+    } else {
+        for (size_t i = 0; i < pending.size(); ++i) files->push_back(std::move(pending[i]));
+    }
+    pending.clear();
+}
+
+// =================================================================================
+// Scan Thread
+// =================================================================================
+
+void* FolderScanner::thread_func(void* arg) {
+    FolderScanner* self = static_cast<FolderScanner*>(arg);
+
+    clock_gettime(CLOCK_MONOTONIC, &self->last_publish);
+    self->walk();
+    if (!self->stop_flag) self->publish(true);
+    self->batch.clear();
+
+    self->running = false;
+    if (self->callback) self->callback(self->callback_user_data);
+    return NULL;
+}
+
+// Start the readers on the root folder, then hand out the folders in walk
+// order as they get read
+void FolderScanner::walk() {
+    std::string root_path = folder;
+    while (root_path.size() > 1 && root_path[root_path.size() - 1] == '/') root_path.erase(root_path.size() - 1);
+    ScanNode* root = new ScanNode(NULL, root_path, 0);
+
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    dirs_read = 0;
+    dirs_reused = 0;
+    if (!index_path.empty()) {
+        index.open(index_path);
+        writer = new LibraryIndexWriter();
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        scan_start = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    }
+
+    for (int i = 0; i < thread_count; ++i) queues.push_back(new WorkQueue());
+    queues[0]->nodes.push_back(root);
+    outstanding = 1;
+
+    std::vector<pthread_t> threads;
+    std::vector<WorkerArg> args(thread_count);
+    for (int i = 0; i < thread_count; ++i) {
+        args[i].self = this;
+        args[i].worker = i;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_func, &args[i]) != 0) {
+            perror("FolderScanner: Failed to create reader thread");
+            continue;
+        }
+        threads.push_back(thread);
+    }
+    if (threads.empty()) {
+        // Read everything on this thread instead
+        work(0);
+    }
+
+    emit(root);
+    for (size_t i = 0; i < threads.size(); ++i) pthread_join(threads[i], NULL);
+
+    // After a stop, folders that were never handed out are still there
+    free_node(root);
+    for (size_t i = 0; i < queues.size(); ++i) delete queues[i];
+    queues.clear();
+
+    if (writer) {
+        if (!stop_flag) {
+            writer->copy_outside(index, root_path);
+            writer->write(index_path);
+        }
+        delete writer;
+        writer = NULL;
+        index.close();
+    }
+    if (!stop_flag) {
+        g_print("FolderScanner: %d files, %d folders read, %d unchanged, %ld ms\n",
+                (int)found_count, dirs_read, dirs_reused, elapsed_ms(started));
+    }
+}
+
+// Hand out the files below `node`: subfolders first, then its own
+void FolderScanner::emit(ScanNode* node) {
+    {
+        std::unique_lock<std::mutex> lock(scanned_mutex);
+        while (!node->scanned && !stop_flag) scanned_cond.wait(lock);
+    }
+    if (stop_flag) return;
+    record_dir(node);
+
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        emit(node->children[i]);
+        if (stop_flag) return;
+        free_node(node->children[i]);
+        node->children[i] = NULL;
+    }
+
+    for (size_t i = 0; i < node->files.size(); ++i) batch.push_back(std::move(node->files[i]));
+    found_count += (int)node->files.size();
+    std::vector<std::string>().swap(node->files);
+    publish(false);
+}
+
+// Note the folder for the new library index
+void FolderScanner::record_dir(ScanNode* node) {
+    if (node->index_dir >= 0) {
+        ++dirs_reused;
+        if (writer) writer->copy_dir(index, node->index_dir);
+        return;
+    }
+    if (!node->opened) return;
+    ++dirs_read;
+    if (!writer) return;
+
+    std::vector<std::string> subdirs;
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        subdirs.push_back(node->children[i]->path.substr(node->children[i]->name_offset));
+    }
+    // Changes within the mtime granularity after it was taken would go
+    // unnoticed: have such a folder read again next time
+    int64_t mtime = node->mtime >= scan_start - RACY_MTIME_NS ? 0 : node->mtime;
+    writer->add_dir(node->path, mtime, subdirs, node->stats);
+    std::vector<LibraryFileStat>().swap(node->stats);
+}
+
+void FolderScanner::free_node(ScanNode* node) {
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        if (node->children[i]) free_node(node->children[i]);
+    }
+    if (node->fd >= 0) close(node->fd);
+    delete node;
+}
+
+void FolderScanner::publish(bool force) {
+    if (batch.empty() && !force) return;
+    if (!force && batch.size() < PUBLISH_FILES && elapsed_ms(last_publish) < PUBLISH_INTERVAL_MS) return;
+    clock_gettime(CLOCK_MONOTONIC, &last_publish);
+    if (batch.empty()) return;
+
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        was_empty = pending.empty();
+        for (size_t i = 0; i < batch.size(); ++i) pending.push_back(std::move(batch[i]));
+    }
+    batch.clear();
+    // The previous call is still being served otherwise
+    if (was_empty && callback) callback(callback_user_data);
+}
+
+// =================================================================================
+// Reader Pool
+// =================================================================================
+
+void* FolderScanner::worker_func(void* arg) {
+    WorkerArg* worker_arg = static_cast<WorkerArg*>(arg);
+
+    // Below the interface: only the directory reads should be slow
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+
+    worker_arg->self->work(worker_arg->worker);
+    return NULL;
+}
+
+void FolderScanner::work(int worker) {
+    while (!stop_flag && outstanding > 0) {
+        ScanNode* node;
+        if (take_node(worker, &node)) {
+            scan_node(worker, node);
+            continue;
+        }
+        // Everything left is being read by the others; they may queue more
+        std::unique_lock<std::mutex> lock(work_mutex);
+        work_cond.wait_for(lock, std::chrono::milliseconds(IDLE_WAIT_MS));
+    }
+    // Let the others see the end too
+    work_cond.notify_all();
+}
+
+// Own folders newest first, then the oldest of another reader's
+bool FolderScanner::take_node(int worker, ScanNode** node) {
+    WorkQueue* own = queues[worker];
+    {
+        std::lock_guard<std::mutex> lock(own->mutex);
+        if (!own->nodes.empty()) {
+            *node = own->nodes.back();
+            own->nodes.pop_back();
+            return true;
+        }
+    }
+    for (int i = 1; i < (int)queues.size(); ++i) {
+        WorkQueue* victim = queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->nodes.empty()) {
+            *node = victim->nodes.front();
+            victim->nodes.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void FolderScanner::scan_node(int worker, ScanNode* node) {
+    // Only the root "/" ends with a slash
+    std::string prefix = node->path;
+    if (prefix.empty() || prefix[prefix.size() - 1] != '/') prefix += '/';
+
+    // Read after the parent's descriptor, before it may be closed below
+    int parent_fd = node->parent ? node->parent->fd : -1;
+    std::vector<std::string> subdirs;
+    if (!reuse_indexed(node, parent_fd, prefix, &subdirs)) {
+        read_dir(node, parent_fd, prefix, &subdirs);
+    }
+    if (node->parent && --node->parent->unopened == 0) {
+        if (node->parent->fd >= 0) close(node->parent->fd);
+        node->parent->fd = -1;
+    }
+
+    node->unopened = (int)subdirs.size();
+    for (size_t i = 0; i < subdirs.size(); ++i) {
+        node->children.push_back(new ScanNode(node, prefix + subdirs[i], prefix.size()));
+    }
+
+    if (!node->children.empty()) {
+        outstanding += (int)node->children.size();
+        // Reversed, so this reader goes on with the first subfolder: the
+        // one the scan thread needs next
+        WorkQueue* own = queues[worker];
+        {
+            std::lock_guard<std::mutex> lock(own->mutex);
+            for (size_t i = node->children.size(); i > 0; --i) own->nodes.push_back(node->children[i - 1]);
+        }
+        work_cond.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(scanned_mutex);
+        node->scanned = true;
+        scanned_cond.notify_all();
+    }
+    --outstanding;
+}
+
+// Take the folder's entries from the index if its mtime says nothing
+// changed. Fills `subdirs` and the node's files; false if the folder has
+// to be read.
+bool FolderScanner::reuse_indexed(ScanNode* node, int parent_fd, const std::string& prefix,
+                                  std::vector<std::string>* subdirs) {
+    if (!writer) return false;
+
+    struct stat st;
+    const char* name = node->path.c_str() + node->name_offset;
+    int result = parent_fd >= 0 ? fstatat(parent_fd, name, &st, 0) : stat(node->path.c_str(), &st);
+    if (result != 0) return false;
+    node->mtime = stat_mtime_ns(st);
+
+    int id = index.find_dir(node->path.c_str());
+    if (id < 0) return false;
+    const LibraryDir* dir = index.get_dir(id);
+    if (dir->mtime == 0 || dir->mtime != node->mtime) return false;
+
+    node->index_dir = id;
+    for (uint32_t i = 0; i < dir->child_count; ++i) {
+        const char* child_path = index.get_string(index.get_dir(index.get_child(dir, i))->path);
+        subdirs->push_back(child_path + prefix.size());
+    }
+    node->files.reserve(dir->file_count);
+    for (uint32_t i = 0; i < dir->file_count; ++i) {
+        node->files.push_back(prefix + index.get_string(index.get_file(dir->first_file + i)->name));
+    }
+    return true;
+}
+
+void FolderScanner::read_dir(ScanNode* node, int parent_fd, const std::string& prefix,
+                             std::vector<std::string>* subdirs) {
+    // Relative to the parent's descriptor, which spares the kernel the
+    // full path walk; by path for the root, or when out of descriptors
+    int fd = -1;
+    if (parent_fd >= 0) {
+        fd = openat(parent_fd, node->path.c_str() + node->name_offset, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (fd < 0 && (parent_fd < 0 || errno == EMFILE || errno == ENFILE)) {
+        fd = open(node->path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    DIR* dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir) {
+        if (fd >= 0) close(fd);
+        return;
+    }
+    node->opened = true;
+
+    std::vector<LibraryFileStat> found;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL && !stop_flag) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        bool is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_dir = fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (is_dir) {
+            subdirs->push_back(entry->d_name);
+        } else if (is_music_file(entry->d_name)) {
+            LibraryFileStat file;
+            file.name = entry->d_name;
+            file.size = 0;
+            file.mtime = 0;
+            // The index keeps size and mtime, to tell edited files
+            struct stat st;
+            if (writer && fstatat(dirfd(dir), entry->d_name, &st, 0) == 0) {
+                file.size = (int64_t)st.st_size;
+                file.mtime = stat_mtime_ns(st);
+            }
+            found.push_back(file);
+        }
+    }
+    // Subfolders are opened through this one
+    if (!subdirs->empty()) node->fd = dup(dirfd(dir));
+    closedir(dir);
+
+    std::sort(subdirs->begin(), subdirs->end());
+    std::sort(found.begin(), found.end(), [](const LibraryFileStat& a, const LibraryFileStat& b) {
+        return a.name < b.name;
+    });
+    node->files.reserve(found.size());
+    for (size_t i = 0; i < found.size(); ++i) node->files.push_back(prefix + found[i].name);
+    if (writer) node->stats.swap(found);
+}
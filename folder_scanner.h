@@ -0,0 +1,120 @@
+#ifndef FOLDER_SCANNER_H
+#define FOLDER_SCANNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "library_index.h"
+
+// Called on the scan thread when new files are waiting in take_files(),
+// and once more when the scan ends. Must not block: hand over to the main
+// loop (g_idle_add) and collect the files there.
+typedef void (*FolderScanCallback)(void* user_data);
+
+// --- FolderScanner Class ---
+// Collects the music files below a folder on a background thread, so a
+// big library (/mnt/us/music) does not freeze the interface while it is
+// read from flash. Files are handed out in batches of whole directories,
+// each sorted by name, in the order a recursive walk visits them: the
+// subfolders of a folder (sorted) first, then its own files.
+//
+// Directories are read by a small pool of threads (one per CPU, up to
+// four): each keeps its own stack of folders to read and takes work from
+// the others when it runs dry. Subfolders are opened relative to their
+// parent (openat), not by full path. The batches still come out in the
+// walk order above, whatever the pool finishes first.
+//
+// Entries of unknown type (DT_UNKNOWN, common on vfat) are looked up with
+// fstatat(), so their subfolders are not skipped.
+//
+// With a library index, a folder whose mtime matches the index is not
+// read at all: its entries come from the index, and only its subfolders
+// are checked in turn. The index is updated once a scan completes.
+class FolderScanner {
+public:
+    FolderScanner();
+    ~FolderScanner();
+
+    void set_callback(FolderScanCallback callback, void* user_data);
+
+    // (Re)start scanning `folder`. Any scan in progress is stopped and its
+    // pending files are dropped.
+    bool start(const std::string& folder);
+
+    // Stop the scan thread. Files not yet taken are dropped.
+    void stop();
+
+    // Wait for the scan to complete. Found files stay in take_files().
+    void join();
+
+    bool is_running() const;
+
+    // Directory reader threads for the next start(), at least 1
+    void set_thread_count(int count);
+
+    // Library index file to use and update from the next start(); empty
+    // (the default) for none
+    void set_index_path(const std::string& path);
+
+    // Files found so far in this scan, taken or not
+    int get_found_count() const;
+
+    // Move the files found since the last call to the end of `files`
+    void take_files(std::vector<std::string>* files);
+
+private:
+    std::string folder;
+    std::atomic<bool> stop_flag;
+    std::atomic<bool> running;
+    std::atomic<int> found_count;
+    pthread_t thread_id;
+
+    std::mutex pending_mutex;
+    std::vector<std::string> pending;   // Found, not taken yet
+
+    FolderScanCallback callback;
+    void* callback_user_data;
+
+    // Scan thread only
+    std::vector<std::string> batch;     // Found, not published yet
+    struct timespec last_publish;
+
+    // Library index, during a scan
+    std::string index_path;
+    LibraryIndex index;
+    LibraryIndexWriter* writer;     // NULL without index
+    int64_t scan_start;             // ns, for mtimes too recent to trust
+    int dirs_read;
+    int dirs_reused;
+
+    // Reader pool
+    struct ScanNode;
+    struct WorkQueue;
+    struct WorkerArg;
+    int thread_count;
+    std::vector<WorkQueue*> queues;     // One per reader
+    std::atomic<int> outstanding;       // Folders queued or being read
+    std::mutex work_mutex;              // Idle readers wait on work_cond
+    std::condition_variable work_cond;
+    std::mutex scanned_mutex;           // Guards ScanNode::scanned
+    std::condition_variable scanned_cond;
+
+    static void* thread_func(void* arg);
+    static void* worker_func(void* arg);
+    void walk();
+    void work(int worker);
+    bool take_node(int worker, ScanNode** node);
+    void scan_node(int worker, ScanNode* node);
+    bool reuse_indexed(ScanNode* node, int parent_fd, const std::string& prefix, std::vector<std::string>* subdirs);
+    void read_dir(ScanNode* node, int parent_fd, const std::string& prefix, std::vector<std::string>* subdirs);
+    void emit(ScanNode* node);
+    void record_dir(ScanNode* node);
+    void free_node(ScanNode* node);
+    void publish(bool force);
+};
+
+#endif // FOLDER_SCANNER_H
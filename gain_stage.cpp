@@ -0,0 +1,243 @@
+#include "gain_stage.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define GAIN_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GAIN_USE_SSE2 1
+#endif
+
+constexpr float GainStage::MIN_DB;
+constexpr float GainStage::MAX_DB;
+
+// Length of a volume ramp. ~23 ms at 44.1 kHz: long enough to be click-free,
+// short enough that the slider still feels immediate.
+static const size_t RAMP_FRAMES = 1024;
+
+static inline float db_to_gain(float db) {
+    return (db <= GainStage::MIN_DB) ? 0.0f : powf(10.0f, db / 20.0f);
+}
+
+// =================================================================================
+// Conversion kernels
+// =================================================================================
+//
+// All kernels compute out = round(in * gain * 32768 + tpdf) with saturation.
+// TPDF dither is the sum of two uniform values in [-0.5, 0.5) LSB, drawn from
+// per-lane xorshift32 generators. A uniform float in [1, 2) is built directly
+// from the random mantissa bits, which keeps the generator branch- and
+// multiply-free in every implementation.
+
+static inline uint32_t xorshift32(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+static inline float rand_unit(uint32_t& s) {
+    uint32_t bits = (xorshift32(s) >> 9) | 0x3f800000u;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f; // [1, 2)
+}
+
+static void convert_scalar(const float* in, int16_t* out, size_t frames, unsigned channels,
+                           float gain, float step, uint32_t* rng) {
+    for (size_t i = 0; i < frames; ++i) {
+        float g = gain * 32768.0f;
+        for (unsigned c = 0; c < channels; ++c) {
+            float d = rand_unit(rng[0]) + rand_unit(rng[1]) - 3.0f;
+            float v = *in++ * g + d;
+            long s = lrintf(v);
+            if (s > 32767) s = 32767;
+            else if (s < -32768) s = -32768;
+            *out++ = (int16_t)s;
+        }
+        gain += step;
+    }
+}
+
+#if GAIN_USE_SSE2
+// Stereo only: one vector holds two frames, lanes are L0 R0 L1 R1.
+static void convert_stereo_simd(const float* in, int16_t* out, size_t frames,
+                                float gain, float step, uint32_t* rng) {
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128i one_bits = _mm_set1_epi32(0x3f800000);
+    __m128 g = _mm_mul_ps(_mm_setr_ps(gain, gain, gain + step, gain + step), _mm_set1_ps(32768.0f));
+    const __m128 g_inc = _mm_set1_ps(2.0f * step * 32768.0f);
+    __m128i s = _mm_loadu_si128((const __m128i*)rng);
+
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+        s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+        s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+        __m128 u1 = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(s, 9), one_bits));
+        s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+        s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+        s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+        __m128 u2 = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(s, 9), one_bits));
+        __m128 d = _mm_sub_ps(_mm_add_ps(u1, u2), three);
+
+        __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in), g), d);
+        g = _mm_add_ps(g, g_inc);
+
+        // cvtps rounds to nearest, packs saturates to the S16 range.
+        __m128i q = _mm_cvtps_epi32(v);
+        _mm_storel_epi64((__m128i*)out, _mm_packs_epi32(q, q));
+        in += 4;
+        out += 4;
+    }
+    _mm_storeu_si128((__m128i*)rng, s);
+
+    if (i < frames) {
+        float tail_gain;
+        _mm_store_ss(&tail_gain, g);
+        convert_scalar(in, out, frames - i, 2, tail_gain / 32768.0f, step, rng);
+    }
+}
+#elif GAIN_USE_NEON
+static void convert_stereo_simd(const float* in, int16_t* out, size_t frames,
+                                float gain, float step, uint32_t* rng) {
+    const float32x4_t three = vdupq_n_f32(3.0f);
+    const uint32x4_t one_bits = vdupq_n_u32(0x3f800000);
+    const uint32x4_t sign_mask = vdupq_n_u32(0x80000000);
+    const uint32x4_t half_bits = vdupq_n_u32(0x3f000000);
+    const float lanes[4] = { gain, gain, gain + step, gain + step };
+    float32x4_t g = vmulq_n_f32(vld1q_f32(lanes), 32768.0f);
+    const float32x4_t g_inc = vdupq_n_f32(2.0f * step * 32768.0f);
+    uint32x4_t s = vld1q_u32(rng);
+
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        s = veorq_u32(s, vshlq_n_u32(s, 13));
+        s = veorq_u32(s, vshrq_n_u32(s, 17));
+        s = veorq_u32(s, vshlq_n_u32(s, 5));
+        float32x4_t u1 = vreinterpretq_f32_u32(vorrq_u32(vshrq_n_u32(s, 9), one_bits));
+        s = veorq_u32(s, vshlq_n_u32(s, 13));
+        s = veorq_u32(s, vshrq_n_u32(s, 17));
+        s = veorq_u32(s, vshlq_n_u32(s, 5));
+        float32x4_t u2 = vreinterpretq_f32_u32(vorrq_u32(vshrq_n_u32(s, 9), one_bits));
+        float32x4_t d = vsubq_f32(vaddq_f32(u1, u2), three);
+
+        float32x4_t v = vmlaq_f32(d, vld1q_f32(in), g);
+        g = vaddq_f32(g, g_inc);
+
+        // ARMv7 float->int conversion truncates, so add +-0.5 first.
+        // The conversion saturates and vqmovn narrows with saturation.
+        v = vaddq_f32(v, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(v), sign_mask), half_bits)));
+        vst1_s16(out, vqmovn_s32(vcvtq_s32_f32(v)));
+        in += 4;
+        out += 4;
+    }
+    vst1q_u32(rng, s);
+
+    if (i < frames) {
+        convert_scalar(in, out, frames - i, 2, vgetq_lane_f32(g, 0) / 32768.0f, step, rng);
+    }
+}
+#endif
+
+// =================================================================================
+// GainStage Implementation
+// =================================================================================
+
+GainStage::GainStage()
+    : target_db(0.0f), applied_db(0.0f), track_gain(1.0f), current_gain(1.0f), ramp_step(0.0f), ramp_remaining(0)
+{
+    dither_state[0] = 0x9e3779b9u;
+    dither_state[1] = 0x7f4a7c15u;
+    dither_state[2] = 0xf39cc060u;
+    dither_state[3] = 0x5ced2b1du;
+}
+
+void GainStage::set_volume_db(float db) {
+    if (db < MIN_DB) db = MIN_DB;
+    if (db > MAX_DB) db = MAX_DB;
+    target_db = db;
+}
+
+float GainStage::get_volume_db() const {
+    return target_db;
+}
+
+void GainStage::set_volume_linear(float gain) {
+    set_volume_db(gain > 0.0f ? 20.0f * log10f(gain) : MIN_DB);
+}
+
+void GainStage::set_track_gain(float gain_db, float peak) {
+    track_gain = track_gain_factor(gain_db, peak);
+}
+
+void GainStage::switch_track_gain(float gain_db, float peak) {
+    float old_gain = track_gain;
+    track_gain = track_gain_factor(gain_db, peak);
+    if (old_gain > 0.0f) {
+        current_gain *= track_gain / old_gain;
+        ramp_step *= track_gain / old_gain;
+    } else {
+        reset();
+    }
+}
+
+float GainStage::track_gain_factor(float gain_db, float peak) {
+    float gain = powf(10.0f, gain_db / 20.0f);
+    // Clipping prevention: never push the loudest sample past full scale
+    if (peak > 0.0f && gain * peak > 1.0f) {
+        gain = 1.0f / peak;
+    }
+    return gain;
+}
+
+float GainStage::total_gain(float db) const {
+    return db_to_gain(db) * track_gain;
+}
+
+void GainStage::reset() {
+    applied_db = target_db;
+    current_gain = total_gain(applied_db);
+    ramp_step = 0.0f;
+    ramp_remaining = 0;
+}
+
+void GainStage::update_ramp() {
+    float db = target_db;
+    if (db == applied_db) return;
+    applied_db = db;
+    ramp_step = (total_gain(db) - current_gain) / RAMP_FRAMES;
+    ramp_remaining = RAMP_FRAMES;
+}
+
+void GainStage::process(const float* in, int16_t* out, size_t frames, unsigned channels) {
+    update_ramp();
+
+    while (frames > 0) {
+        size_t n = frames;
+        float step = 0.0f;
+        if (ramp_remaining > 0) {
+            if (n > ramp_remaining) n = ramp_remaining;
+            step = ramp_step;
+        }
+
+#if GAIN_USE_SSE2 || GAIN_USE_NEON
+        if (channels == 2) {
+            convert_stereo_simd(in, out, n, current_gain, step, dither_state);
+        } else
+#endif
+        {
+            convert_scalar(in, out, n, channels, current_gain, step, dither_state);
+        }
+
+        if (ramp_remaining > 0) {
+            ramp_remaining -= n;
+            current_gain = (ramp_remaining == 0) ? total_gain(applied_db) : current_gain + step * n;
+        }
+        in += n * channels;
+        out += n * channels;
+        frames -= n;
+    }
+}
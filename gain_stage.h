@@ -0,0 +1,66 @@
+#ifndef GAIN_STAGE_H
+#define GAIN_STAGE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// --- GainStage Class ---
+// Last stage of the decode path: applies the software volume / pre-amp to
+// interleaved float PCM and converts it to S16 for the output pipe, with
+// TPDF dither. Gain changes are ramped so moving the volume never clicks.
+class GainStage {
+public:
+    // Volume range of both players (KinAMP's slider, --volume= and the
+    // control socket); MIN_DB mutes
+    static constexpr float MIN_DB = -60.0f;
+    static constexpr float MAX_DB = 12.0f;
+
+    GainStage();
+
+    // Set the user volume. Safe to call from any thread while audio runs;
+    // the decoder thread picks the new value up on its next block.
+    void set_volume_db(float db);
+    float get_volume_db() const;
+
+    // Linear variant (1.0 = unity). Values <= 0 map to MIN_DB.
+    void set_volume_linear(float gain);
+
+    // Per-track normalisation gain (ReplayGain), applied on top of the
+    // user volume. `peak` is the track's linear sample peak (0 = unknown);
+    // the gain is limited so that peak never exceeds full scale.
+    // Decoder thread only, call before reset() when a track starts.
+    void set_track_gain(float gain_db, float peak);
+
+    // Like set_track_gain(), but mid-stream (track change without a
+    // restart, e.g. after a crossfade): takes effect on the next sample and
+    // keeps any volume ramp in progress. Decoder thread only.
+    void switch_track_gain(float gain_db, float peak);
+
+    // Linear factor set_track_gain() would apply for these values.
+    static float track_gain_factor(float gain_db, float peak);
+
+    // Convert `frames` frames of interleaved float PCM to S16.
+    // Decoder thread only.
+    void process(const float* in, int16_t* out, size_t frames, unsigned channels);
+
+    // Jump straight to the target gain, dropping any ramp in progress.
+    // Used when a new track starts so it does not fade in from the old level.
+    void reset();
+
+private:
+    std::atomic<float> target_db;
+
+    // Decoder thread state
+    float applied_db;
+    float track_gain;       // Linear ReplayGain factor
+    float current_gain;
+    float ramp_step;        // Gain increment per frame while ramping
+    size_t ramp_remaining;  // Frames left in the current ramp
+    uint32_t dither_state[4];
+
+    void update_ramp();
+    float total_gain(float db) const;
+};
+
+#endif // GAIN_STAGE_H
@@ -0,0 +1,198 @@
+#include "gapless_info.h"
+#include "mpeg_frame.h"
+#include "tag_reader.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+// Delay of the MPEG audio synthesis filterbank, on top of the encoder
+// delay stored in the LAME tag (same value LAME, mpg123 and ffmpeg use)
+static const unsigned DECODER_DELAY = 529;
+
+// How far past the ID3v2 tag to look for the first MPEG frame
+static const size_t FRAME_SEARCH_BYTES = 64 * 1024;
+
+// Resampling smears the first audible samples a little way back into the
+// silent Info frame; only this much less of it is required to be zero.
+static const uint64_t CHECK_MARGIN = 64;
+
+// =================================================================================
+// Helpers
+// =================================================================================
+
+struct SmpbInfo {
+    bool found;
+    uint64_t delay;
+    uint64_t padding;
+    uint64_t length;
+};
+
+static void smpb_tag_callback(const char* key, const char* value, void* user_data) {
+    if (strcmp(key, "ITUNSMPB") != 0) return;
+    // " 00000000 <delay> <padding> <length> ..." as hex fields
+    SmpbInfo* smpb = (SmpbInfo*)user_data;
+    char* p = (char*)value;
+    unsigned long long fields[4];
+    for (int i = 0; i < 4; ++i) {
+        char* end;
+        fields[i] = strtoull(p, &end, 16);
+        if (end == p) return;
+        p = end;
+    }
+    smpb->found = true;
+    smpb->delay = fields[1];
+    smpb->padding = fields[2];
+    smpb->length = fields[3];
+}
+
+// =================================================================================
+// Public API
+// =================================================================================
+
+bool read_gapless_info(const char* filepath, GaplessInfo* info) {
+    memset(info, 0, sizeof(*info));
+
+    FILE* f = fopen(filepath, "rb");
+    if (!f) return false;
+
+    long audio_start = 0;
+    unsigned char id3[10];
+    if (fread(id3, 1, 10, f) == 10 && memcmp(id3, "ID3", 3) == 0) {
+        audio_start = 10 + (long)syncsafe32(id3 + 6) + ((id3[5] & 0x10) ? 10 : 0);
+    }
+
+    std::string buf(FRAME_SEARCH_BYTES, '\0');
+    size_t len = 0;
+    if (fseek(f, audio_start, SEEK_SET) == 0) {
+        len = fread(&buf[0], 1, buf.size(), f);
+    }
+    fclose(f);
+    const unsigned char* data = (const unsigned char*)buf.data();
+
+    // First frame with a valid header
+    MpegHeader header;
+    size_t frame = find_mpeg_frame(data, len, &header);
+    if (frame == len) return false;
+
+    bool has_lame = false;
+    uint64_t frame_count = 0, delay = 0, padding = 0;
+
+    // Xing/Info header right after the side info of the first frame
+    XingHeader xing;
+    if (parse_xing_header(data, len, frame, header, &xing)) {
+        info->info_frames = header.frame_samples;
+        frame_count = xing.frame_count;
+        size_t pos = xing.end;
+
+        // LAME extension: 9 byte encoder string, then 12 bit delay and
+        // 12 bit padding at offset 21. ffmpeg writes the same layout.
+        if (pos + 24 <= len && (memcmp(data + pos, "LAME", 4) == 0 || memcmp(data + pos, "Lavf", 4) == 0 ||
+                                memcmp(data + pos, "Lavc", 4) == 0)) {
+            const unsigned char* d = data + pos + 21;
+            delay = ((unsigned)d[0] << 4) | (d[1] >> 4);
+            padding = ((unsigned)(d[1] & 0x0f) << 8) | d[2];
+            has_lame = true;
+        }
+    }
+
+    uint64_t length = 0;
+    if (!has_lame) {
+        SmpbInfo smpb = { false, 0, 0, 0 };
+        read_text_tags(filepath, smpb_tag_callback, &smpb);
+        if (!smpb.found) return false;
+        delay = smpb.delay;
+        padding = smpb.padding;
+        length = smpb.length;
+    }
+
+    if (length == 0 && frame_count * header.frame_samples > delay + padding) {
+        length = frame_count * header.frame_samples - delay - padding;
+    }
+
+    info->sample_rate = header.sample_rate;
+    info->skip_frames = info->info_frames + delay + DECODER_DELAY;
+    info->valid_frames = length;
+    return true;
+}
+
+// =================================================================================
+// GaplessTrimmer Implementation
+// =================================================================================
+
+GaplessTrimmer::GaplessTrimmer()
+    : active(false), check_left(0), skip_left(0), keep_left(0), limited(false), skip_total(0), keep_total(0)
+{
+}
+
+static uint64_t scale_frames(uint64_t frames, unsigned from_rate, unsigned to_rate) {
+    if (from_rate == to_rate || from_rate == 0) return frames;
+    return (frames * to_rate + from_rate / 2) / from_rate;
+}
+
+void GaplessTrimmer::start(const GaplessInfo* info, unsigned output_rate) {
+    active = (info != NULL);
+    check_left = skip_left = keep_left = 0;
+    skip_total = keep_total = 0;
+    limited = false;
+    if (!info) return;
+
+    uint64_t check = scale_frames(info->info_frames, info->sample_rate, output_rate);
+    check_left = check > CHECK_MARGIN ? check - CHECK_MARGIN : 0;
+    skip_left = scale_frames(info->skip_frames, info->sample_rate, output_rate);
+    keep_left = scale_frames(info->valid_frames, info->sample_rate, output_rate);
+    limited = keep_left > 0;
+    skip_total = skip_left;
+    keep_total = keep_left;
+}
+
+size_t GaplessTrimmer::process(const float* pcm, size_t frames, size_t* offset) {
+    *offset = 0;
+    if (!active) return frames;
+
+    size_t i = 0;
+    for (; check_left > 0 && i < frames; ++i, --check_left, --skip_left) {
+        if (pcm[i * 2] != 0.0f || pcm[i * 2 + 1] != 0.0f) {
+            // The zeros checked so far in this block may be the real start
+            // of the track; pass them on too.
+            g_print("Gapless: Decoder already skips the Info frame, not trimming\n");
+            active = false;
+            return frames;
+        }
+    }
+
+    size_t skip = frames - i;
+    if (skip > skip_left) skip = (size_t)skip_left;
+    i += skip;
+    skip_left -= skip;
+
+    size_t keep = frames - i;
+    if (limited) {
+        if (keep > keep_left) keep = (size_t)keep_left;
+        keep_left -= keep;
+    }
+    *offset = i;
+    return keep;
+}
+
+bool GaplessTrimmer::finished() const {
+    return active && limited && skip_left == 0 && keep_left == 0;
+}
+
+uint64_t GaplessTrimmer::trimmed_length(uint64_t decoded_frames) const {
+    if (!active) return decoded_frames;
+    if (limited) return keep_total;
+    return decoded_frames > skip_total ? decoded_frames - skip_total : 0;
+}
+
+uint64_t GaplessTrimmer::seek(uint64_t frame) {
+    if (!active) return frame;
+    // Past the Info frame check: assume the decoder does not trim itself
+    uint64_t raw = skip_total + frame;
+    check_left = 0;
+    skip_left = 0;
+    if (limited) keep_left = keep_total > frame ? keep_total - frame : 0;
+    return raw;
+}
@@ -0,0 +1,66 @@
+#ifndef GAPLESS_INFO_H
+#define GAPLESS_INFO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Encoder delay/padding of an MP3 file, in frames at the file's own rate.
+// `skip_frames` already includes the MPEG decoder delay (529 samples) and,
+// when present, the silent Xing/Info frame itself, i.e. it is the number
+// of frames to drop from the start of the raw decoder output.
+struct GaplessInfo {
+    unsigned sample_rate;
+    unsigned info_frames;       // Length of the Xing/Info frame (0 = none)
+    uint64_t skip_frames;
+    uint64_t valid_frames;      // Frames to keep after skip_frames, 0 = unknown
+};
+
+// Read the LAME/Xing header, falling back to an iTunSMPB tag (COMM/TXXX).
+// Returns false for files without delay/padding information, including
+// everything that is not MPEG Layer III.
+bool read_gapless_info(const char* filepath, GaplessInfo* info);
+
+// --- GaplessTrimmer Class ---
+// Drops encoder delay and padding from interleaved stereo float PCM as it
+// comes out of the decoder, so consecutive tracks of an album join
+// sample-accurately.
+//
+// Decoders that already honour the LAME header skip the Info frame, which
+// otherwise decodes to exact digital silence. If anything non-zero shows up
+// where that frame should be, the decoder did the work and the trimmer
+// turns itself off instead of cutting real audio.
+class GaplessTrimmer {
+public:
+    GaplessTrimmer();
+
+    // Set up for a new track decoded at `output_rate`. `info` may be NULL
+    // (nothing to trim).
+    void start(const GaplessInfo* info, unsigned output_rate);
+
+    // Trim one decoded block. Returns how many frames to keep; they start
+    // `*offset` frames into `pcm`.
+    size_t process(const float* pcm, size_t frames, size_t* offset);
+
+    // True once all valid frames have been passed on; the rest of the
+    // file is padding and need not be decoded.
+    bool finished() const;
+
+    // Jump to trimmed frame `frame` (before any process() call). Returns
+    // the decoder frame to seek to.
+    uint64_t seek(uint64_t frame);
+
+    // Length of the trimmed track, given the decoder's own frame count
+    // for the whole file.
+    uint64_t trimmed_length(uint64_t decoded_frames) const;
+
+private:
+    bool active;
+    uint64_t check_left;        // Frames that must be silent (Info frame)
+    uint64_t skip_left;
+    uint64_t keep_left;         // 0 with `limited` = done
+    bool limited;
+    uint64_t skip_total;
+    uint64_t keep_total;
+};
+
+#endif // GAPLESS_INFO_H
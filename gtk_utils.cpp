@@ -1,13 +1,46 @@
 #include "gtk_utils.h"
 
-GtkWidget* create_button_from_icon(const guint8* icon_data, int width, int height, int padding) {
+#include <vector>
+
+struct CachedIcon {
+    const guint8* data;
+    int width;
+    int height;
+    GdkPixbuf* pixbuf;
+};
+
+// A dozen entries: a linear search is all it takes
+static std::vector<CachedIcon> icon_cache;
+
+GdkPixbuf* get_icon_pixbuf(const guint8* icon_data, int width, int height) {
+    for (size_t i = 0; i < icon_cache.size(); ++i) {
+        const CachedIcon& icon = icon_cache[i];
+        if (icon.data == icon_data && icon.width == width && icon.height == height) return icon.pixbuf;
+    }
+
+    // Raw pixdata is referenced, not copied (copy_pixels = FALSE)
     GdkPixbuf *pixbuf = gdk_pixbuf_new_from_inline(-1, icon_data, FALSE, NULL);
-    GdkPixbuf *scaled_pixbuf = gdk_pixbuf_scale_simple(pixbuf, width, height, GDK_INTERP_BILINEAR);
-    GtkWidget *image = gtk_image_new_from_pixbuf(scaled_pixbuf);
+    if (gdk_pixbuf_get_width(pixbuf) != width || gdk_pixbuf_get_height(pixbuf) != height) {
+        GdkPixbuf *scaled_pixbuf = gdk_pixbuf_scale_simple(pixbuf, width, height, GDK_INTERP_BILINEAR);
+        g_object_unref(pixbuf);
+        pixbuf = scaled_pixbuf;
+    }
+    CachedIcon icon = { icon_data, width, height, pixbuf };
+    icon_cache.push_back(icon);
+    return pixbuf;
+}
+
+GtkWidget* create_button_from_icon(const guint8* icon_data, int width, int height, int padding) {
+    GtkWidget *image = gtk_image_new_from_pixbuf(get_icon_pixbuf(icon_data, width, height));
     GtkWidget *button = gtk_button_new();
     gtk_button_set_image(GTK_BUTTON(button), image);
     gtk_container_set_border_width(GTK_CONTAINER(button), padding);
-    g_object_unref(pixbuf);
-    g_object_unref(scaled_pixbuf);
     return button;
-}
\ No newline at end of file
+}
+
+void set_button_icon(GtkWidget* button, const guint8* icon_data) {
+    GtkImage *image = GTK_IMAGE(gtk_button_get_image(GTK_BUTTON(button)));
+    GdkPixbuf *current = gtk_image_get_pixbuf(image);
+    GdkPixbuf *pixbuf = get_icon_pixbuf(icon_data, gdk_pixbuf_get_width(current), gdk_pixbuf_get_height(current));
+    if (pixbuf != current) gtk_image_set_from_pixbuf(image, pixbuf);
+}
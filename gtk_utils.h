@@ -1,3 +1,16 @@
 #include <gtk/gtk.h>
 
 GtkWidget* create_button_from_icon(const guint8* icon_data, int width, int height, int padding);
+
+// Show another icon on a button made by create_button_from_icon(), at the
+// same size. Only the pixbuf of its image changes; a no-op if it already
+// shows that icon.
+void set_button_icon(GtkWidget* button, const guint8* icon_data);
+
+// --- Icon Cache ---
+// Icons are inline GdkPixdata (assets/*_icon.h, see the "icons" target in
+// CMakeLists.txt), stored raw at their display size: the pixbuf points
+// straight at the data and needs no decoding or scaling. Each icon is
+// wrapped, and only scaled if asked for another size, once per process;
+// the cache owns the pixbufs for the lifetime of the program.
+GdkPixbuf* get_icon_pixbuf(const guint8* icon_data, int width, int height);
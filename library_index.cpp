@@ -0,0 +1,386 @@
+#include "library_index.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+// File layout (host byte order, the index never leaves the device):
+//   header   : "KLIB" | version | dir_count | file_count | child_count |
+//              slot_count | strings_size | reserved      (u32 each)
+//   dirs     : LibraryDir[dir_count]
+//   files    : LibraryFile[file_count]
+//   children : u32[child_count]      Folder ids, per parent in name order
+//   slots    : u32[slot_count]       Folder id + 1 by path hash, 0 = free
+//   strings  : char[strings_size]    NUL-terminated
+static const char INDEX_MAGIC[4] = { 'K', 'L', 'I', 'B' };
+static const uint32_t INDEX_VERSION = 2;   // 1 had unused tag columns
+static const size_t HEADER_SIZE = 32;
+
+// The records are written and mapped as they are
+static_assert(sizeof(LibraryDir) == 32, "LibraryDir layout");
+static_assert(sizeof(LibraryFile) == 32, "LibraryFile layout");
+
+static uint32_t hash_path(const char* path) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (const char* p = path; *p; ++p) {
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    }
+    return h;
+}
+
+LibraryFormat library_format_from_name(const char* name) {
+    const char* ext = strrchr(name, '.');
+    if (!ext) return LIBRARY_FORMAT_UNKNOWN;
+    if (strcasecmp(ext, ".mp3") == 0) return LIBRARY_FORMAT_MP3;
+    if (strcasecmp(ext, ".flac") == 0) return LIBRARY_FORMAT_FLAC;
+    if (strcasecmp(ext, ".wav") == 0) return LIBRARY_FORMAT_WAV;
+    return LIBRARY_FORMAT_UNKNOWN;
+}
+
+// =================================================================================
+// LibraryIndex
+// =================================================================================
+
+LibraryIndex::LibraryIndex()
+    : map(NULL), map_size(0), dirs(NULL), files(NULL), children(NULL), slots(NULL), strings(NULL),
+      dir_count(0), file_count(0), child_count(0), slot_count(0), strings_size(0)
+{
+}
+
+LibraryIndex::~LibraryIndex() {
+    close();
+}
+
+bool LibraryIndex::open(const std::string& index_path) {
+    close();
+
+    int fd = ::open(index_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        perror("LibraryIndex: mmap failed");
+        return false;
+    }
+
+    // 64-bit offsets: the counts are untrusted, and size_t is 32 bits on the Kindle
+    const char* base = (const char*)data;
+    uint32_t header[7];
+    memcpy(header, base + 4, sizeof(header));
+    uint64_t dirs_offset = HEADER_SIZE;
+    uint64_t files_offset = dirs_offset + (uint64_t)header[1] * sizeof(LibraryDir);
+    uint64_t children_offset = files_offset + (uint64_t)header[2] * sizeof(LibraryFile);
+    uint64_t slots_offset = children_offset + (uint64_t)header[3] * sizeof(uint32_t);
+    uint64_t strings_offset = slots_offset + (uint64_t)header[4] * sizeof(uint32_t);
+    bool valid = memcmp(base, INDEX_MAGIC, 4) == 0 && header[0] == INDEX_VERSION &&
+                 strings_offset + header[5] == size && (header[4] & (header[4] - 1)) == 0 &&
+                 (header[5] == 0 || base[size - 1] == '\0');
+    if (!valid) {
+        munmap(data, size);
+        return false;
+    }
+
+    map = data;
+    map_size = size;
+    dir_count = header[1];
+    file_count = header[2];
+    child_count = header[3];
+    slot_count = header[4];
+    strings_size = header[5];
+    dirs = (const LibraryDir*)(base + dirs_offset);
+    files = (const LibraryFile*)(base + files_offset);
+    children = (const uint32_t*)(base + children_offset);
+    slots = (const uint32_t*)(base + slots_offset);
+    strings = base + strings_offset;
+    if (!check_records()) {
+        fprintf(stderr, "LibraryIndex: %s is corrupt, ignoring it\n", index_path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Every offset and id in the records points inside the file, and each
+// child's path is its parent's path plus one name, as the writer makes
+// them. Callers rely on this instead of checking each access.
+bool LibraryIndex::check_records() const {
+    for (uint32_t id = 0; id < dir_count; ++id) {
+        const LibraryDir& dir = dirs[id];
+        if (dir.path >= strings_size) return false;
+        if ((uint64_t)dir.first_child + dir.child_count > child_count) return false;
+        if ((uint64_t)dir.first_file + dir.file_count > file_count) return false;
+
+        const char* path = strings + dir.path;
+        size_t path_len = strlen(path);
+        // "/" is the only path that ends in a slash
+        size_t prefix_len = strcmp(path, "/") == 0 ? 1 : path_len + 1;
+        for (uint32_t i = 0; i < dir.child_count; ++i) {
+            uint32_t child = children[dir.first_child + i];
+            if (child >= dir_count || dirs[child].path >= strings_size) return false;
+            const char* child_path = strings + dirs[child].path;
+            if (strncmp(child_path, path, path_len) != 0 || child_path[prefix_len - 1] != '/') return false;
+            const char* name = child_path + prefix_len;
+            if (*name == '\0' || strchr(name, '/')) return false;
+        }
+    }
+    for (uint32_t id = 0; id < file_count; ++id) {
+        if (files[id].name >= strings_size || files[id].dir >= dir_count) return false;
+    }
+    for (uint32_t slot = 0; slot < slot_count; ++slot) {
+        if (slots[slot] > dir_count) return false;
+    }
+    return true;
+}
+
+void LibraryIndex::close() {
+    if (map) munmap(map, map_size);
+    map = NULL;
+    map_size = 0;
+    dirs = NULL;
+    files = NULL;
+    children = NULL;
+    slots = NULL;
+    strings = NULL;
+    dir_count = 0;
+    file_count = 0;
+    child_count = 0;
+    slot_count = 0;
+    strings_size = 0;
+}
+
+int LibraryIndex::get_dir_count() const {
+    return (int)dir_count;
+}
+
+int LibraryIndex::get_file_count() const {
+    return (int)file_count;
+}
+
+int LibraryIndex::find_dir(const char* path) const {
+    if (slot_count == 0) return -1;
+    uint32_t mask = slot_count - 1;
+    for (uint32_t slot = hash_path(path) & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+        uint32_t id = slots[slot] - 1;
+        if (id < dir_count && strcmp(get_string(dirs[id].path), path) == 0) return (int)id;
+    }
+    return -1;
+}
+
+const LibraryDir* LibraryIndex::get_dir(int id) const {
+    return &dirs[id];
+}
+
+const LibraryFile* LibraryIndex::get_file(int id) const {
+    return &files[id];
+}
+
+int LibraryIndex::get_child(const LibraryDir* dir, int index) const {
+    return (int)children[dir->first_child + index];
+}
+
+const char* LibraryIndex::get_string(uint32_t offset) const {
+    if (offset >= strings_size) return NULL;
+    return strings + offset;
+}
+
+bool LibraryIndex::list_tree(const std::string& root, std::vector<std::string>* dirs_out,
+                             std::vector<std::string>* files_out) const {
+    std::string root_path = root;
+    while (root_path.size() > 1 && root_path[root_path.size() - 1] == '/') root_path.erase(root_path.size() - 1);
+    int root_id = find_dir(root_path.c_str());
+    if (root_id < 0) return false;
+
+    std::vector<int> stack(1, root_id);
+    while (!stack.empty()) {
+        const LibraryDir* dir = get_dir(stack.back());
+        stack.pop_back();
+        const char* path = get_string(dir->path);
+        if (!path) continue;
+        if (dirs_out) dirs_out->push_back(path);
+        if (files_out) {
+            for (uint32_t i = 0; i < dir->file_count; ++i) {
+                const char* name = get_string(get_file(dir->first_file + i)->name);
+                if (name) files_out->push_back(std::string(path) + "/" + name);
+            }
+        }
+        // Reversed, so the first subfolder comes out next
+        for (int i = (int)dir->child_count - 1; i >= 0; --i) {
+            int child = get_child(dir, i);
+            if (child >= 0 && child < (int)dir_count) stack.push_back(child);
+        }
+    }
+    return true;
+}
+
+// =================================================================================
+// LibraryIndexWriter
+// =================================================================================
+
+LibraryIndexWriter::LibraryIndexWriter() : file_count(0) {
+}
+
+void LibraryIndexWriter::add_dir(const std::string& path, int64_t mtime, const std::vector<std::string>& subdirs,
+                                 const std::vector<LibraryFileStat>& new_files) {
+    PendingDir dir;
+    dir.path = path;
+    dir.mtime = mtime;
+    dir.subdirs = subdirs;
+
+    dir.files.resize(new_files.size());
+    for (size_t i = 0; i < new_files.size(); ++i) {
+        PendingFile& file = dir.files[i];
+        file.format = (uint8_t)library_format_from_name(new_files[i].name.c_str());
+        file.name = new_files[i].name;
+        file.size = new_files[i].size;
+        file.mtime = new_files[i].mtime;
+    }
+    file_count += (int)dir.files.size();
+    dirs.push_back(dir);
+}
+
+void LibraryIndexWriter::copy_dir(const LibraryIndex& old, int id) {
+    const LibraryDir* old_dir = old.get_dir(id);
+    PendingDir dir;
+    dir.path = old.get_string(old_dir->path);
+    dir.mtime = old_dir->mtime;
+    for (uint32_t i = 0; i < old_dir->child_count; ++i) {
+        const char* child_path = old.get_string(old.get_dir(old.get_child(old_dir, i))->path);
+        dir.subdirs.push_back(strrchr(child_path, '/') + 1);
+    }
+    dir.files.resize(old_dir->file_count);
+    for (uint32_t i = 0; i < old_dir->file_count; ++i) {
+        const LibraryFile* file = old.get_file(old_dir->first_file + i);
+        dir.files[i].format = file->format;
+        dir.files[i].name = old.get_string(file->name);
+        dir.files[i].size = file->size;
+        dir.files[i].mtime = file->mtime;
+    }
+    file_count += (int)dir.files.size();
+    dirs.push_back(dir);
+}
+
+void LibraryIndexWriter::copy_outside(const LibraryIndex& old, const std::string& root) {
+    for (int id = 0; id < old.get_dir_count(); ++id) {
+        const char* path = old.get_string(old.get_dir(id)->path);
+        bool inside = root == "/" || (strncmp(path, root.c_str(), root.size()) == 0 &&
+                                      (path[root.size()] == '\0' || path[root.size()] == '/'));
+        if (!inside) copy_dir(old, id);
+    }
+}
+
+int LibraryIndexWriter::get_dir_count() const {
+    return (int)dirs.size();
+}
+
+int LibraryIndexWriter::get_file_count() const {
+    return file_count;
+}
+
+// Append `text` to the pool. Paths and names are unique, so nothing is
+// shared.
+uint32_t LibraryIndexWriter::add_string(const std::string& text, std::vector<char>* strings) {
+    uint32_t offset = (uint32_t)strings->size();
+    strings->insert(strings->end(), text.begin(), text.end());
+    strings->push_back('\0');
+    return offset;
+}
+
+bool LibraryIndexWriter::write(const std::string& index_path) {
+    std::sort(dirs.begin(), dirs.end(), [](const PendingDir& a, const PendingDir& b) {
+        return a.path < b.path;
+    });
+    std::unordered_map<std::string, uint32_t> ids;
+    for (size_t i = 0; i < dirs.size(); ++i) ids[dirs[i].path] = (uint32_t)i;
+
+    std::vector<LibraryDir> out_dirs(dirs.size());
+    std::vector<LibraryFile> out_files;
+    std::vector<uint32_t> out_children;
+    std::vector<char> strings;
+    out_files.reserve(file_count);
+
+    for (size_t i = 0; i < dirs.size(); ++i) {
+        const PendingDir& dir = dirs[i];
+        LibraryDir& out = out_dirs[i];
+        memset(&out, 0, sizeof(out));
+        out.path = add_string(dir.path, &strings);
+        out.mtime = dir.mtime;
+
+        // Subfolders that could not be read have no entry: leave them out
+        out.first_child = (uint32_t)out_children.size();
+        std::string prefix = dir.path == "/" ? dir.path : dir.path + "/";
+        for (size_t j = 0; j < dir.subdirs.size(); ++j) {
+            auto it = ids.find(prefix + dir.subdirs[j]);
+            if (it != ids.end()) out_children.push_back(it->second);
+        }
+        out.child_count = (uint32_t)out_children.size() - out.first_child;
+
+        out.first_file = (uint32_t)out_files.size();
+        out.file_count = (uint32_t)dir.files.size();
+        for (size_t j = 0; j < dir.files.size(); ++j) {
+            const PendingFile& file = dir.files[j];
+            LibraryFile record;
+            memset(&record, 0, sizeof(record));
+            record.dir = (uint32_t)i;
+            record.name = add_string(file.name, &strings);
+            record.size = file.size;
+            record.mtime = file.mtime;
+            record.format = file.format;
+            out_files.push_back(record);
+        }
+    }
+
+    // Keep the table at most half full
+    uint32_t slot_count = 16;
+    while (slot_count < out_dirs.size() * 2) slot_count *= 2;
+    std::vector<uint32_t> slots(slot_count, 0);
+    for (size_t i = 0; i < out_dirs.size(); ++i) {
+        uint32_t slot = hash_path(dirs[i].path.c_str()) & (slot_count - 1);
+        while (slots[slot] != 0) slot = (slot + 1) & (slot_count - 1);
+        slots[slot] = (uint32_t)i + 1;
+    }
+
+    // Several scanners may write at once (daemon import and rescan, GUI Add
+    // Folder): each needs its own temporary file, or one would truncate or
+    // write into what another has already renamed into place
+    std::string tmp_path = index_path + ".XXXXXX";
+    int fd = mkstemp(&tmp_path[0]);
+    FILE* f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!f) {
+        perror("LibraryIndex: Failed to write index");
+        if (fd >= 0) {
+            ::close(fd);
+            unlink(tmp_path.c_str());
+        }
+        return false;
+    }
+    uint32_t header[7] = { INDEX_VERSION, (uint32_t)out_dirs.size(), (uint32_t)out_files.size(),
+                           (uint32_t)out_children.size(), slot_count, (uint32_t)strings.size(), 0 };
+    bool ok = fwrite(INDEX_MAGIC, 1, 4, f) == 4 && fwrite(header, sizeof(header), 1, f) == 1 &&
+              fwrite(out_dirs.data(), sizeof(LibraryDir), out_dirs.size(), f) == out_dirs.size() &&
+              fwrite(out_files.data(), sizeof(LibraryFile), out_files.size(), f) == out_files.size() &&
+              fwrite(out_children.data(), sizeof(uint32_t), out_children.size(), f) == out_children.size() &&
+              fwrite(slots.data(), sizeof(uint32_t), slots.size(), f) == slots.size() &&
+              fwrite(strings.data(), 1, strings.size(), f) == strings.size();
+    if (fclose(f) != 0) ok = false;
+
+    if (!ok || rename(tmp_path.c_str(), index_path.c_str()) != 0) {
+        perror("LibraryIndex: Failed to write index");
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
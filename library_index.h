@@ -0,0 +1,154 @@
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum LibraryFormat {
+    LIBRARY_FORMAT_UNKNOWN,
+    LIBRARY_FORMAT_MP3,
+    LIBRARY_FORMAT_FLAC,
+    LIBRARY_FORMAT_WAV
+};
+
+// Format of a music file, from its extension (any case)
+LibraryFormat library_format_from_name(const char* name);
+
+// A folder as stored in the index file. Times are in nanoseconds, string
+// fields are offsets in the index's string pool.
+struct LibraryDir {
+    uint32_t path;          // Full path, without trailing slash
+    uint32_t first_child;   // Subfolders: slice of the child table, sorted by name
+    uint32_t child_count;
+    uint32_t first_file;    // Music files: consecutive file ids, sorted by name
+    uint32_t file_count;
+    uint32_t reserved;
+    int64_t mtime;          // Of the folder: changes when entries come, go or are renamed
+};
+
+// A music file as stored in the index file. Tags are not kept here but in
+// the TrackInfoCache, which also covers songs outside the library folders.
+struct LibraryFile {
+    uint32_t dir;
+    uint32_t name;          // File name within the folder
+    int64_t size;
+    int64_t mtime;
+    uint8_t format;         // LibraryFormat
+    uint8_t reserved[7];
+};
+
+// A file in a folder read from disk, for LibraryIndexWriter::add_dir()
+struct LibraryFileStat {
+    std::string name;
+    int64_t size;
+    int64_t mtime;
+};
+
+// --- LibraryIndex Class ---
+// Read-only view of the library index file (~/.kinamp_library.idx): every
+// folder below the imported music folders, with its subfolders and music
+// files. The file is mapped as it is, so opening it costs one pass to
+// check the records and no parsing, and a folder is found by path through
+// a hash table stored in the file.
+//
+// It lets a re-import skip every folder whose mtime has not changed: its
+// entries are taken from here instead of being read again. Files changed
+// in place (same name, folder untouched) are not noticed that way; their
+// size and mtime are here to check them when it matters.
+//
+// Safe to read from several threads; the file is replaced, never changed
+// in place, so a mapped index stays valid while a new one is written.
+class LibraryIndex {
+public:
+    LibraryIndex();
+    ~LibraryIndex();
+
+    // Map `index_path`. A missing or incompatible file yields an empty
+    // index and false.
+    bool open(const std::string& index_path);
+    void close();
+
+    int get_dir_count() const;
+    int get_file_count() const;
+
+    // Id of the folder `path` (no trailing slash), -1 if not indexed
+    int find_dir(const char* path) const;
+
+    // Ids and offsets taken from the index are checked by open(); callers
+    // only need to stay within the counts
+    const LibraryDir* get_dir(int id) const;
+    const LibraryFile* get_file(int id) const;
+    // Folder id of the `index`th subfolder of `dir`
+    int get_child(const LibraryDir* dir, int index) const;
+    // NULL for an offset outside the string pool
+    const char* get_string(uint32_t offset) const;
+
+    // Append the paths of `root` and every folder below it to `dirs`, and
+    // of their music files to `files` (either may be NULL), folder by folder.
+    // False if `root` is not indexed.
+    bool list_tree(const std::string& root, std::vector<std::string>* dirs, std::vector<std::string>* files) const;
+
+private:
+    bool check_records() const;
+
+    void* map;
+    size_t map_size;
+    const LibraryDir* dirs;
+    const LibraryFile* files;
+    const uint32_t* children;
+    const uint32_t* slots;      // Folder id + 1 by path hash, 0 = free
+    const char* strings;
+    uint32_t dir_count;
+    uint32_t file_count;
+    uint32_t child_count;
+    uint32_t slot_count;
+    uint32_t strings_size;
+};
+
+// --- LibraryIndexWriter Class ---
+// Collects the folders of a scan and writes a new index file. Folders can
+// be added in any order; links between them are made by path on write().
+class LibraryIndexWriter {
+public:
+    LibraryIndexWriter();
+
+    // Folder read from disk. `files` must be sorted by name.
+    void add_dir(const std::string& path, int64_t mtime, const std::vector<std::string>& subdirs,
+                 const std::vector<LibraryFileStat>& files);
+
+    // Folder `dir` of `old`, unchanged
+    void copy_dir(const LibraryIndex& old, int dir);
+
+    // Every folder of `old` that is not `root` or below it, e.g. other
+    // imported folders
+    void copy_outside(const LibraryIndex& old, const std::string& root);
+
+    int get_dir_count() const;
+    int get_file_count() const;
+
+    // Write the index to `index_path`, replacing it atomically
+    bool write(const std::string& index_path);
+
+private:
+    struct PendingFile {
+        std::string name;
+        int64_t size;
+        int64_t mtime;
+        uint8_t format;
+    };
+    struct PendingDir {
+        std::string path;
+        int64_t mtime;
+        std::vector<std::string> subdirs;
+        std::vector<PendingFile> files;
+    };
+
+    std::vector<PendingDir> dirs;
+    int file_count;
+
+    static uint32_t add_string(const std::string& text, std::vector<char>* strings);
+};
+
+#endif // LIBRARY_INDEX_H
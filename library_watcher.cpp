@@ -0,0 +1,274 @@
+#include "library_watcher.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <set>
+
+// Folder events that can add or remove music
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+// A root is reported once no event came for it for this long (us): long
+// enough for the gaps between the files of a copied album
+static const gint64 QUIET_TIME = 3000000;
+
+// How often a missing root is looked for again (us)
+static const gint64 RETRY_TIME = 5000000;
+
+static std::string strip_slash(const std::string& path) {
+    std::string result = path;
+    while (result.size() > 1 && result[result.size() - 1] == '/') result.erase(result.size() - 1);
+    return result;
+}
+
+// =================================================================================
+// LibraryWatcher Implementation
+// =================================================================================
+
+GSourceFuncs LibraryWatcher::source_funcs = {
+    LibraryWatcher::source_prepare,
+    LibraryWatcher::source_check,
+    LibraryWatcher::source_dispatch,
+    NULL,
+    NULL,
+    NULL
+};
+
+LibraryWatcher::LibraryWatcher()
+    : source(NULL), next_retry(0), out_of_watches(false), callback(NULL), user_data(NULL)
+{
+    inotify_poll.fd = -1;
+    inotify_poll.events = G_IO_IN;
+    inotify_poll.revents = 0;
+}
+
+LibraryWatcher::~LibraryWatcher() {
+    stop();
+}
+
+bool LibraryWatcher::start(const std::vector<std::string>& root_paths, LibraryChangeCallback cb, void* data) {
+    stop();
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        perror("Library: Failed to start inotify");
+        return false;
+    }
+    inotify_poll.fd = fd;
+    inotify_poll.revents = 0;
+    callback = cb;
+    user_data = data;
+
+    gint64 now = g_get_monotonic_time();
+    for (size_t i = 0; i < root_paths.size(); ++i) {
+        Root root;
+        root.path = strip_slash(root_paths[i]);
+        root.present = false;
+        root.changed = 0;
+        roots.push_back(root);
+        roots.back().present = add_watch(root.path, (int)i);
+        if (!roots.back().present) {
+            g_printerr("Library: %s is missing, waiting for it\n", root.path.c_str());
+            next_retry = now + RETRY_TIME;
+        }
+    }
+
+    source = (Source*)g_source_new(&source_funcs, sizeof(Source));
+    source->watcher = this;
+    g_source_add_poll(&source->base, &inotify_poll);
+    g_source_attach(&source->base, NULL);
+    return true;
+}
+
+void LibraryWatcher::stop() {
+    if (source) {
+        g_source_remove_poll(&source->base, &inotify_poll);
+        g_source_destroy(&source->base);
+        g_source_unref(&source->base);
+        source = NULL;
+    }
+    if (inotify_poll.fd >= 0) {
+        // Closing drops all watches
+        close(inotify_poll.fd);
+        inotify_poll.fd = -1;
+    }
+    roots.clear();
+    watches.clear();
+    next_retry = 0;
+}
+
+void LibraryWatcher::watch_tree(const LibraryIndex& index, const std::string& root_path) {
+    std::string path = strip_slash(root_path);
+    int root = -1;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        if (roots[i].path == path) root = (int)i;
+    }
+    if (root < 0 || !roots[root].present) return;
+
+    std::vector<std::string> dirs;
+    if (!index.list_tree(path, &dirs, NULL)) return;
+    std::set<std::string> wanted(dirs.begin(), dirs.end());
+
+    // Drop watches of folders that are gone or were moved away; a folder
+    // moved within the root gets its new path from add_watch() below
+    std::set<std::string> watched;
+    std::map<int, Watch>::iterator it = watches.begin();
+    while (it != watches.end()) {
+        if (it->second.root == root && !wanted.count(it->second.path)) {
+            inotify_rm_watch(inotify_poll.fd, it->first);
+            watches.erase(it++);
+        } else {
+            if (it->second.root == root) watched.insert(it->second.path);
+            ++it;
+        }
+    }
+    for (size_t i = 0; i < dirs.size(); ++i) {
+        if (!watched.count(dirs[i])) add_watch(dirs[i], root);
+    }
+}
+
+int LibraryWatcher::get_watch_count() const {
+    return (int)watches.size();
+}
+
+bool LibraryWatcher::add_watch(const std::string& path, int root) {
+    int wd = inotify_add_watch(inotify_poll.fd, path.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        if (errno == ENOSPC && !out_of_watches) {
+            g_printerr("Library: Out of inotify watches, raise fs.inotify.max_user_watches\n");
+            out_of_watches = true;
+        }
+        return false;
+    }
+    // Watching a folder twice yields the same descriptor: it was moved
+    Watch& watch = watches[wd];
+    watch.path = path;
+    watch.root = root;
+    return true;
+}
+
+void LibraryWatcher::read_events() {
+    // Aligned for struct inotify_event
+    union {
+        struct inotify_event event;
+        char bytes[4096];
+    } buffer;
+    gint64 now = g_get_monotonic_time();
+
+    while (true) {
+        ssize_t len = read(inotify_poll.fd, buffer.bytes, sizeof(buffer.bytes));
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) break;
+
+        for (ssize_t offset = 0; offset < len;) {
+            const struct inotify_event* event = (const struct inotify_event*)(buffer.bytes + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost: anything may have changed
+                for (size_t i = 0; i < roots.size(); ++i) {
+                    if (roots[i].present) roots[i].changed = now;
+                }
+                continue;
+            }
+            std::map<int, Watch>::iterator it = watches.find(event->wd);
+            if (it == watches.end()) continue;
+            Root& root = roots[it->second.root];
+
+            if (event->mask & IN_IGNORED) {
+                // The folder was deleted or its file system unmounted
+                if (it->second.path == root.path) {
+                    g_print("Library: %s went away\n", root.path.c_str());
+                    root.present = false;
+                    if (next_retry == 0) next_retry = now + RETRY_TIME;
+                }
+                watches.erase(it);
+                root.changed = now;
+                continue;
+            }
+
+            bool is_dir = (event->mask & IN_ISDIR) != 0;
+            const char* name = event->len > 0 ? event->name : NULL;
+            if (is_dir && name && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                // Files that land in it before the watch are found by the rescan
+                add_watch(it->second.path + "/" + name, it->second.root);
+            }
+            // Skip the temporary files of copy tools; their final rename counts
+            if (name && !is_dir && library_format_from_name(name) == LIBRARY_FORMAT_UNKNOWN) continue;
+            root.changed = now;
+        }
+    }
+}
+
+gint64 LibraryWatcher::next_deadline() const {
+    gint64 deadline = next_retry;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        if (roots[i].changed == 0) continue;
+        gint64 quiet = roots[i].changed + QUIET_TIME;
+        if (deadline == 0 || quiet < deadline) deadline = quiet;
+    }
+    return deadline;
+}
+
+void LibraryWatcher::dispatch() {
+    if (inotify_poll.revents) {
+        inotify_poll.revents = 0;
+        read_events();
+    }
+
+    gint64 now = g_get_monotonic_time();
+    if (next_retry != 0 && now >= next_retry) {
+        next_retry = 0;
+        for (size_t i = 0; i < roots.size(); ++i) {
+            if (roots[i].present) continue;
+            roots[i].present = add_watch(roots[i].path, (int)i);
+            if (roots[i].present) {
+                // Rescanned once it has been quiet, like any change
+                g_print("Library: %s is back\n", roots[i].path.c_str());
+                roots[i].changed = now;
+            } else {
+                next_retry = now + RETRY_TIME;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < roots.size(); ++i) {
+        if (roots[i].changed == 0 || now < roots[i].changed + QUIET_TIME) continue;
+        roots[i].changed = 0;
+        // The callback may call watch_tree(), which leaves `roots` alone
+        std::string path = roots[i].path;
+        if (callback) callback(path, user_data);
+    }
+}
+
+gboolean LibraryWatcher::source_prepare(GSource* source, gint* timeout) {
+    LibraryWatcher* self = ((Source*)source)->watcher;
+    gint64 deadline = self->next_deadline();
+    if (deadline == 0) {
+        *timeout = -1;
+        return FALSE;
+    }
+    gint64 now = g_get_monotonic_time();
+    if (now >= deadline) {
+        *timeout = 0;
+        return TRUE;
+    }
+    *timeout = (gint)((deadline - now + 999) / 1000);
+    return FALSE;
+}
+
+gboolean LibraryWatcher::source_check(GSource* source) {
+    LibraryWatcher* self = ((Source*)source)->watcher;
+    if (self->inotify_poll.revents) return TRUE;
+    gint64 deadline = self->next_deadline();
+    return deadline != 0 && g_get_monotonic_time() >= deadline;
+}
+
+gboolean LibraryWatcher::source_dispatch(GSource* source, GSourceFunc callback, gpointer user_data) {
+    (void)callback;
+    (void)user_data;
+    ((Source*)source)->watcher->dispatch();
+    return TRUE;
+}
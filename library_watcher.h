@@ -0,0 +1,82 @@
+#ifndef LIBRARY_WATCHER_H
+#define LIBRARY_WATCHER_H
+
+#include <glib.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "library_index.h"
+
+// Called on the main loop when something changed below `root`, once the
+// folder has been quiet for a while
+typedef void (*LibraryChangeCallback)(const std::string& root, void* user_data);
+
+// --- LibraryWatcher Class ---
+// Notices music being added to or removed from the library folders (over
+// USB, scp, ...) with inotify. The inotify descriptor is polled by a
+// GSource, like the control socket, so there is no thread.
+//
+// Events are not acted on one by one: copying an album gives hundreds of
+// them. They only mark their root as changed, and a root is reported once
+// no event came for it for a few seconds. The caller then rescans the root
+// (cheap with the library index: only changed folders are read) and calls
+// watch_tree() with the new index.
+//
+// inotify watches single folders, so every folder below a root needs its
+// own watch. New folders are watched as soon as they show up; when a root
+// goes away (USB mass storage unmounts /mnt/us), it is retried every few
+// seconds and reported as changed when it is back.
+class LibraryWatcher {
+public:
+    LibraryWatcher();
+    ~LibraryWatcher();
+
+    // Watch `roots` (folders). Only the roots themselves are watched until
+    // watch_tree() is called for them.
+    bool start(const std::vector<std::string>& roots, LibraryChangeCallback callback, void* user_data);
+    void stop();
+
+    // Watch every folder `index` lists below `root`
+    void watch_tree(const LibraryIndex& index, const std::string& root);
+
+    int get_watch_count() const;
+
+private:
+    struct Root {
+        std::string path;
+        bool present;           // Its own watch is in place
+        gint64 changed;         // g_get_monotonic_time() of the last event, 0 = none
+    };
+
+    struct Watch {
+        std::string path;
+        int root;               // Index in `roots`
+    };
+
+    struct Source {
+        GSource base;
+        LibraryWatcher* watcher;
+    };
+
+    GPollFD inotify_poll;
+    Source* source;
+    std::vector<Root> roots;
+    std::map<int, Watch> watches;           // By watch descriptor
+    gint64 next_retry;                      // Of missing roots, 0 = none missing
+    bool out_of_watches;                    // Warned about the inotify watch limit
+    LibraryChangeCallback callback;
+    void* user_data;
+
+    static GSourceFuncs source_funcs;
+
+    bool add_watch(const std::string& path, int root);
+    void read_events();
+    void dispatch();
+    gint64 next_deadline() const;
+    static gboolean source_prepare(GSource* source, gint* timeout);
+    static gboolean source_check(GSource* source);
+    static gboolean source_dispatch(GSource* source, GSourceFunc callback, gpointer user_data);
+};
+
+#endif // LIBRARY_WATCHER_H
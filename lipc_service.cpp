@@ -0,0 +1,291 @@
+#include "lipc_service.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// String getters get their buffer size instead of the registration data
+static LipcService* service_instance = NULL;
+
+struct PropertyInfo {
+    const char* name;
+    bool is_string;
+    bool readable;
+    bool writable;
+};
+
+static const PropertyInfo PROPERTIES[] = {
+    { "state",      true,  true,  false },
+    { "track",      true,  true,  false },
+    { "trackIndex", false, true,  false },
+    { "position",   false, true,  false },
+    { "volume",     false, true,  true  },
+    { "play",       false, false, true  },
+    { "pause",      false, false, true  },
+    { "stop",       false, false, true  },
+    { "next",       false, false, true  },
+    { "prev",       false, false, true  },
+    { "command",    true,  false, true  },
+};
+static const size_t PROPERTY_COUNT = sizeof(PROPERTIES) / sizeof(PROPERTIES[0]);
+
+// powerd events that switch deep buffering on and off
+static const char* POWERD_SERVICE = "com.lab126.powerd";
+static const char* POWER_EVENTS[] = { "goingToScreenSaver", "outOfScreenSaver", "battLevelChanged" };
+static const size_t POWER_EVENT_COUNT = sizeof(POWER_EVENTS) / sizeof(POWER_EVENTS[0]);
+
+// Battery percentage from which to save power with the screen on too
+static const int LOW_BATTERY = 10;
+
+// Reply to commands that could not reach the main loop
+static const char* CLOSING_REPLY = "ERR Shutting down";
+
+// A command handed from a LIPC thread to the main loop
+struct LipcService::Call {
+    LipcService* service;
+    std::string command;
+    std::string reply;
+    bool done;
+    guint source_id;            // Of the idle callback that runs it
+};
+
+LipcService::LipcService()
+    : lipc(NULL), callback(NULL), user_data(NULL), announced(false), last_index(-1), screen_off(false),
+      battery_level(100), power_saving(false), main_thread(pthread_self()), closing(false)
+{
+}
+
+LipcService::~LipcService() {
+    close();
+}
+
+bool LipcService::open(const char* service_name, ControlCommandCallback cb, void* data) {
+    if (service_instance) return false;
+
+    LIPCcode code;
+    lipc = LipcOpenEx(service_name, &code);
+    if (!lipc) {
+        g_printerr("LIPC: Cannot register %s: %s\n", service_name, LipcGetErrorString(code));
+        return false;
+    }
+    callback = cb;
+    user_data = data;
+    service_instance = this;
+    main_thread = pthread_self();
+    {
+        std::lock_guard<std::mutex> guard(calls_lock);
+        closing = false;
+    }
+
+    // Read-only properties get no setter, write-only ones no getter
+    for (size_t i = 0; i < PROPERTY_COUNT; ++i) {
+        const PropertyInfo& p = PROPERTIES[i];
+        if (p.is_string) {
+            LipcRegisterStringProperty(lipc, p.name, p.readable ? get_string : NULL, p.writable ? set_string : NULL, this);
+        } else {
+            LipcRegisterIntProperty(lipc, p.name, p.readable ? get_int : NULL, p.writable ? set_int : NULL, this);
+        }
+    }
+
+    // 0 = no reading (e.g. no powerd)
+    if (LipcGetIntProperty(lipc, POWERD_SERVICE, "battLevel", &battery_level) != LIPC_OK || battery_level <= 0) {
+        battery_level = 100;
+    }
+    // Applied here, before the main loop runs: no event thread yet either
+    power_saving = battery_level <= LOW_BATTERY;
+    if (power_saving) callback("powersave 1", user_data);
+    for (size_t i = 0; i < POWER_EVENT_COUNT; ++i) {
+        LipcSubscribeExt(lipc, POWERD_SERVICE, POWER_EVENTS[i], power_event, this);
+    }
+    g_print("LIPC: Registered %s\n", service_name);
+    return true;
+}
+
+void LipcService::close() {
+    if (!lipc) return;
+
+    // Answer the LIPC threads still waiting for the main loop, which is us
+    {
+        std::lock_guard<std::mutex> guard(calls_lock);
+        closing = true;
+        for (size_t i = 0; i < pending_calls.size(); ++i) {
+            Call* call = pending_calls[i];
+            g_source_remove(call->source_id);
+            call->reply = CLOSING_REPLY;
+            call->done = true;
+        }
+        pending_calls.clear();
+        calls_done.notify_all();
+    }
+
+    for (size_t i = 0; i < POWER_EVENT_COUNT; ++i) {
+        LipcUnsubscribeExt(lipc, POWERD_SERVICE, POWER_EVENTS[i], NULL);
+    }
+    for (size_t i = 0; i < PROPERTY_COUNT; ++i) {
+        LipcUnregisterProperty(lipc, PROPERTIES[i].name, NULL);
+    }
+    LipcClose(lipc);
+    lipc = NULL;
+    service_instance = NULL;
+}
+
+void LipcService::update(const PlayerStatus& status) {
+    if (!lipc) return;
+
+    const char* state = status.paused ? "paused" : (status.playing ? "playing" : "stopped");
+    if (!announced || last_state != state) {
+        last_state = state;
+        LipcCreateAndSendEventWithParameters(lipc, "stateChanged", "%s", state);
+    }
+    if (status.playing && (!announced || last_index != status.index || last_track != status.filepath)) {
+        last_index = status.index;
+        last_track = status.filepath;
+        LipcCreateAndSendEventWithParameters(lipc, "trackChanged", "%d%s", status.index, status.filepath.c_str());
+    }
+    announced = true;
+}
+
+void LipcService::update_power_saving() {
+    bool saving = screen_off || battery_level <= LOW_BATTERY;
+    if (saving == power_saving) return;
+    power_saving = saving;
+    run_command(saving ? "powersave 1" : "powersave 0");
+}
+
+LIPCcode LipcService::power_event(LIPC* lipc, const char* name, LIPCevent* event, void* data) {
+    (void)lipc;
+    LipcService* self = static_cast<LipcService*>(data);
+    if (strcmp(name, "goingToScreenSaver") == 0) {
+        self->screen_off = true;
+    } else if (strcmp(name, "outOfScreenSaver") == 0) {
+        self->screen_off = false;
+    } else if (strcmp(name, "battLevelChanged") == 0) {
+        LipcGetIntParam(event, &self->battery_level);
+    }
+    self->update_power_saving();
+    return LIPC_OK;
+}
+
+// =================================================================================
+// Main Loop Handoff
+// =================================================================================
+
+gboolean LipcService::command_idle_func(gpointer data) {
+    Call* call = static_cast<Call*>(data);
+    LipcService* self = call->service;
+    // close() runs on this thread too, so `call` is still pending here
+    std::string reply = self->callback(call->command, self->user_data);
+
+    std::lock_guard<std::mutex> guard(self->calls_lock);
+    for (size_t i = 0; i < self->pending_calls.size(); ++i) {
+        if (self->pending_calls[i] == call) {
+            self->pending_calls.erase(self->pending_calls.begin() + i);
+            break;
+        }
+    }
+    call->reply = reply;
+    call->done = true;
+    self->calls_done.notify_all();
+    return FALSE;
+}
+
+std::string LipcService::run_command(const std::string& command) {
+    // On the main thread (LIPC dispatching there, or open()): run directly.
+    // Waiting for an idle callback would wait for ourselves.
+    if (pthread_equal(pthread_self(), main_thread)) {
+        return callback(command, user_data);
+    }
+
+    Call call;
+    call.service = this;
+    call.command = command;
+    call.done = false;
+
+    std::unique_lock<std::mutex> guard(calls_lock);
+    if (closing) return CLOSING_REPLY;
+    call.source_id = g_idle_add(command_idle_func, &call);
+    pending_calls.push_back(&call);
+    while (!call.done) calls_done.wait(guard);
+    return call.reply;
+}
+
+// =================================================================================
+// Property Handlers
+// =================================================================================
+
+LIPCcode LipcService::get_int(LIPC* lipc, const char* property, void* value, void* data) {
+    (void)lipc;
+    LipcService* self = static_cast<LipcService*>(data);
+
+    if (strcmp(property, "volume") == 0) {
+        std::string reply = self->run_command("volume");
+        if (reply.compare(0, 3, "OK ") != 0) return LIPC_ERROR_INTERNAL;
+        LIPC_GETTER_VTOI(value) = (int)lrintf(atof(reply.c_str() + 3));
+        return LIPC_OK;
+    }
+
+    PlayerStatus status;
+    if (!parse_player_status(self->run_command("status"), &status)) return LIPC_ERROR_INTERNAL;
+    if (strcmp(property, "trackIndex") == 0) {
+        LIPC_GETTER_VTOI(value) = status.index;
+    } else {
+        LIPC_GETTER_VTOI(value) = (int)(status.position_ms / 1000);
+    }
+    return LIPC_OK;
+}
+
+LIPCcode LipcService::set_int(LIPC* lipc, const char* property, void* value, void* data) {
+    (void)lipc;
+    LipcService* self = static_cast<LipcService*>(data);
+    long int number = LIPC_SETTER_VTOI(value);
+
+    char command[32];
+    if (strcmp(property, "volume") == 0) {
+        snprintf(command, sizeof(command), "volume %ld", number);
+    } else if (strcmp(property, "play") == 0 && number >= 0) {
+        snprintf(command, sizeof(command), "play %ld", number);
+    } else if (strcmp(property, "play") == 0) {
+        // No index: unpause, or pick up where the last session stopped
+        snprintf(command, sizeof(command), "play resume");
+    } else {
+        snprintf(command, sizeof(command), "%s", property);
+    }
+    std::string reply = self->run_command(command);
+    return reply.compare(0, 2, "OK") == 0 ? LIPC_OK : LIPC_ERROR_INVALID_ARG;
+}
+
+LIPCcode LipcService::get_string(LIPC* lipc, const char* property, void* value, void* data) {
+    (void)lipc;
+    LipcService* self = service_instance;
+    if (!self) return LIPC_ERROR_INTERNAL;
+
+    PlayerStatus status;
+    if (!parse_player_status(self->run_command("status"), &status)) return LIPC_ERROR_INTERNAL;
+    std::string text;
+    if (strcmp(property, "state") == 0) {
+        text = status.paused ? "paused" : (status.playing ? "playing" : "stopped");
+    } else {
+        text = status.filepath;
+    }
+
+    // `data` holds the buffer size; ask for a bigger one if needed
+    int size = *(int*)data;
+    if ((int)text.size() + 1 > size) {
+        *(int*)data = (int)text.size() + 1;
+        return LIPC_ERROR_BUFFER_TOO_SMALL;
+    }
+    memcpy(LIPC_GETTER_VTOS(value), text.c_str(), text.size() + 1);
+    return LIPC_OK;
+}
+
+LIPCcode LipcService::set_string(LIPC* lipc, const char* property, void* value, void* data) {
+    (void)lipc;
+    (void)property;
+    LipcService* self = static_cast<LipcService*>(data);
+    std::string reply = self->run_command(LIPC_SETTER_VTOS(value));
+    if (reply.compare(0, 2, "OK") != 0) {
+        g_printerr("LIPC: '%s' failed: %s\n", LIPC_SETTER_VTOS(value), reply.c_str());
+        return LIPC_ERROR_INVALID_ARG;
+    }
+    return LIPC_OK;
+}
@@ -0,0 +1,89 @@
+#ifndef LIPC_SERVICE_H
+#define LIPC_SERVICE_H
+
+#include <glib.h>
+#include <pthread.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "openlipc/openlipc.h"
+#include "control_socket.h"
+
+// Service name KinAMP-minimal registers on the Kindle's LIPC bus
+#define LIPC_SERVICE_NAME "com.kbarni.kinamp"
+
+// --- LipcService Class ---
+// Publishes the player as a LIPC service, so KUAL scripts and other apps
+// can use lipc-get-prop / lipc-set-prop / lipc-wait-event:
+//
+//   state       (string, r)   playing, paused or stopped
+//   track       (string, r)   Path of the current file
+//   trackIndex  (int, r)      Playlist index, -1 = none
+//   position    (int, r)      Seconds into the track
+//   volume      (int, rw)     Volume in dB
+//   play        (int, w)      Play the song at <value>; -1 = "play resume":
+//                             unpause, or the current song from its saved
+//                             position
+//   pause | stop | next | prev  (int, w; value ignored)
+//   command     (string, w)   Any control socket command line
+//
+// Events: stateChanged "<state>", trackChanged <index> "<path>".
+//
+// It also follows powerd: while the screensaver is up or the battery is
+// nearly empty, playback switches to deep, low-wakeup buffering.
+//
+// Everything is mapped onto control protocol commands (control_socket.h),
+// which run on the GLib main loop: LIPC may call property handlers on its
+// own thread, which then waits for the main loop to answer. close() wakes
+// such waiting threads, so they cannot hold up shutdown.
+class LipcService {
+public:
+    LipcService();
+    ~LipcService();
+
+    // Register `service_name` and its properties. Only one instance can be
+    // open at a time. Main thread only, like close().
+    bool open(const char* service_name, ControlCommandCallback callback, void* user_data);
+    void close();
+
+    // Send stateChanged/trackChanged for whatever differs from the last
+    // call. Main loop only.
+    void update(const PlayerStatus& status);
+
+private:
+    LIPC* lipc;
+    ControlCommandCallback callback;
+    void* user_data;
+    bool announced;
+    std::string last_state;
+    int last_index;
+    std::string last_track;
+    bool screen_off;            // powerd state, LIPC event thread only
+    int battery_level;
+    bool power_saving;
+
+    // A command waiting for the main loop, defined in lipc_service.cpp
+    struct Call;
+
+    pthread_t main_thread;      // That runs the main loop and called open()
+    std::mutex calls_lock;      // Guards the three below
+    std::condition_variable calls_done;
+    std::vector<Call*> pending_calls;
+    bool closing;               // No more calls are handed to the main loop
+
+    // Run a control command on the main loop and return its reply
+    std::string run_command(const std::string& command);
+
+    void update_power_saving();
+
+    static gboolean command_idle_func(gpointer data);
+    static LIPCcode power_event(LIPC* lipc, const char* name, LIPCevent* event, void* data);
+    static LIPCcode get_int(LIPC* lipc, const char* property, void* value, void* data);
+    static LIPCcode set_int(LIPC* lipc, const char* property, void* value, void* data);
+    static LIPCcode get_string(LIPC* lipc, const char* property, void* value, void* data);
+    static LIPCcode set_string(LIPC* lipc, const char* property, void* value, void* data);
+};
+
+#endif // LIPC_SERVICE_H
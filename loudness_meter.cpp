@@ -0,0 +1,196 @@
+#include "loudness_meter.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define METER_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define METER_USE_SSE 1
+#endif
+
+// True-peak oversampling: 4 phases of a 48-tap windowed-sinc interpolator,
+// as suggested by BS.1770-4 Annex 2.
+static const int TP_PHASES = 4;
+static const int TP_TAPS = 12;
+static float tp_coeffs[TP_PHASES][TP_TAPS];
+static bool tp_coeffs_ready = false;
+
+static void init_true_peak_filter() {
+    if (tp_coeffs_ready) return;
+    const int n_total = TP_PHASES * TP_TAPS;
+    const double center = (n_total - 1) / 2.0;
+    for (int p = 0; p < TP_PHASES; ++p) {
+        double sum = 0.0;
+        for (int k = 0; k < TP_TAPS; ++k) {
+            int n = k * TP_PHASES + p;
+            double t = (n - center) / TP_PHASES;
+            double sinc = (t == 0.0) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            double window = 0.5 - 0.5 * cos(2.0 * M_PI * (n + 0.5) / n_total);
+            tp_coeffs[p][k] = (float)(sinc * window);
+            sum += tp_coeffs[p][k];
+        }
+        // Unity DC gain for every phase
+        for (int k = 0; k < TP_TAPS; ++k) tp_coeffs[p][k] = (float)(tp_coeffs[p][k] / sum);
+    }
+    tp_coeffs_ready = true;
+}
+
+// Sum of squares over interleaved stereo (both channels weigh 1.0 in R128).
+static double sum_squares(const float* s, size_t n) {
+    size_t i = 0;
+    double total = 0.0;
+#if METER_USE_SSE
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(s + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    total = (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif METER_USE_NEON
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vld1q_f32(s + i);
+        acc = vmlaq_f32(acc, v, v);
+    }
+    float32x2_t folded = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    total = (double)vget_lane_f32(vpadd_f32(folded, folded), 0);
+#endif
+    for (; i < n; ++i) total += (double)s[i] * s[i];
+    return total;
+}
+
+LoudnessMeter::LoudnessMeter(unsigned sample_rate) {
+    init_true_peak_filter();
+
+    // K-weighting pre-filter (high shelf) and RLB high-pass, with the
+    // BS.1770 48 kHz designs re-derived for the actual sample rate.
+    double fs = sample_rate;
+    double f0 = 1681.974450955533, gain_db = 3.999843853973347, q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / fs);
+    double vh = pow(10.0, gain_db / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf.b0 = (float)((vh + vb * k / q + k * k) / a0);
+    shelf.b1 = (float)(2.0 * (k * k - vh) / a0);
+    shelf.b2 = (float)((vh - vb * k / q + k * k) / a0);
+    shelf.a1 = (float)(2.0 * (k * k - 1.0) / a0);
+    shelf.a2 = (float)((1.0 - k / q + k * k) / a0);
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / fs);
+    a0 = 1.0 + k / q + k * k;
+    highpass.b0 = 1.0f;
+    highpass.b1 = -2.0f;
+    highpass.b2 = 1.0f;
+    highpass.a1 = (float)(2.0 * (k * k - 1.0) / a0);
+    highpass.a2 = (float)((1.0 - k / q + k * k) / a0);
+
+    sub_block_len = sample_rate / 10;
+    reset();
+}
+
+void LoudnessMeter::reset() {
+    biquad_reset(&shelf_state);
+    biquad_reset(&highpass_state);
+    sub_block_fill = 0;
+    sub_block_sum = 0.0;
+    recent_count = 0;
+    block_energy.clear();
+    for (int ch = 0; ch < 2; ++ch) history[ch].assign(TP_TAPS - 1, 0.0f);
+    peak = 0.0f;
+}
+
+void LoudnessMeter::push_sub_block() {
+    double energy = sub_block_sum / sub_block_len;
+    sub_block_sum = 0.0;
+    sub_block_fill = 0;
+
+    memmove(recent, recent + 1, sizeof(recent) - sizeof(recent[0]));
+    recent[3] = energy;
+    if (recent_count < 4) ++recent_count;
+    if (recent_count == 4) {
+        block_energy.push_back((recent[0] + recent[1] + recent[2] + recent[3]) / 4.0);
+    }
+}
+
+void LoudnessMeter::add_frames(const float* samples, size_t frames) {
+    scan_true_peak(samples, frames);
+
+    weighted.assign(samples, samples + frames * 2);
+    biquad_process_stereo(weighted.data(), frames, shelf, &shelf_state);
+    biquad_process_stereo(weighted.data(), frames, highpass, &highpass_state);
+
+    const float* p = weighted.data();
+    while (frames > 0) {
+        size_t n = sub_block_len - sub_block_fill;
+        if (n > frames) n = frames;
+        sub_block_sum += sum_squares(p, n * 2);
+        sub_block_fill += n;
+        p += n * 2;
+        frames -= n;
+        if (sub_block_fill == sub_block_len) push_sub_block();
+    }
+}
+
+void LoudnessMeter::scan_true_peak(const float* samples, size_t frames) {
+    for (int ch = 0; ch < 2; ++ch) {
+        // history holds the previous TP_TAPS-1 samples followed by the block
+        std::vector<float>& h = history[ch];
+        h.resize(TP_TAPS - 1 + frames);
+        for (size_t i = 0; i < frames; ++i) h[TP_TAPS - 1 + i] = samples[i * 2 + ch];
+
+        float local_peak = peak;
+        for (size_t i = 0; i < frames; ++i) {
+            const float* x = &h[i];
+            float s = fabsf(x[TP_TAPS - 1]);
+            if (s > local_peak) local_peak = s;
+            for (int p = 0; p < TP_PHASES; ++p) {
+                const float* c = tp_coeffs[p];
+                float acc = 0.0f;
+                for (int k = 0; k < TP_TAPS; ++k) acc += c[k] * x[TP_TAPS - 1 - k];
+                acc = fabsf(acc);
+                if (acc > local_peak) local_peak = acc;
+            }
+        }
+        peak = local_peak;
+        h.erase(h.begin(), h.begin() + frames);
+    }
+}
+
+bool LoudnessMeter::integrated_loudness(double* lufs) const {
+    // Absolute gate at -70 LUFS, expressed as mean-square energy
+    const double abs_gate = pow(10.0, (-70.0 + 0.691) / 10.0);
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < block_energy.size(); ++i) {
+        if (block_energy[i] > abs_gate) {
+            sum += block_energy[i];
+            ++count;
+        }
+    }
+    if (count == 0) return false;
+
+    // Relative gate 10 LU below the absolute-gated mean
+    double rel_gate = (sum / count) * pow(10.0, -10.0 / 10.0);
+    double gated_sum = 0.0;
+    size_t gated_count = 0;
+    for (size_t i = 0; i < block_energy.size(); ++i) {
+        if (block_energy[i] > abs_gate && block_energy[i] > rel_gate) {
+            gated_sum += block_energy[i];
+            ++gated_count;
+        }
+    }
+    if (gated_count == 0) return false;
+
+    *lufs = -0.691 + 10.0 * log10(gated_sum / gated_count);
+    return true;
+}
+
+float LoudnessMeter::true_peak() const {
+    return peak;
+}
@@ -0,0 +1,53 @@
+#ifndef LOUDNESS_METER_H
+#define LOUDNESS_METER_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "biquad.h"
+
+// --- LoudnessMeter Class ---
+// EBU R128 / ITU-R BS.1770-4 integrated loudness and true peak for
+// interleaved stereo float PCM. Feed a whole track through add_frames(),
+// then read the results.
+class LoudnessMeter {
+public:
+    explicit LoudnessMeter(unsigned sample_rate);
+
+    void reset();
+
+    // Analyse `frames` frames of interleaved stereo PCM (not modified).
+    void add_frames(const float* samples, size_t frames);
+
+    // Gated integrated loudness in LUFS. Returns false for digital silence
+    // (no 400 ms block above the -70 LUFS absolute gate).
+    bool integrated_loudness(double* lufs) const;
+
+    // Highest inter-sample peak seen so far (linear, 4x oversampled).
+    float true_peak() const;
+
+private:
+    BiquadCoeffs shelf;
+    BiquadCoeffs highpass;
+    StereoBiquadState shelf_state;
+    StereoBiquadState highpass_state;
+    std::vector<float> weighted;
+
+    // 400 ms gating blocks overlap by 75%, so energy is gathered in 100 ms
+    // sub-blocks and each block is the mean of the last four.
+    size_t sub_block_len;
+    size_t sub_block_fill;
+    double sub_block_sum;
+    double recent[4];
+    size_t recent_count;
+    std::vector<double> block_energy;
+
+    // True-peak oversampler: per-channel input history
+    std::vector<float> history[2];
+    float peak;
+
+    void push_sub_block();
+    void scan_true_peak(const float* samples, size_t frames);
+};
+
+#endif // LOUDNESS_METER_H
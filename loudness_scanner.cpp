@@ -0,0 +1,181 @@
+#include "loudness_scanner.h"
+#include "loudness_meter.h"
+#include "replay_gain.h"
+#include <glib.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "miniaudio/miniaudio.h"
+
+// ReplayGain 2.0 reference level
+static const double REFERENCE_LUFS = -18.0;
+
+// Decode chunk size in frames (~93 ms at 44.1 kHz)
+static const size_t SCAN_CHUNK_FRAMES = 4096;
+
+// How long to back off while playback is struggling
+static const useconds_t THROTTLE_SLEEP_US = 500 * 1000;
+
+// Write results out at most this often so a crash or a background-mode
+// exit loses little work
+static const time_t SAVE_INTERVAL_SEC = 30;
+
+LoudnessScanner::LoudnessScanner(TrackCache* cache)
+    : cache(cache), stop_flag(false), running(false), thread_id(0),
+      throttle_callback(NULL), throttle_user_data(NULL)
+{
+}
+
+LoudnessScanner::~LoudnessScanner() {
+    stop();
+}
+
+void LoudnessScanner::set_throttle_callback(ScanThrottleCallback callback, void* user_data) {
+    throttle_callback = callback;
+    throttle_user_data = user_data;
+}
+
+bool LoudnessScanner::start(const PathList& new_files) {
+    stop();
+
+    files = new_files;
+    stop_flag = false;
+    running = true;
+
+    if (pthread_create(&thread_id, NULL, thread_func, this) != 0) {
+        perror("LoudnessScanner: Failed to create thread");
+        running = false;
+        thread_id = 0;
+        return false;
+    }
+    return true;
+}
+
+void LoudnessScanner::stop() {
+    if (thread_id == 0) return;
+
+    stop_flag = true;
+    pthread_join(thread_id, NULL);
+    thread_id = 0;
+    running = false;
+    cache->save();
+}
+
+bool LoudnessScanner::is_running() const {
+    return running;
+}
+
+void* LoudnessScanner::thread_func(void* arg) {
+    LoudnessScanner* self = static_cast<LoudnessScanner*>(arg);
+
+    // Only run when the CPU would otherwise be idle. SCHED_IDLE is not
+    // available on every kernel, so nice 19 is applied as well.
+#ifdef SCHED_IDLE
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        g_printerr("LoudnessScanner: SCHED_IDLE not available\n");
+    }
+#endif
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+
+    self->scan_loop();
+    self->running = false;
+    return NULL;
+}
+
+void LoudnessScanner::wait_while_throttled() {
+    while (!stop_flag && throttle_callback && throttle_callback(throttle_user_data)) {
+        usleep(THROTTLE_SLEEP_US);
+    }
+}
+
+bool LoudnessScanner::needs_scan(const char* filepath) {
+    ReplayGainInfo info;
+    if (cache->lookup(filepath, &info)) {
+        if (info.has_track || info.has_album || info.scanned) return false;
+    }
+
+    // Unknown file: tagged files never need a scan
+    if (read_replaygain_tags(filepath, &info)) {
+        cache->store(filepath, &info);
+        return false;
+    }
+    return true;
+}
+
+void LoudnessScanner::scan_loop() {
+    g_print("LoudnessScanner: Checking %d files\n", files.size());
+
+    size_t scanned = 0;
+    time_t last_save = time(NULL);
+
+    for (int i = 0; i < files.size() && !stop_flag; ++i) {
+        wait_while_throttled();
+        if (stop_flag) break;
+
+        const char* path = files.get(i);
+        if (!needs_scan(path)) continue;
+        if (!scan_file(path)) continue;
+        ++scanned;
+
+        if (time(NULL) - last_save >= SAVE_INTERVAL_SEC) {
+            cache->save();
+            last_save = time(NULL);
+        }
+    }
+
+    g_print("LoudnessScanner: %s, %zu files measured\n", stop_flag ? "Stopped" : "Done", scanned);
+}
+
+bool LoudnessScanner::scan_file(const char* filepath) {
+    // Same output format as the playback Decoder
+    ma_decoder_config decoder_config = ma_decoder_config_init(ma_format_f32, 2, 44100);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(filepath, &decoder_config, &decoder) != MA_SUCCESS) {
+        g_printerr("LoudnessScanner: Failed to open %s\n", filepath);
+        return false;
+    }
+
+    LoudnessMeter meter(44100);
+    std::vector<float> pcm_buffer(SCAN_CHUNK_FRAMES * 2);
+    bool completed = false;
+
+    while (true) {
+        if (stop_flag) break;
+        wait_while_throttled();
+
+        ma_uint64 frames_read = 0;
+        ma_result result = ma_decoder_read_pcm_frames(&decoder, pcm_buffer.data(), SCAN_CHUNK_FRAMES, &frames_read);
+        if (frames_read > 0) {
+            meter.add_frames(pcm_buffer.data(), frames_read);
+        }
+        if (result != MA_SUCCESS || frames_read < SCAN_CHUNK_FRAMES) {
+            completed = true;
+            break;
+        }
+    }
+    ma_decoder_uninit(&decoder);
+
+    // An interrupted file is simply measured again next time
+    if (!completed) return false;
+
+    ReplayGainInfo info;
+    memset(&info, 0, sizeof(info));
+    info.scanned = 1;
+
+    double lufs;
+    if (meter.integrated_loudness(&lufs)) {
+        info.track_gain = (float)(REFERENCE_LUFS - lufs);
+        info.track_peak = meter.true_peak();
+        info.has_track = 1;
+        g_print("LoudnessScanner: %s: %.1f LUFS, peak %.3f\n", filepath, lufs, info.track_peak);
+    }
+    // Silent files are stored without a gain so they are not rescanned
+    cache->store(filepath, &info);
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef LOUDNESS_SCANNER_H
+#define LOUDNESS_SCANNER_H
+
+#include <atomic>
+#include <pthread.h>
+#include <string>
+
+#include "path_list.h"
+#include "track_cache.h"
+
+// Returns true while the scanner should hold off (e.g. playback buffer low)
+typedef bool (*ScanThrottleCallback)(void* user_data);
+
+// --- LoudnessScanner Class ---
+// Walks a list of files on a SCHED_IDLE / nice 19 thread and measures
+// EBU R128 loudness for every file that has no ReplayGain tags. Results go
+// into the gain cache as track gain/peak, so the Decoder picks them up the
+// next time the file is played. Already known files are skipped, which is
+// what lets an interrupted scan carry on after a restart.
+class LoudnessScanner {
+public:
+    explicit LoudnessScanner(TrackCache* cache);
+    ~LoudnessScanner();
+
+    void set_throttle_callback(ScanThrottleCallback callback, void* user_data);
+
+    // (Re)start scanning `files` in order. Any scan in progress is stopped.
+    bool start(const PathList& files);
+
+    // Stop the scan thread and write pending results to disk.
+    void stop();
+
+    bool is_running() const;
+
+private:
+    TrackCache* cache;
+    PathList files;         // Own copy: PathList is not shared between threads
+    std::atomic<bool> stop_flag;
+    std::atomic<bool> running;
+    pthread_t thread_id;
+
+    ScanThrottleCallback throttle_callback;
+    void* throttle_user_data;
+
+    static void* thread_func(void* arg);
+    void scan_loop();
+    bool needs_scan(const char* filepath);
+    bool scan_file(const char* filepath);
+    void wait_while_throttled();
+};
+
+#endif // LOUDNESS_SCANNER_H
@@ -0,0 +1,69 @@
+#include "m3u_reader.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+
+static const char UTF8_BOM[] = "\xef\xbb\xbf";
+
+// Add one line of the playlist; `line` is not NUL-terminated
+static void add_entry(const char* line, size_t len, const std::string& base_dir, std::string* path, PathList* paths) {
+    if (len > 0 && line[len - 1] == '\r') --len;
+    if (len == 0 || line[0] == '#') return;
+
+    if (line[0] == '/' || base_dir.empty()) {
+        path->assign(line, len);
+    } else {
+        path->assign(base_dir);
+        path->append(line, len);
+    }
+    paths->append(path->c_str());
+}
+
+bool read_m3u(const char* filepath, PathList* paths) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+    const char* data = (const char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("read_m3u: mmap failed");
+        return false;
+    }
+    // Read once, front to back
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+
+    // Relative entries are resolved against the playlist's directory
+    std::string base_dir;
+    const char* slash = strrchr(filepath, '/');
+    if (slash) base_dir.assign(filepath, slash - filepath + 1);
+
+    const char* pos = data;
+    const char* end = data + size;
+    if (size >= 3 && memcmp(pos, UTF8_BOM, 3) == 0) pos += 3;
+
+    std::string path;   // Reused for every entry
+    while (pos < end) {
+        const char* newline = (const char*)memchr(pos, '\n', end - pos);
+        const char* line_end = newline ? newline : end;
+        add_entry(pos, line_end - pos, base_dir, &path, paths);
+        pos = line_end + 1;
+    }
+
+    munmap((void*)data, size);
+    return true;
+}
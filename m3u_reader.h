@@ -0,0 +1,14 @@
+#ifndef M3U_READER_H
+#define M3U_READER_H
+
+#include "path_list.h"
+
+// Append the entries of an M3U/M3U8 playlist to `paths`. The file is
+// mapped and split in place, without a line-by-line stream: comments and
+// extended M3U directives (#EXTM3U, #EXTINF...) are skipped, CRLF line
+// ends and a UTF-8 byte order mark are accepted, and relative entries are
+// taken relative to the playlist's own directory. Returns false if the
+// file cannot be read.
+bool read_m3u(const char* filepath, PathList* paths);
+
+#endif // M3U_READER_H
@@ -0,0 +1,60 @@
+#include "mpeg_frame.h"
+#include <string.h>
+
+uint32_t be32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+uint32_t le32(const unsigned char* p) {
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+uint32_t syncsafe32(const unsigned char* p) {
+    return ((uint32_t)(p[0] & 0x7f) << 21) | ((uint32_t)(p[1] & 0x7f) << 14) |
+           ((uint32_t)(p[2] & 0x7f) << 7) | (p[3] & 0x7f);
+}
+
+bool parse_mpeg_header(const unsigned char* p, MpegHeader* header) {
+    // kbit/s by bitrate index: MPEG1 Layer III, then MPEG2/2.5 Layer III
+    static const unsigned BITRATES[2][15] = {
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+    };
+    static const unsigned RATES[3] = { 44100, 48000, 32000 };
+    if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0) return false;
+    int version = (p[1] >> 3) & 3;      // 3 = MPEG1, 2 = MPEG2, 0 = MPEG2.5
+    int layer = (p[1] >> 1) & 3;        // 1 = Layer III
+    int bitrate = p[2] >> 4;
+    int rate = (p[2] >> 2) & 3;
+    bool mono = (p[3] >> 6) == 3;
+    if (version == 1 || layer != 1 || bitrate == 0 || bitrate == 15 || rate == 3) return false;
+
+    bool mpeg1 = (version == 3);
+    header->sample_rate = RATES[rate] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    header->frame_samples = mpeg1 ? 1152 : 576;
+    header->side_info = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    header->kbps = BITRATES[mpeg1 ? 0 : 1][bitrate];
+    return true;
+}
+
+size_t find_mpeg_frame(const unsigned char* data, size_t len, MpegHeader* header) {
+    for (size_t i = 0; i + 4 <= len; ++i) {
+        if (parse_mpeg_header(data + i, header)) return i;
+    }
+    return len;
+}
+
+bool parse_xing_header(const unsigned char* data, size_t len, size_t frame, const MpegHeader& header,
+                       XingHeader* xing) {
+    size_t pos = frame + 4 + header.side_info;
+    if (pos + 8 > len || (memcmp(data + pos, "Xing", 4) != 0 && memcmp(data + pos, "Info", 4) != 0)) return false;
+    xing->flags = be32(data + pos + 4);
+    pos += 8;
+    xing->frame_count = (xing->flags & 1) && pos + 4 <= len ? be32(data + pos) : 0;
+    if (xing->flags & 1) pos += 4;      // Frame count
+    if (xing->flags & 2) pos += 4;      // Byte count
+    if (xing->flags & 4) pos += 100;    // Seek table
+    if (xing->flags & 8) pos += 4;      // Quality
+    xing->end = pos;
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef MPEG_FRAME_H
+#define MPEG_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-level helpers shared by the tag reader and the gapless info reader:
+// integer fields, MPEG audio Layer III frame headers and the Xing/Info
+// header of a VBR file's first frame. All of them read from memory; the
+// callers fetch the bytes.
+
+uint32_t be32(const unsigned char* p);
+uint32_t le32(const unsigned char* p);
+
+// ID3v2 sizes: 7 bits per byte
+uint32_t syncsafe32(const unsigned char* p);
+
+struct MpegHeader {
+    unsigned sample_rate;
+    unsigned frame_samples;
+    unsigned side_info;         // Bytes between the 4 byte header and the frame data
+    unsigned kbps;              // Bitrate
+};
+
+// Parse a Layer III frame header at `p` (4 bytes); false if it is not one
+bool parse_mpeg_header(const unsigned char* p, MpegHeader* header);
+
+// Offset of the first Layer III frame header in `data`, or `len` if there
+// is none
+size_t find_mpeg_frame(const unsigned char* data, size_t len, MpegHeader* header);
+
+struct XingHeader {
+    uint32_t flags;
+    uint32_t frame_count;       // 0 = not given
+    size_t end;                 // Offset past the optional fields, where a LAME tag starts
+};
+
+// Xing/Info header of the frame at `frame` in `data`, right after its side
+// info; false if the frame does not carry one
+bool parse_xing_header(const unsigned char* data, size_t len, size_t frame, const MpegHeader& header,
+                       XingHeader* xing);
+
+#endif // MPEG_FRAME_H
@@ -1,4 +1,5 @@
 #include "music_backend.h"
+#include "gapless_info.h"
 #include <glib.h>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -8,20 +9,70 @@
 #include <math.h>
 #include <signal.h>
 #include <errno.h>
+#include <sys/ioctl.h>
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <vector>
 
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio/miniaudio.h"
 
+#include "crossfade.h"
+
 const char* PIPE_PATH = "/tmp/kinamp_audio_pipe";
 
+// Output format of the decode path (the GStreamer caps match this)
+static const unsigned SAMPLE_RATE = 44100;
+static const unsigned CHANNELS = 2;
+
+// Record type tag for the gain cache file ("RGv1")
+static const uint32_t GAIN_CACHE_TYPE = 0x31764752;
+
+// Record type tag for the silence cache file ("SIv1")
+static const uint32_t SILENCE_CACHE_TYPE = 0x31764953;
+
+// Seconds between resume checkpoints while playing; kept low to spare the
+// flash, pause/stop/track changes are saved right away anyway
+static const guint RESUME_INTERVAL = 30;
+
+// Pipe sizes: normal playback keeps volume and EQ latency short (0.37 s);
+// deep buffering holds 5.9 s (the default /proc/sys/fs/pipe-max-size)
+static const int PIPE_NORMAL = 65536;
+static const int PIPE_DEEP = 1048576;
+
+// filesrc read size from the pipe, normal / deep buffering
+static const guint READ_SIZE_NORMAL = 4096;
+static const guint READ_SIZE_DEEP = 65536;
+
+// Resize the pipe behind `fd`; returns its capacity afterwards. Shrinking
+// fails while more than the new size is queued.
+static int resize_pipe(int fd, int size, int capacity) {
+#ifdef F_SETPIPE_SZ
+    int result = fcntl(fd, F_SETPIPE_SZ, size);
+    if (result > 0) return result;
+#else
+    (void)fd;
+    (void)size;
+#endif
+    return capacity;
+}
+
+// Playing time of `bytes` of S16 output
+static gint64 pipe_bytes_to_us(int bytes) {
+    return (gint64)bytes * 1000000 / (SAMPLE_RATE * CHANNELS * sizeof(int16_t));
+}
+
 // =================================================================================
 // Decoder Implementation
 // =================================================================================
 
-Decoder::Decoder() : stop_flag(false), running(false), thread_id(0) {
+Decoder::Decoder()
+    : stop_flag(false), running(false), buffer_low(false), low_power(false), thread_id(0), start_frame(0), eq(44100), replaygain_mode(REPLAYGAIN_OFF), gain_cache(NULL),
+      silence_mode(SILENCE_OFF), silence_cache(NULL), crossfade_seconds(0.0f), switch_callback(NULL), switch_user_data(NULL),
+      frames_written(0), mark_count(0), track_count(0), wake_pending(false)
+{
     // Ensure pipe exists
     unlink(PIPE_PATH);
     if (mkfifo(PIPE_PATH, 0666) == -1) {
@@ -34,12 +85,16 @@ Decoder::~Decoder() {
     unlink(PIPE_PATH);
 }
 
-bool Decoder::start(const char* filepath) {
+bool Decoder::start(const char* filepath, uint64_t frame) {
     if (running) {
         stop();
     }
 
     current_filepath = filepath;
+    start_frame = frame;
+    // Positions asked for before the thread gets going
+    reset_position_marks((double)frame);
+    queue_next("");
     stop_flag = false;
     running = true;
 
@@ -56,6 +111,7 @@ void Decoder::stop() {
 
     // Signal stop
     stop_flag = true;
+    wake();
 
     // We assume the caller (MusicBackend) has already broken the pipe 
     // by setting GStreamer state to NULL. This unblocks the write().
@@ -73,57 +129,557 @@ bool Decoder::is_running() const {
     return running;
 }
 
+GainStage& Decoder::gain_stage() {
+    return gain;
+}
+
+Equalizer& Decoder::equalizer() {
+    return eq;
+}
+
+TimeStretch& Decoder::time_stretch() {
+    return stretch;
+}
+
+bool Decoder::is_buffer_low() const {
+    return buffer_low;
+}
+
+void Decoder::set_low_power(bool enable) {
+    low_power = enable;
+    wake();
+}
+
+bool Decoder::is_low_power() const {
+    return low_power;
+}
+
+void Decoder::wake() {
+    std::lock_guard<std::mutex> guard(wake_lock);
+    wake_pending = true;
+    wake_cond.notify_one();
+}
+
+void Decoder::idle_wait(gint64 microseconds) {
+    std::unique_lock<std::mutex> guard(wake_lock);
+    if (!wake_pending) {
+        wake_cond.wait_for(guard, std::chrono::microseconds(microseconds));
+    }
+    wake_pending = false;
+}
+
+void Decoder::set_replaygain(ReplayGainMode mode, TrackCache* cache) {
+    replaygain_mode = mode;
+    gain_cache = cache;
+}
+
+void Decoder::set_silence_trim(SilenceMode mode, TrackCache* cache) {
+    silence_mode = mode;
+    silence_cache = cache;
+}
+
+void Decoder::set_crossfade(float seconds) {
+    crossfade_seconds = seconds;
+}
+
+float Decoder::get_crossfade() const {
+    return crossfade_seconds;
+}
+
+void Decoder::queue_next(const std::string& filepath) {
+    std::lock_guard<std::mutex> guard(next_lock);
+    next_filepath = filepath;
+}
+
+void Decoder::set_switch_callback(TrackSwitchCallback callback, void* user_data) {
+    switch_callback = callback;
+    switch_user_data = user_data;
+}
+
+void Decoder::lookup_replaygain(const std::string& filepath, float* gain_db, float* peak) {
+    *gain_db = 0.0f;
+    *peak = 0.0f;
+    ReplayGainMode mode = (ReplayGainMode)replaygain_mode.load();
+
+    if (mode != REPLAYGAIN_OFF) {
+        ReplayGainInfo info;
+        const char* path = filepath.c_str();
+        if (!gain_cache || !gain_cache->lookup(path, &info)) {
+            // Cache misses (including untagged files) are stored too,
+            // so tags are parsed once per file, not once per play.
+            read_replaygain_tags(path, &info);
+            if (gain_cache) gain_cache->store(path, &info);
+        }
+        if (replaygain_select(info, mode, gain_db, peak)) {
+            g_print("Decoder: ReplayGain %+.2f dB (peak %.3f)\n", *gain_db, *peak);
+        }
+    }
+}
+
+void Decoder::reset_position_marks(double origin) {
+    std::lock_guard<std::mutex> guard(mark_lock);
+    mark_count = 0;
+    frames_written = 0;
+    track_starts[0].media_frame = 0.0;
+    track_starts[0].origin = origin;
+    track_starts[0].filepath = current_filepath;
+    track_count = 1;
+}
+
+void Decoder::add_track_start(double media_frame, double origin, const std::string& filepath) {
+    std::lock_guard<std::mutex> guard(mark_lock);
+    TrackStart& start = track_starts[track_count % TRACK_STARTS];
+    start.media_frame = media_frame;
+    start.origin = origin;
+    start.filepath = filepath;
+    ++track_count;
+}
+
+// Newest track that starts at or before `media_frame`. mark_lock held.
+size_t Decoder::track_index(double media_frame) const {
+    size_t oldest = track_count > TRACK_STARTS ? track_count - TRACK_STARTS : 0;
+    size_t i = track_count - 1;
+    while (i > oldest && track_starts[i % TRACK_STARTS].media_frame > media_frame) --i;
+    return i;
+}
+
+void Decoder::add_position_mark(double media_frame, float speed) {
+    std::lock_guard<std::mutex> guard(mark_lock);
+    PositionMark& mark = marks[mark_count % POSITION_MARKS];
+    mark.out_frame = frames_written;
+    mark.media_frame = media_frame;
+    mark.speed = speed;
+    ++mark_count;
+}
+
+// Media frame being played after `out_frame` output frames. mark_lock held.
+double Decoder::media_frame_at(gint64 out_frame) const {
+    if (mark_count == 0) return 0.0;
+
+    // Newest mark at or before the frame being heard. Marks older than the
+    // ring are long gone from the pipe; fall back to the oldest one kept.
+    size_t oldest = mark_count > POSITION_MARKS ? mark_count - POSITION_MARKS : 0;
+    size_t i = mark_count - 1;
+    while (i > oldest && marks[i % POSITION_MARKS].out_frame > out_frame) --i;
+
+    const PositionMark& mark = marks[i % POSITION_MARKS];
+    double media_frame = mark.media_frame;
+    if (out_frame > mark.out_frame) media_frame += (out_frame - mark.out_frame) * mark.speed;
+    return media_frame;
+}
+
+gint64 Decoder::media_position(gint64 running_time) {
+    return gst_util_uint64_scale(media_position_frames(running_time), GST_SECOND, SAMPLE_RATE);
+}
+
+uint64_t Decoder::media_position_frames(gint64 running_time) {
+    gint64 out_frame = gst_util_uint64_scale(running_time, SAMPLE_RATE, GST_SECOND);
+
+    std::lock_guard<std::mutex> guard(mark_lock);
+    if (mark_count == 0) return (uint64_t)track_starts[0].origin;
+
+    // Relative to the start of the track being heard
+    double media_frame = media_frame_at(out_frame);
+    const TrackStart& start = track_starts[track_index(media_frame) % TRACK_STARTS];
+    media_frame += start.origin - start.media_frame;
+    if (media_frame < 0.0) media_frame = 0.0;
+    return (uint64_t)(media_frame + 0.5);
+}
+
+int Decoder::audible_track(gint64 running_time, std::string* filepath) {
+    gint64 out_frame = gst_util_uint64_scale(running_time, SAMPLE_RATE, GST_SECOND);
+
+    std::lock_guard<std::mutex> guard(mark_lock);
+    if (track_count == 0) return 0;
+    size_t i = track_index(media_frame_at(out_frame));
+    if (filepath) *filepath = track_starts[i % TRACK_STARTS].filepath;
+    return (int)i;
+}
+
+int Decoder::latest_track() {
+    std::lock_guard<std::mutex> guard(mark_lock);
+    return track_count > 0 ? (int)track_count - 1 : 0;
+}
+
 void* Decoder::thread_func(void* arg) {
     Decoder* self = static_cast<Decoder*>(arg);
     self->decode_loop();
     return NULL;
 }
 
+// One open input file: miniaudio decoder plus gapless trimming
+struct Decoder::Source {
+    ma_decoder decoder;
+    GaplessTrimmer trimmer;
+    std::string filepath;
+    bool is_open;
+    bool input_ended;       // Decoder has nothing more
+    bool ended;             // ... and everything was read
+    bool length_known;
+    uint64_t length;        // Trimmed length in output frames, 0 = unknown
+    uint64_t position;      // Trimmed frames read so far
+    float gain_db;          // ReplayGain
+    float peak;
+
+    // Silence trimming. Input frames count from the start of the trimmed
+    // track, output frames are what is left after dropping silence.
+    SilenceTrimmer silence;
+    SilenceInfo silence_info;   // Cached results, updated as they come in
+    uint64_t input_frame;       // Next input frame
+    std::vector<float> kept;    // Output of the silence stage not yet read
+    size_t kept_pos;
+    bool start_stored;
+
+    Source() : is_open(false), input_ended(false), ended(false), length_known(false), length(0), position(0), gain_db(0.0f), peak(0.0f),
+               input_frame(0), kept_pos(0), start_stored(false) {}
+};
+
+bool Decoder::open_source(Source* src, const std::string& filepath, uint64_t start_frame) {
+    // Decode to float so the DSP stages keep full precision; the GainStage
+    // converts back to S16 (with dither) right before the pipe.
+    ma_decoder_config decoder_config = ma_decoder_config_init(ma_format_f32, CHANNELS, SAMPLE_RATE);
+    if (ma_decoder_init_file(filepath.c_str(), &decoder_config, &src->decoder) != MA_SUCCESS) {
+        g_printerr("Decoder: Failed to open file with miniaudio: %s\n", filepath.c_str());
+        return false;
+    }
+
+    src->filepath = filepath;
+    src->is_open = true;
+    src->input_ended = false;
+    src->ended = false;
+    src->length_known = false;
+    src->length = 0;
+    src->position = 0;
+
+    // Encoder delay/padding is trimmed right at the decoder output, so
+    // everything downstream (speed, position marks) sees only real audio.
+    GaplessInfo gapless;
+    bool has_gapless = read_gapless_info(filepath.c_str(), &gapless);
+    if (has_gapless) {
+        g_print("Decoder: Gapless trim %llu + %llu frames kept @ %u Hz\n",
+                (unsigned long long)gapless.skip_frames, (unsigned long long)gapless.valid_frames,
+                gapless.sample_rate);
+    }
+    src->trimmer.start(has_gapless ? &gapless : NULL, SAMPLE_RATE);
+
+    lookup_replaygain(filepath, &src->gain_db, &src->peak);
+
+    src->input_frame = 0;
+    src->kept.clear();
+    src->kept_pos = 0;
+    src->start_stored = false;
+    memset(&src->silence_info, 0, sizeof(src->silence_info));
+    SilenceMode mode = (SilenceMode)silence_mode.load();
+    bool leading_done = false;
+    uint64_t seek_frame = 0;
+    if (mode != SILENCE_OFF && silence_cache && silence_cache->lookup(filepath.c_str(), &src->silence_info)) {
+        // Known file: jump straight past the leading silence
+        if (src->silence_info.has_start) {
+            leading_done = true;
+            src->start_stored = true;
+            seek_frame = src->silence_info.audio_start;
+        }
+    }
+    if (start_frame > seek_frame) {
+        // Resuming mid-track, past any leading silence
+        seek_frame = start_frame;
+        leading_done = true;
+    }
+    if (seek_frame > 0) {
+        if (ma_decoder_seek_to_pcm_frame(&src->decoder, src->trimmer.seek(seek_frame)) == MA_SUCCESS) {
+            src->input_frame = seek_frame;
+            g_print("Decoder: Starting at %.3f s\n", (double)seek_frame / SAMPLE_RATE);
+        } else {
+            g_printerr("Decoder: Seek failed, starting from the beginning\n");
+            src->trimmer.start(has_gapless ? &gapless : NULL, SAMPLE_RATE);
+            leading_done = false;
+        }
+    }
+    src->silence.start(mode, src->input_frame, leading_done);
+    return true;
+}
+
+// Merge fresh detection results into the silence cache
+void Decoder::store_silence_info(Source* src) {
+    if (!silence_cache) return;
+    SilenceInfo& info = src->silence_info;
+    uint64_t frame;
+    bool changed = false;
+    if (!info.has_start && src->silence.leading_result(&frame)) {
+        info.audio_start = (uint32_t)frame;
+        info.has_start = 1;
+        changed = true;
+    }
+    if (src->silence.trailing_result(&frame) && (!info.has_end || info.audio_end != frame)) {
+        info.audio_end = (uint32_t)frame;
+        info.has_end = 1;
+        changed = true;
+    }
+    if (changed) silence_cache->store(src->filepath.c_str(), &info);
+}
+
+void Decoder::close_source(Source* src) {
+    if (!src->is_open) return;
+    ma_decoder_uninit(&src->decoder);
+    src->is_open = false;
+}
+
+// Fill `pcm` with up to `frames` trimmed frames; fewer only at the end
+size_t Decoder::read_source(Source* src, float* pcm, size_t frames) {
+    size_t got = 0;
+    while (got < frames) {
+        // Drain what the silence stage let through first
+        size_t kept = src->kept.size() / CHANNELS - src->kept_pos;
+        if (kept > 0) {
+            size_t n = kept < frames - got ? kept : frames - got;
+            memcpy(pcm + got * CHANNELS, &src->kept[src->kept_pos * CHANNELS], n * CHANNELS * sizeof(float));
+            src->kept_pos += n;
+            got += n;
+            continue;
+        }
+        if (src->input_ended) break;
+
+        ma_uint64 frames_read = 0;
+        ma_result result = ma_decoder_read_pcm_frames(&src->decoder, pcm + got * CHANNELS, frames - got, &frames_read);
+        if (result != MA_SUCCESS || frames_read == 0) {
+            // End of file or error
+            src->input_ended = true;
+            if (!src->silence.is_active()) break;
+            src->kept.clear();
+            src->kept_pos = 0;
+            src->silence.finish(&src->kept);
+            store_silence_info(src);
+            continue;
+        }
+        size_t offset = 0;
+        size_t keep = src->trimmer.process(pcm + got * CHANNELS, frames_read, &offset);
+        if (offset > 0 && keep > 0) {
+            memmove(pcm + got * CHANNELS, pcm + (got + offset) * CHANNELS, keep * CHANNELS * sizeof(float));
+        }
+        // Only encoder padding (or cached trailing silence) left
+        if (src->trimmer.finished()) src->input_ended = true;
+        uint64_t audio_end = src->silence_info.has_end ? src->silence_info.audio_end : 0;
+        if (audio_end > 0 && src->input_frame + keep >= audio_end) {
+            keep = audio_end > src->input_frame ? (size_t)(audio_end - src->input_frame) : 0;
+            src->input_ended = true;
+        }
+        src->input_frame += keep;
+
+        if (!src->silence.is_active()) {
+            got += keep;
+            continue;
+        }
+        uint64_t leading;
+        src->kept.clear();
+        src->kept_pos = 0;
+        src->silence.process(pcm + got * CHANNELS, keep, &src->kept);
+        if (src->input_ended) {
+            src->silence.finish(&src->kept);
+            store_silence_info(src);
+        } else if (!src->start_stored && src->silence.leading_result(&leading)) {
+            src->start_stored = true;
+            store_silence_info(src);
+        }
+    }
+    if (src->input_ended && src->kept_pos * CHANNELS == src->kept.size()) src->ended = true;
+    src->position += got;
+    return got;
+}
+
+// Length of the track, looked up the first time it is needed (miniaudio
+// has to walk the whole file for VBR MP3s). 0 = unknown.
+uint64_t Decoder::source_length(Source* src) {
+    if (!src->length_known) {
+        src->length_known = true;
+        ma_uint64 frames = 0;
+        if (ma_decoder_get_length_in_pcm_frames(&src->decoder, &frames) == MA_SUCCESS && frames > 0) {
+            src->length = src->trimmer.trimmed_length(frames);
+        }
+        // Cached trailing silence is never played
+        const SilenceInfo& info = src->silence_info;
+        if (info.has_end && info.audio_end > 0 && (src->length == 0 || info.audio_end < src->length)) {
+            src->length = info.audio_end;
+        }
+    }
+    return src->length;
+}
+
 void Decoder::decode_loop() {
     g_print("Decoder: Starting for %s\n", current_filepath.c_str());
 
-    ma_decoder_config decoder_config = ma_decoder_config_init(ma_format_s16, 2, 44100);
-    ma_decoder decoder;
-    ma_result result = ma_decoder_init_file(current_filepath.c_str(), &decoder_config, &decoder);
-    if (result != MA_SUCCESS) {
-        g_printerr("Decoder: Failed to open file with miniaudio: %s\n", current_filepath.c_str());
-        return;
-    }
+    // The playing file and, during a crossfade, the one fading in
+    Source sources[2];
+    Source* src = &sources[0];
+    Source* next = &sources[1];
+    if (!open_source(src, current_filepath, start_frame)) return;
 
     int fd = open(PIPE_PATH, O_WRONLY);
     if (fd == -1) {
         perror("Decoder: Failed to open pipe");
-        ma_decoder_uninit(&decoder);
+        close_source(src);
         return;
     }
 
+    // Anything below a quarter of the pipe counts as "buffer low"
+    int pipe_capacity = PIPE_NORMAL;
+#ifdef F_GETPIPE_SZ
+    int size = fcntl(fd, F_GETPIPE_SZ);
+    if (size > 0) pipe_capacity = size;
+#endif
+    bool deep = false;
+
     const size_t BUFFER_SIZE = 4096;
-    std::vector<int16_t> pcm_buffer(BUFFER_SIZE);
+    const size_t BLOCK_FRAMES = BUFFER_SIZE / CHANNELS;
+    std::vector<float> pcm_buffer(BUFFER_SIZE);
+    std::vector<float> next_buffer(BUFFER_SIZE);
+    std::vector<float> stretch_buffer;
+    std::vector<int16_t> out_buffer(BUFFER_SIZE);
 
-    while (!stop_flag) {
-        ma_uint64 frames_read = 0;
-        result = ma_decoder_read_pcm_frames(&decoder, pcm_buffer.data(), BUFFER_SIZE / decoder.outputChannels, &frames_read);
-        
-        if (result != MA_SUCCESS || frames_read == 0) {
-            // End of file or error
-            break;
+    gain.set_track_gain(src->gain_db, src->peak);
+    gain.reset();
+    eq.reset();
+    stretch.reset();
+    reset_position_marks((double)src->input_frame);
+
+    Crossfade fade;
+    bool fade_checked = false;  // Queue looked at for the current track
+    size_t fade_offset = 0;     // Where in the current block the fade starts
+    uint64_t media_fed = 0;     // Frames handed to the time stretcher
+
+    bool end_of_file = false;
+    while (!stop_flag && !end_of_file) {
+        size_t frames_read = read_source(src, pcm_buffer.data(), BLOCK_FRAMES);
+
+        // Open the queued file once the current one is within the fade
+        // window of its end. Until then only one file is decoded.
+        float fade_seconds = crossfade_seconds;
+        if (!fade.is_active() && !fade_checked && fade_seconds > 0.0f && frames_read > 0) {
+            uint64_t length = source_length(src);
+            uint64_t fade_frames = (uint64_t)(fade_seconds * SAMPLE_RATE);
+            // Input frames, so that dropped silence does not delay the fade
+            uint64_t position = src->input_frame - (src->kept.size() / CHANNELS - src->kept_pos);
+            uint64_t block_start = position > frames_read ? position - frames_read : 0;
+            if (length == 0) {
+                fade_checked = true; // Unknown length: plain end of track
+            } else if (position + fade_frames >= length) {
+                fade_checked = true;
+                std::string next_path;
+                {
+                    std::lock_guard<std::mutex> guard(next_lock);
+                    next_path.swap(next_filepath);
+                }
+                if (!next_path.empty() && open_source(next, next_path, 0)) {
+                    uint64_t fade_start = length > fade_frames ? length - fade_frames : 0;
+                    fade_offset = fade_start > block_start ? (size_t)(fade_start - block_start) : 0;
+                    uint64_t fade_from = block_start + fade_offset;
+                    uint64_t fade_length = length > fade_from ? length - fade_from : BLOCK_FRAMES;
+                    // The incoming track's ReplayGain, relative to the
+                    // gain stage's current (outgoing) one
+                    float in_gain = GainStage::track_gain_factor(next->gain_db, next->peak) /
+                                    GainStage::track_gain_factor(src->gain_db, src->peak);
+                    fade.start((size_t)fade_length, in_gain);
+                    add_track_start((double)(media_fed + fade_offset), (double)next->input_frame, next_path);
+                    g_print("Decoder: Crossfading into %s over %.1f s\n", next_path.c_str(),
+                            (double)fade_length / SAMPLE_RATE);
+                    if (switch_callback) switch_callback(switch_user_data);
+                }
+            }
         }
 
-        ssize_t to_write = frames_read * ma_get_bytes_per_frame(decoder.outputFormat, decoder.outputChannels);
-        ssize_t written = write(fd, pcm_buffer.data(), to_write);
+        size_t in_frames = frames_read;
+        bool switch_track = false;
+        if (fade.is_active()) {
+            // From fade_offset on, the block is a mix of both files. If the
+            // current file ends early it fades out as silence.
+            size_t offset = fade_offset < in_frames ? fade_offset : in_frames;
+            fade_offset = 0;
+            size_t span = BLOCK_FRAMES - offset;
+            std::fill(pcm_buffer.begin() + in_frames * CHANNELS, pcm_buffer.end(), 0.0f);
+            size_t got = read_source(next, next_buffer.data(), span);
+            std::fill(next_buffer.begin() + got * CHANNELS, next_buffer.begin() + span * CHANNELS, 0.0f);
+            fade.process(&pcm_buffer[offset * CHANNELS], next_buffer.data(), span);
+            in_frames = offset + span;
+            switch_track = fade.is_done() || (src->ended && next->ended);
+        }
+        // End of file or error, or only encoder padding left
+        bool input_done = fade.is_active() ? (switch_track && next->ended) : src->ended;
 
-        if (written == -1) {
-            if (errno == EPIPE) {
-                // Reader closed pipe, expected during stop
+        // Time stretching changes the block size, so the rest of the chain
+        // runs on whatever it produced, in BLOCK_FRAMES pieces.
+        double media_frame = stretch.media_position();
+        float speed = stretch.get_speed();
+        stretch_buffer.clear();
+        if (in_frames > 0) {
+            stretch.process(pcm_buffer.data(), in_frames, &stretch_buffer);
+            media_fed += in_frames;
+        }
+        if (input_done) {
+            stretch.flush(&stretch_buffer);
+            end_of_file = true;
+        }
+
+        size_t total = stretch_buffer.size() / CHANNELS;
+        for (size_t done = 0; done < total && !stop_flag; ) {
+            size_t frames = total - done;
+            if (frames > BLOCK_FRAMES) frames = BLOCK_FRAMES;
+            float* block = &stretch_buffer[done * CHANNELS];
+
+            add_position_mark(media_frame + done * speed, speed);
+            eq.process(block, frames);
+            gain.process(block, out_buffer.data(), frames, CHANNELS);
+
+            ssize_t to_write = frames * ma_get_bytes_per_frame(ma_format_s16, CHANNELS);
+            ssize_t written = write(fd, out_buffer.data(), to_write);
+
+            if (written == -1) {
+                if (errno != EPIPE) {
+                    perror("Decoder: write error");
+                }
+                // EPIPE: reader closed pipe, expected during stop
+                end_of_file = true;
                 break;
             }
-            perror("Decoder: write error");
-            break;
+            frames_written += frames;
+            done += frames;
+
+            int queued = 0;
+            if (ioctl(fd, FIONREAD, &queued) == 0) {
+                buffer_low = queued < pipe_capacity / 4;
+            }
+
+            if (low_power != deep) {
+                deep = low_power;
+                if (deep) pipe_capacity = resize_pipe(fd, PIPE_DEEP, pipe_capacity);
+                g_print("Decoder: %s buffering, pipe %d bytes\n", deep ? "Deep" : "Normal", pipe_capacity);
+            }
+            if (!deep && pipe_capacity > PIPE_NORMAL) {
+                // Back from deep buffering: let the pipe drain, then shrink
+                // it so volume and EQ changes are heard quickly again
+                if (queued > PIPE_NORMAL / 2) {
+                    idle_wait(pipe_bytes_to_us(queued - PIPE_NORMAL / 2));
+                } else {
+                    pipe_capacity = resize_pipe(fd, PIPE_NORMAL, pipe_capacity);
+                }
+            } else if (deep && queued >= pipe_capacity - to_write) {
+                // Full: sleep until a quarter is left, then refill in one go
+                idle_wait(pipe_bytes_to_us(queued - pipe_capacity / 4));
+            }
+        }
+
+        if (switch_track && !end_of_file) {
+            // The incoming file carries on alone at its own ReplayGain
+            close_source(src);
+            std::swap(src, next);
+            gain.switch_track_gain(src->gain_db, src->peak);
+            fade.stop();
+            fade_checked = false;
         }
     }
 
+    buffer_low = false;
     close(fd);
-    ma_decoder_uninit(&decoder);
+    close_source(src);
+    close_source(next);
     g_print("Decoder: Thread exiting.\n");
 }
 
@@ -133,18 +689,101 @@ void Decoder::decode_loop() {
 // =================================================================================
 
 MusicBackend::MusicBackend() 
-    : is_playing(false), is_paused(false), pipeline(NULL), bus(NULL), bus_watch_id(0),
-      stopping(false), on_eos_callback(NULL), eos_user_data(NULL), last_position(0)
+    : is_playing(false), is_paused(false), gain_cache(GAIN_CACHE_TYPE, sizeof(ReplayGainInfo)),
+      replaygain_mode(REPLAYGAIN_TRACK), silence_cache(SILENCE_CACHE_TYPE, sizeof(SilenceInfo)),
+      silence_mode(SILENCE_OFF), pipeline(NULL), bus(NULL), bus_watch_id(0),
+      stopping(false), on_eos_callback(NULL), eos_user_data(NULL), on_track_change_callback(NULL),
+      track_change_user_data(NULL), last_frame(0), audible_track(0), switch_watch_id(0),
+      resume_timer_id(0)
 {
     // Ignore SIGPIPE globally for this process
     signal(SIGPIPE, SIG_IGN);
     
     gst_init(NULL, NULL);
     decoder = std::unique_ptr<Decoder>(new Decoder());
+    decoder->set_replaygain(replaygain_mode, &gain_cache);
+    decoder->set_switch_callback(decoder_switch_func, this);
+    scanner = std::unique_ptr<LoudnessScanner>(new LoudnessScanner(&gain_cache));
+    scanner->set_throttle_callback(scan_throttle_func, this);
 }
 
 MusicBackend::~MusicBackend() {
+    stop_loudness_scan();
     stop();
+    flush_caches();
+}
+
+void MusicBackend::set_replaygain_mode(ReplayGainMode mode) {
+    replaygain_mode = mode;
+    decoder->set_replaygain(mode, &gain_cache);
+}
+
+ReplayGainMode MusicBackend::get_replaygain_mode() const {
+    return replaygain_mode;
+}
+
+void MusicBackend::open_gain_cache(const std::string& path) {
+    gain_cache.load(path);
+    g_print("Backend: %zu cached gain entries\n", gain_cache.size());
+}
+
+void MusicBackend::set_silence_trim(SilenceMode mode) {
+    if (mode < SILENCE_OFF || mode > SILENCE_SPEECH) mode = SILENCE_OFF;
+    silence_mode = mode;
+    decoder->set_silence_trim(mode, &silence_cache);
+}
+
+SilenceMode MusicBackend::get_silence_trim() const {
+    return silence_mode;
+}
+
+void MusicBackend::open_silence_cache(const std::string& path) {
+    silence_cache.load(path);
+    g_print("Backend: %zu cached silence entries\n", silence_cache.size());
+}
+
+void MusicBackend::open_resume_file(const std::string& path) {
+    if (resume.load(path)) {
+        g_print("Backend: Resume point %s @ %llu\n", resume.get_filepath().c_str(),
+                (unsigned long long)resume.get_frame(resume.get_filepath().c_str()));
+    }
+}
+
+const std::string& MusicBackend::get_resume_filepath() const {
+    return resume.get_filepath();
+}
+
+uint64_t MusicBackend::get_resume_frame(const char* filepath) const {
+    return resume.get_frame(filepath);
+}
+
+void MusicBackend::checkpoint() {
+    if (!is_playing && !is_paused) return;
+    resume.save(current_filepath_str, get_position_frames());
+}
+
+gboolean MusicBackend::resume_timer_func(gpointer data) {
+    MusicBackend* self = static_cast<MusicBackend*>(data);
+    if (!self->is_paused) self->checkpoint();
+    return TRUE;
+}
+
+void MusicBackend::flush_caches() {
+    gain_cache.save();
+    silence_cache.save();
+}
+
+void MusicBackend::start_loudness_scan(const PathList& files) {
+    scanner->start(files);
+}
+
+void MusicBackend::stop_loudness_scan() {
+    scanner->stop();
+}
+
+bool MusicBackend::scan_throttle_func(void* data) {
+    MusicBackend* self = static_cast<MusicBackend*>(data);
+    return self->decoder->is_buffer_low();
 }
 
 bool MusicBackend::is_shutting_down() const {
@@ -160,6 +799,68 @@ void MusicBackend::set_eos_callback(EosCallback callback, void* user_data) {
     eos_user_data = user_data;
 }
 
+void MusicBackend::set_volume_db(float db) {
+    decoder->gain_stage().set_volume_db(db);
+}
+
+float MusicBackend::get_volume_db() const {
+    return decoder->gain_stage().get_volume_db();
+}
+
+void MusicBackend::set_speed(float speed) {
+    decoder->time_stretch().set_speed(speed);
+}
+
+float MusicBackend::get_speed() const {
+    return decoder->time_stretch().get_speed();
+}
+
+void MusicBackend::set_crossfade(float seconds) {
+    if (seconds > 0.0f) {
+        if (seconds < Crossfade::MIN_SECONDS) seconds = Crossfade::MIN_SECONDS;
+        if (seconds > Crossfade::MAX_SECONDS) seconds = Crossfade::MAX_SECONDS;
+    } else {
+        seconds = 0.0f;
+    }
+    decoder->set_crossfade(seconds);
+}
+
+float MusicBackend::get_crossfade() const {
+    return decoder->get_crossfade();
+}
+
+void MusicBackend::queue_next_file(const char* filepath) {
+    decoder->queue_next(filepath ? filepath : "");
+}
+
+void MusicBackend::set_track_change_callback(TrackChangeCallback callback, void* user_data) {
+    on_track_change_callback = callback;
+    track_change_user_data = user_data;
+}
+
+void MusicBackend::set_eq_bands(const std::vector<EqBand>& bands) {
+    decoder->equalizer().set_bands(bands);
+}
+
+void MusicBackend::set_low_power(bool enable) {
+    if (enable == decoder->is_low_power()) return;
+    g_print("Backend: Low power %s\n", enable ? "on" : "off");
+    decoder->set_low_power(enable);
+    apply_read_size();
+}
+
+bool MusicBackend::is_low_power() const {
+    return decoder->is_low_power();
+}
+
+void MusicBackend::apply_read_size() {
+    if (!pipeline) return;
+    GstElement *source = gst_bin_get_by_name(GST_BIN(pipeline), "source");
+    if (!source) return;
+    g_object_set(source, "blocksize", decoder->is_low_power() ? READ_SIZE_DEEP : READ_SIZE_NORMAL, NULL);
+    gst_object_unref(source);
+}
+
 gint64 MusicBackend::get_duration() {
     if (pipeline) {
         GstFormat format = GST_FORMAT_TIME;
@@ -172,26 +873,42 @@ gint64 MusicBackend::get_duration() {
 }
 
 gint64 MusicBackend::get_position() {
+    return gst_util_uint64_scale(get_position_frames(), GST_SECOND, SAMPLE_RATE);
+}
+
+uint64_t MusicBackend::get_position_frames() {
     if (is_paused) {
-        return last_position;
+        return last_frame;
     }
+    if (!is_playing) return 0;
 
-    if (pipeline && is_playing) {
-        GstClock *clock = gst_element_get_clock(pipeline);
-        if (clock) {
-            GstClockTime current_time = gst_clock_get_time(clock);
-            GstClockTime base_time = gst_element_get_base_time(pipeline);
-            gst_object_unref(clock);
+    // Running time counts output samples; map it back to the track's own
+    // timeline (differs when the speed is not 1.0x, after a crossfade or
+    // when resuming). Before the sink starts this is the start frame.
+    gint64 running_time = 0;
+    get_running_time(&running_time);
+    return decoder->media_position_frames(running_time);
+}
 
-            if (GST_CLOCK_TIME_IS_VALID(base_time) && current_time > base_time) {
-                return (gint64)(current_time - base_time);
-            }
-        }
-    }
-    return 0;
+bool MusicBackend::get_running_time(gint64* running_time) {
+    if (!pipeline || !is_playing) return false;
+
+    GstClock *clock = gst_element_get_clock(pipeline);
+    if (!clock) return false;
+    GstClockTime current_time = gst_clock_get_time(clock);
+    GstClockTime base_time = gst_element_get_base_time(pipeline);
+    gst_object_unref(clock);
+
+    if (!GST_CLOCK_TIME_IS_VALID(base_time) || current_time <= base_time) return false;
+    *running_time = (gint64)(current_time - base_time);
+    return true;
 }
 
 void MusicBackend::play_file(const char* filepath) {
+    play_file(filepath, 0);
+}
+
+void MusicBackend::play_file(const char* filepath, uint64_t start_frame) {
     if (stopping) return; // Prevent play if busy stopping
 
     // If already playing, stop first.
@@ -205,12 +922,13 @@ void MusicBackend::play_file(const char* filepath) {
     current_filepath_str = filepath;
     is_playing = true;
     is_paused = false;
-    last_position = 0;
+    last_frame = 0;
+    audible_track = 0;
 
     // 1. Create Pipeline
     // filesrc reads from named pipe
     gchar *pipeline_desc = g_strdup_printf(
-        "filesrc location=\"%s\" ! audio/x-raw, format=S16LE, layout=interleaved, rate=44100, channels=2 ! queue ! autoaudiosink",
+        "filesrc name=source location=\"%s\" ! audio/x-raw, format=S16LE, layout=interleaved, rate=44100, channels=2 ! queue ! autoaudiosink",
         PIPE_PATH
     );
     pipeline = gst_parse_launch(pipeline_desc, NULL);
@@ -222,6 +940,8 @@ void MusicBackend::play_file(const char* filepath) {
         return;
     }
 
+    apply_read_size();
+
     // 2. Setup Bus
     bus = gst_element_get_bus(pipeline);
     bus_watch_id = gst_bus_add_watch(bus, bus_callback_func, this);
@@ -233,13 +953,16 @@ void MusicBackend::play_file(const char* filepath) {
     // If we start decoder first, it opens pipe and blocks on write (or open).
     // If we start pipeline first, it opens pipe and blocks on read (or open).
     // Order doesn't strictly matter as long as both happen.
-    if (!decoder->start(filepath)) {
+    if (!decoder->start(filepath, start_frame)) {
         cleanup_pipeline();
         return;
     }
 
     // 4. Start Pipeline
     gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    resume.save(current_filepath_str, start_frame);
+    resume_timer_id = g_timeout_add_seconds(RESUME_INTERVAL, resume_timer_func, this);
 }
 
 void MusicBackend::pause() {
@@ -249,16 +972,32 @@ void MusicBackend::pause() {
         gst_element_set_state(pipeline, GST_STATE_PLAYING);
         is_paused = false;
     } else {
-        last_position = get_position();
+        last_frame = get_position_frames();
         gst_element_set_state(pipeline, GST_STATE_PAUSED);
         is_paused = true;
+        checkpoint();
     }
 }
 
+void MusicBackend::seek(gint64 position) {
+    if (!is_playing || stopping) return;
+    if (position < 0) position = 0;
+
+    // The decoder only starts at a frame, so the output is restarted
+    // there; the pipe and sink queue would play stale audio otherwise
+    bool was_paused = is_paused;
+    std::string filepath = current_filepath_str;
+    play_file(filepath.c_str(), gst_util_uint64_scale(position, SAMPLE_RATE, GST_SECOND));
+    if (was_paused) pause();
+}
+
 void MusicBackend::stop() {
     if (stopping) return;
     stopping = true;
 
+    // Last chance to read the position
+    checkpoint();
+
     // 1. Break the pipe connection.
     // Setting pipeline to NULL closes the file descriptor in filesrc.
     // This causes the writer (Decoder) to receive EPIPE on next write.
@@ -283,6 +1022,14 @@ void MusicBackend::cleanup_pipeline() {
         g_source_remove(bus_watch_id);
         bus_watch_id = 0;
     }
+    if (switch_watch_id > 0) {
+        g_source_remove(switch_watch_id);
+        switch_watch_id = 0;
+    }
+    if (resume_timer_id > 0) {
+        g_source_remove(resume_timer_id);
+        resume_timer_id = 0;
+    }
     if (pipeline) {
         gst_element_set_state(pipeline, GST_STATE_NULL);
         gst_object_unref(pipeline);
@@ -324,3 +1071,47 @@ gboolean MusicBackend::bus_callback_func(GstBus *bus, GstMessage *msg, gpointer
     }
     return TRUE;
 }
+
+// Decoder thread: a crossfade has started. Hand over to the main loop.
+void MusicBackend::decoder_switch_func(void* data) {
+    g_idle_add(switch_idle_func, data);
+}
+
+gboolean MusicBackend::switch_idle_func(gpointer data) {
+    MusicBackend* self = static_cast<MusicBackend*>(data);
+    // The new track is still sitting in the pipe and sink queue; poll
+    // until it is actually heard
+    if (self->is_playing && self->switch_watch_id == 0) {
+        self->switch_watch_id = g_timeout_add(100, switch_watch_func, self);
+    }
+    return FALSE;
+}
+
+gboolean MusicBackend::switch_watch_func(gpointer data) {
+    MusicBackend* self = static_cast<MusicBackend*>(data);
+    if (!self->is_playing) {
+        self->switch_watch_id = 0;
+        return FALSE;
+    }
+
+    gint64 running_time;
+    if (!self->is_paused && self->get_running_time(&running_time)) {
+        std::string filepath;
+        int track = self->decoder->audible_track(running_time, &filepath);
+        if (track > self->audible_track) {
+            self->audible_track = track;
+            self->current_filepath_str = filepath;
+            g_print("Backend: Now playing %s\n", filepath.c_str());
+            self->checkpoint();
+            if (self->on_track_change_callback) {
+                self->on_track_change_callback(filepath.c_str(), self->track_change_user_data);
+            }
+        }
+    }
+
+    if (self->audible_track >= self->decoder->latest_track()) {
+        self->switch_watch_id = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
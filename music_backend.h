@@ -4,21 +4,41 @@
 #include <gst/gst.h>
 #include <string>
 #include <atomic>
+#include <condition_variable>
 #include <pthread.h>
 #include <memory>
+#include <mutex>
+#include <vector>
+
+#include "equalizer.h"
+#include "gain_stage.h"
+#include "loudness_scanner.h"
+#include "time_stretch.h"
+#include "replay_gain.h"
+#include "resume_point.h"
+#include "silence_trim.h"
+#include "track_cache.h"
 
 // Callback type for End of Stream (song finished)
 typedef void (*EosCallback)(void* user_data);
 
+// Called (main loop) when a crossfade has made the queued file the
+// current one, i.e. the new track has become audible.
+typedef void (*TrackChangeCallback)(const char* filepath, void* user_data);
+
+// Called on the decoder thread when it starts fading into the queued file
+typedef void (*TrackSwitchCallback)(void* user_data);
+
 // --- Decoder Class ---
 class Decoder {
 public:
     Decoder();
     ~Decoder();
 
-    // Start decoding the specified file in a separate thread.
+    // Start decoding the specified file in a separate thread, `start_frame`
+    // frames into the (gapless trimmed) track.
     // Returns true if thread started successfully.
-    bool start(const char* filepath);
+    bool start(const char* filepath, uint64_t start_frame);
 
     // Stop the decoding thread.
     // This sets the stop flag and waits for the thread to join.
@@ -27,14 +47,128 @@ public:
     // Check if the decoder thread is currently running.
     bool is_running() const;
 
+    // Output gain stage (software volume). Lives as long as the Decoder,
+    // so the volume carries over from one track to the next.
+    GainStage& gain_stage();
+
+    // Parametric EQ, applied before the gain stage.
+    Equalizer& equalizer();
+
+    // Playback speed, applied right after decoding.
+    TimeStretch& time_stretch();
+
+    // Track position (ns) of the sample the sink is playing after
+    // `running_time` ns of output, taking speed changes into account.
+    gint64 media_position(gint64 running_time);
+
+    // Same, in frames; what start() takes to resume from there
+    uint64_t media_position_frames(gint64 running_time);
+
+    // ReplayGain handling for tracks started after this call.
+    // `cache` keeps parsed tag values so files are only parsed once.
+    void set_replaygain(ReplayGainMode mode, TrackCache* cache);
+
+    // True while playing with less than a quarter of the pipe buffered,
+    // i.e. the decoder is close to letting the sink underrun.
+    bool is_buffer_low() const;
+
+    // Deep buffering: the pipe grows to several seconds and is refilled in
+    // bursts, so the decoder thread sleeps most of the time. Any thread;
+    // takes effect within one block, also mid-track.
+    void set_low_power(bool enable);
+    bool is_low_power() const;
+
+    // Silence trimming for tracks started after this call. `cache` keeps
+    // detection results so later plays skip straight to the audio.
+    void set_silence_trim(SilenceMode mode, TrackCache* cache);
+
+    // Crossfade length in seconds, 0 = off. Any thread.
+    void set_crossfade(float seconds);
+    float get_crossfade() const;
+
+    // File to fade into when the current one ends (empty = none). Cleared
+    // by start() and once the decoder has picked it up.
+    void queue_next(const std::string& filepath);
+    void set_switch_callback(TrackSwitchCallback callback, void* user_data);
+
+    // Which track is audible after `running_time` ns of output: a serial
+    // number counting crossfades since start() (0 = the started file).
+    int audible_track(gint64 running_time, std::string* filepath);
+
+    // Serial number of the newest track the decoder has faded into
+    int latest_track();
+
 private:
+    struct Source;
+
     std::atomic<bool> stop_flag;
     std::atomic<bool> running;
+    std::atomic<bool> buffer_low;
+    std::atomic<bool> low_power;
     pthread_t thread_id;
     std::string current_filepath;
+    uint64_t start_frame;
+    GainStage gain;
+    Equalizer eq;
+    TimeStretch stretch;
+    std::atomic<int> replaygain_mode;
+    TrackCache* gain_cache;
+
+    std::atomic<int> silence_mode;
+    TrackCache* silence_cache;
+
+    std::atomic<float> crossfade_seconds;
+    std::string next_filepath;
+    std::mutex next_lock;
+    TrackSwitchCallback switch_callback;
+    void* switch_user_data;
+
+    // Output-to-media time map: one mark per block written to the pipe.
+    // The ring covers far more audio than the pipe and sink queue can hold.
+    struct PositionMark {
+        gint64 out_frame;
+        double media_frame;
+        float speed;
+    };
+    static const size_t POSITION_MARKS = 256;
+    PositionMark marks[POSITION_MARKS];
+    gint64 frames_written;
+    size_t mark_count;
+
+    // Media frame (same timeline as the marks) at which each track starts;
+    // a crossfade starts the next track while the old one still plays.
+    // `origin` is the track frame decoding started from (resume, skipped
+    // leading silence).
+    struct TrackStart {
+        double media_frame;
+        double origin;
+        std::string filepath;
+    };
+    static const size_t TRACK_STARTS = 4;
+    TrackStart track_starts[TRACK_STARTS];
+    size_t track_count;
+    std::mutex mark_lock;
+
+    // Interruptible sleep of the decoder thread (deep buffering)
+    std::mutex wake_lock;
+    std::condition_variable wake_cond;
+    bool wake_pending;
 
     static void* thread_func(void* arg);
     void decode_loop();
+    void wake();
+    void idle_wait(gint64 microseconds);
+    bool open_source(Source* src, const std::string& filepath, uint64_t start_frame);
+    void close_source(Source* src);
+    size_t read_source(Source* src, float* pcm, size_t frames);
+    uint64_t source_length(Source* src);
+    void lookup_replaygain(const std::string& filepath, float* gain_db, float* peak);
+    void store_silence_info(Source* src);
+    void reset_position_marks(double origin);
+    void add_position_mark(double media_frame, float speed);
+    void add_track_start(double media_frame, double origin, const std::string& filepath);
+    size_t track_index(double media_frame) const;
+    double media_frame_at(gint64 out_frame) const;
 };
 
 // --- MusicBackend Class ---
@@ -49,8 +183,14 @@ public:
 
     // --- Public API ---
     void play_file(const char* filepath);
+    // Start `start_frame` frames into the track (see get_position_frames())
+    void play_file(const char* filepath, uint64_t start_frame);
     void pause();
     void stop();
+
+    // Jump to `position` (ns, track time) in the current file; keeps the
+    // paused state. Restarts the output, so queue the next file again.
+    void seek(gint64 position);
     
     // Returns true if the backend is currently performing a stop operation
     // (used to prevent UI race conditions)
@@ -58,12 +198,83 @@ public:
 
     gint64 get_duration();
     gint64 get_position();
+    // Frame-accurate position, for resuming
+    uint64_t get_position_frames();
     const char* get_current_filepath();
 
     void set_eos_callback(EosCallback callback, void* user_data);
 
+    // Software volume in dB (GainStage::MIN_DB .. GainStage::MAX_DB).
+    // Positive values act as a pre-amp for quiet recordings.
+    void set_volume_db(float db);
+    float get_volume_db() const;
+
+    // Playback speed (TimeStretch::MIN_SPEED .. MAX_SPEED), pitch preserved.
+    // Takes effect immediately, also mid-track; positions stay in track time.
+    void set_speed(float speed);
+    float get_speed() const;
+
+    // Crossfade between consecutive tracks, in seconds (Crossfade::MIN_SECONDS
+    // .. MAX_SECONDS, 0 = off). Only used when a next file is queued.
+    void set_crossfade(float seconds);
+    float get_crossfade() const;
+
+    // File to play after the current one; call after play_file(). With
+    // crossfade on, the backend fades into it on its own and reports the
+    // change through the track change callback instead of EOS.
+    void queue_next_file(const char* filepath);
+    void set_track_change_callback(TrackChangeCallback callback, void* user_data);
+
+    // Parametric EQ bands; an empty list turns the EQ off.
+    // Takes effect within one decode block, also mid-track.
+    void set_eq_bands(const std::vector<EqBand>& bands);
+
+    // Low-wakeup mode for when the screen is off: deep decoder buffering
+    // and large pipe reads. Volume, EQ and speed changes take a few
+    // seconds to be heard meanwhile.
+    void set_low_power(bool enable);
+    bool is_low_power() const;
+
+    // ReplayGain normalisation (default: track gain).
+    // Takes effect from the next track on.
+    void set_replaygain_mode(ReplayGainMode mode);
+    ReplayGainMode get_replaygain_mode() const;
+
+    // Load the persistent per-file gain table from `path`.
+    void open_gain_cache(const std::string& path);
+
+    // Skip silence at track edges (and long pauses in SILENCE_SPEECH mode).
+    // Takes effect from the next track on.
+    void set_silence_trim(SilenceMode mode);
+    SilenceMode get_silence_trim() const;
+
+    // Load the persistent per-file silence table from `path`.
+    void open_silence_cache(const std::string& path);
+
+    // Checkpoint the playback position to `path` on pause, stop, track
+    // change and every RESUME_INTERVAL seconds while playing.
+    void open_resume_file(const std::string& path);
+    // File and frame of the last checkpoint (loaded or written)
+    const std::string& get_resume_filepath() const;
+    uint64_t get_resume_frame(const char* filepath) const;
+
+    // Write caches back to disk. Called automatically on destruction;
+    // call explicitly before exit() paths that skip destructors.
+    void flush_caches();
+
+    // Measure loudness of untagged files in `files` in the background and
+    // store the results in the gain cache. Restarting with a new list is
+    // cheap: files measured before are skipped.
+    void start_loudness_scan(const PathList& files);
+    void stop_loudness_scan();
+
 private:
     std::unique_ptr<Decoder> decoder;
+    TrackCache gain_cache;
+    ReplayGainMode replaygain_mode;
+    TrackCache silence_cache;
+    SilenceMode silence_mode;
+    std::unique_ptr<LoudnessScanner> scanner;
     
     GstElement *pipeline;
     GstBus *bus;
@@ -74,12 +285,39 @@ private:
 
     EosCallback on_eos_callback;
     void* eos_user_data;
+    TrackChangeCallback on_track_change_callback;
+    void* track_change_user_data;
     
-    gint64 last_position;
+    uint64_t last_frame; // Position while paused
+
+    // Crossfade track changes: the decoder switches files ahead of what
+    // is audible; the watch reports each switch once it is heard.
+    int audible_track;
+    guint switch_watch_id;
+
+    ResumePoint resume;
+    guint resume_timer_id;
 
     // Helper to cleanup GStreamer resources
     void cleanup_pipeline();
 
+    // Pipe read size of the filesrc, following the low power mode
+    void apply_read_size();
+
+    // Scanner throttle: back off while the decoder is struggling
+    static bool scan_throttle_func(void* data);
+
+    // Output time of the sample being played, false when not playing
+    bool get_running_time(gint64* running_time);
+
+    static void decoder_switch_func(void* data);
+    static gboolean switch_idle_func(gpointer data);
+    static gboolean switch_watch_func(gpointer data);
+
+    // Save the current position to the resume file
+    void checkpoint();
+    static gboolean resume_timer_func(gpointer data);
+
     // GStreamer bus callback
     static gboolean bus_callback_func(GstBus *bus, GstMessage *msg, gpointer data);
 };
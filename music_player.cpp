@@ -6,14 +6,27 @@
 #include <algorithm>
 #include <dirent.h>
 #include <stdlib.h>
+#include <math.h>
 #include <wordexp.h>
 #include <libgen.h>
-#include <random>
+#include <limits.h>
+#include <stdarg.h>
+#include <unistd.h>
 
 #include "openlipc/openlipc.h"
 
+#include "control_socket.h"
+#include "eq_preset.h"
+#include "folder_scanner.h"
+#include "gain_stage.h"
 #include "gtk_utils.h"
-#include "music_backend.h"
+#include "m3u_reader.h"
+#include "playlist_model.h"
+#include "replay_gain.h"
+#include "resume_point.h"
+#include "silence_trim.h"
+#include "track_info_cache.h"
+#include "track_info_loader.h"
 #include "assets/bluetooth_icon.h"
 #include "assets/close_icon.h"
 #include "assets/play_pause_icon.h"
@@ -36,28 +49,78 @@ enum PlaybackStrategy {
 };
 
 struct AppData {
-    MusicBackend *backend;
-    GtkListStore *playlist_store;
+    ControlClient *player;  // KinAMP-minimal --daemon does the playback
+    ControlClient *events;  // Second connection, subscribed to daemon events
+    PlayerStatus status;    // Last status reported by the daemon
+    gint64 status_time;     // When it was received (monotonic us)
+    int status_index;       // Playlist index of the last selected daemon track
+    unsigned playlist_version; // Daemon's playlist version, see "status"
+    bool playlist_version_known;
+    guint clock_timer_id;   // 0 while the position is not moving or hidden
+    bool clock_periodic;    // clock_timer_id repeats, in step with the position
+    bool screen_off;        // Screensaver is up
+    std::string last_time_text;
+    PlaylistModel *playlist;
     GtkTreeView *playlist_treeview;
+    FolderScanner folder_scanner; // Add Folder runs in the background
+    bool importing;         // Files from folder_scanner are being added
+    PathList imported;      // What the import added so far
+    bool playlist_reload_pending; // Daemon's playlist changed during the import
+    GtkWidget *add_folder_button;
     GtkLabel *song_title_label;
     GtkLabel *time_label;
 
     PlaybackStrategy current_strategy;
     int flIntensity;
-    bool next_song_pending;
     bool dispUpdate;
-    std::string next_song_path;
     std::string last_title; // Cache to avoid redundant UI updates
+    TrackInfoCache track_info; // Tags for the song label and playlist rows
+    TrackInfoLoader *title_loader; // Reads them for the rows on screen
+    guint titles_idle_id;   // Pending request_visible_titles(), 0 = none
+    std::string title_path; // File song_title() last looked up, and its title
+    std::string title_text;
     int current_index;
     GtkWidget *shuffle_button;
     GtkWidget *repeat_button;
+    GtkWidget *volume_scale;
+    bool loudness_scan; // Measure untagged files in the background
+    GtkWidget *eq_combo;
+    std::vector<EqPreset> eq_presets;  // User presets from .kinamp.conf
+    std::vector<std::string> eq_names; // Combo box entries, in order
+    std::string eq_preset;
+    GtkWidget *speed_combo;
+    GtkWidget *crossfade_combo;
+    ReplayGainMode replaygain_mode;
+    SilenceMode silence_trim;
+    std::vector<std::string> library_watch; // Folders the daemon keeps in sync, kept in .kinamp.conf
 };
 
+// Playback speeds offered in the UI (audiobooks, lectures)
+static const float SPEED_STEPS[] = { 0.75f, 1.0f, 1.25f, 1.5f, 1.75f, 2.0f };
+static const int SPEED_STEP_COUNT = sizeof(SPEED_STEPS) / sizeof(SPEED_STEPS[0]);
+
+// Crossfade lengths offered in the UI, in seconds (0 = off)
+static const int CROSSFADE_STEPS[] = { 0, 1, 2, 4, 6, 8, 10, 12 };
+static const int CROSSFADE_STEP_COUNT = sizeof(CROSSFADE_STEPS) / sizeof(CROSSFADE_STEPS[0]);
+
+// Control protocol names, in enum order
+static const char *STRATEGY_NAMES[] = { "normal", "repeat", "shuffle" };
+static const char *REPLAYGAIN_NAMES[] = { "off", "track", "album" };
+static const char *SILENCE_NAMES[] = { "off", "edges", "speech" };
+
+// Daemon start-up: connection attempts, 100 ms apart
+static const int DAEMON_CONNECT_TRIES = 30;
+
+// How late a clock tick may land after the second changed before the
+// timer is aligned again
+static const guint CLOCK_SLACK_MS = 50;
+
 static LIPC * lipcInstance = 0;
 
 void openLipcInstance() {
 	if (lipcInstance == 0) {
-		lipcInstance = LipcOpen("com.kbarni.kinamp");
+		// The playback daemon owns com.kbarni.kinamp; we only talk to powerd/btfd
+		lipcInstance = LipcOpenNoName();
 	}
 }
 
@@ -86,147 +149,254 @@ void toggleFrontLight(AppData *ad){
     }
 }
 
-void set_button_icon(GtkWidget *button, const unsigned char *icon_data) {
-    GdkPixbuf *pixbuf = gdk_pixbuf_new_from_inline(-1, icon_data, FALSE, NULL);
-    GtkWidget *image = gtk_image_new_from_pixbuf(pixbuf);
-    g_object_unref(pixbuf);
-    gtk_button_set_image(GTK_BUTTON(button), image);
-    gtk_widget_show(image); // Important to show the new image
+// --- Daemon Connection ---
+// Playback runs in KinAMP-minimal --daemon, so hiding the UI never stops
+// the music. Start the daemon (next to our own executable) if it is not
+// running yet.
+bool connect_daemon(ControlClient *player) {
+    if (player->connect(CONTROL_SOCKET_PATH)) return true;
+
+    std::string daemon_path = "KinAMP-minimal";
+    char exe_path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    if (len > 0) {
+        exe_path[len] = '\0';
+        daemon_path = std::string(dirname(exe_path)) + "/KinAMP-minimal";
+    }
+    g_print("UI: Starting %s --daemon\n", daemon_path.c_str());
+    gchar *argv[] = { (gchar*)daemon_path.c_str(), (gchar*)"--daemon", NULL };
+    GError *error = NULL;
+    if (!g_spawn_async(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, NULL, &error)) {
+        g_printerr("UI: Failed to start the playback daemon: %s\n", error->message);
+        g_error_free(error);
+        return false;
+    }
+    for (int i = 0; i < DAEMON_CONNECT_TRIES; ++i) {
+        g_usleep(100000);
+        if (player->connect(CONTROL_SOCKET_PATH)) return true;
+    }
+    g_printerr("UI: Playback daemon does not answer\n");
+    return false;
 }
 
-// --- End of Stream Callback ---
-void on_eos_cb(void* user_data) {
-    g_print("UI: End-of-Stream reached. Planning next song.\n");
-    AppData *app_data = (AppData*)user_data;
+void connect_events(AppData *app_data);
+
+// Send a printf-style command to the daemon, restarting it if it is gone
+bool player_command(AppData *app_data, const char *format, ...) {
+    if (!app_data->player->is_connected() && !connect_daemon(app_data->player)) return false;
+
+    va_list args;
+    va_start(args, format);
+    gchar *command = g_strdup_vprintf(format, args);
+    va_end(args);
+    bool ok = app_data->player->request(command, NULL);
+    g_free(command);
+    // A restarted daemon needs a new subscription
+    if (!app_data->events->is_connected()) connect_events(app_data);
+    return ok;
+}
 
-    GtkTreeModel *model = GTK_TREE_MODEL(app_data->playlist_store);
-    GtkTreeSelection *selection = gtk_tree_view_get_selection(app_data->playlist_treeview);
-    GtkTreeIter iter;
+// Move the playlist cursor to the row holding `file_path`. `index` is
+// where it is expected (-1 = unknown); the list is only searched if the
+// file is not there.
+void select_song_path(AppData *app_data, int index, const std::string& file_path) {
+    const char *path = playlist_model_path(app_data->playlist, index);
+    if (!path || file_path != path) {
+        index = playlist_model_find(app_data->playlist, file_path.c_str());
+    }
+    if (index < 0) return;
+    GtkTreePath *tree_path = gtk_tree_path_new_from_indices(index, -1);
+    gtk_tree_view_set_cursor(app_data->playlist_treeview, tree_path, NULL, FALSE);
+    gtk_tree_path_free(tree_path);
+}
 
-    if (!gtk_tree_selection_get_selected(selection, &model, &iter)) {
-        return;
+// --- UI Updates ---
+// The daemon pushes an event on every change (subscribe), so nothing is
+// polled: between events, only the clock label needs to move, once a
+// second, and only while it is shown and the music is running.
+
+// Position extrapolated from the last event
+gint64 current_position_ms(AppData *app_data) {
+    const PlayerStatus &status = app_data->status;
+    gint64 position_ms = status.position_ms;
+    if (status.playing && !status.paused) {
+        position_ms += (gint64)((g_get_monotonic_time() - app_data->status_time) / 1000 * status.speed);
     }
+    return position_ms;
+}
 
-    GtkTreePath *current_path = gtk_tree_model_get_path(model, &iter);
-    bool play_next = false;
+// Time label text
+std::string format_time_label(AppData *app_data) {
+    const PlayerStatus &status = app_data->status;
+    if (!status.playing) return "▢--:--";
+    const char *icon = status.paused ? "◫" : "▷";
+    if (!app_data->dispUpdate) return std::string("  ") + icon + "  ";
+
+    int pos_seconds = current_position_ms(app_data) / 1000;
+    char time_str[32];
+    snprintf(time_str, sizeof(time_str), "%s%02d:%02d", icon, pos_seconds / 60, pos_seconds % 60);
+    return time_str;
+}
 
-    switch (app_data->current_strategy) {
-        case NORMAL:
-            gtk_tree_path_next(current_path);
-            if (gtk_tree_model_get_iter(model, &iter, current_path)) {
-                play_next = true;
-            }
-            break;
-        case REPEAT:
-            gtk_tree_path_next(current_path);
-            if (!gtk_tree_model_get_iter(model, &iter, current_path)) {
-                gtk_tree_path_free(current_path);
-                current_path = gtk_tree_path_new_from_indices(0, -1);
-                if (gtk_tree_model_get_iter(model, &iter, current_path)) {
-                     play_next = true;
-                }
-            } else {
-                play_next = true;
-            }
-            break;
-        case RANDOM: {
-            int count = gtk_tree_model_iter_n_children(model, NULL);
-            if (count > 0) {
-                std::random_device rd;
-                std::mt19937 gen(rd());
-                std::uniform_int_distribution<> distrib(0, count - 1);
-                int random_index = distrib(gen);
-                
-                gtk_tree_path_free(current_path);
-                current_path = gtk_tree_path_new_from_indices(random_index, -1);
-                if (gtk_tree_model_get_iter(model, &iter, current_path)) {
-                    play_next = true;
-                }
-            }
-            break;
-        }
+// Label text for a song: "Artist - Title" from its tags, else the file
+// name. The tags are only looked up when the song changes, not on every
+// clock tick.
+std::string song_title(AppData *app_data, const char *filepath) {
+    if (app_data->title_path != filepath) {
+        TrackInfo info;
+        if (!app_data->track_info.get(filepath, &info)) info.title.clear();
+        app_data->title_path = filepath;
+        app_data->title_text = track_display_name(info, filepath);
     }
+    return app_data->title_text;
+}
 
-    if (play_next) {
-        gchar *file_path = NULL;
-        gtk_tree_model_get(model, &iter, 0, &file_path, -1);
-        if (file_path) {
-            app_data->next_song_path = file_path;
-            app_data->next_song_pending = true;
-            g_free(file_path);
-        }
+// Bring the labels and playlist cursor up to date; labels are only touched
+// when their text changes, as every update repaints the e-ink screen
+void render_status(AppData *app_data) {
+    if (app_data->screen_off) return;
+    const PlayerStatus &status = app_data->status;
+
+    // The daemon moves on by itself (end of track, crossfade)
+    if (status.playing && status.index != app_data->status_index) {
+        app_data->status_index = status.index;
+        select_song_path(app_data, status.index, status.filepath);
+    }
+
+    std::string time_text = format_time_label(app_data);
+    if (app_data->last_time_text != time_text) {
+        gtk_label_set_text(app_data->time_label, time_text.c_str());
+        app_data->last_time_text = time_text;
     }
 
-    gtk_tree_path_free(current_path);
+    std::string title = "No song playing";
+    if (status.playing && !status.filepath.empty()) {
+        title = song_title(app_data, status.filepath.c_str());
+    } else if (status.playing) {
+        title = app_data->last_title;
+    }
+    if (app_data->last_title != title) {
+        gtk_label_set_text(app_data->song_title_label, title.c_str());
+        app_data->last_title = title; // Update cache
+    }
 }
 
+// Wall clock time between two changes of the label's seconds
+guint clock_period_ms(AppData *app_data) {
+    float speed = app_data->status.speed > 0.0f ? app_data->status.speed : 1.0f;
+    return (guint)ceilf(1000 / speed);
+}
+
+// Wall clock time until the label's seconds next change, landing just past
+// the change
+guint clock_delay_ms(AppData *app_data) {
+    float speed = app_data->status.speed > 0.0f ? app_data->status.speed : 1.0f;
+    gint64 to_go = 1000 - current_position_ms(app_data) % 1000;
+    return (guint)(to_go / speed) + 1;
+}
 
-// --- UI Update Callback ---
-gboolean update_progress_cb(gpointer data) {
+gboolean clock_tick_cb(gpointer data) {
     AppData *app_data = (AppData*)data;
+    render_status(app_data);
+
+    // Still in step: keep the periodic timer. After the first, one-shot
+    // tick, or once dispatch delays add up, start over from this second.
+    guint delay = clock_delay_ms(app_data);
+    guint period = clock_period_ms(app_data);
+    if (app_data->clock_periodic && delay + CLOCK_SLACK_MS >= period) return TRUE;
+    app_data->clock_periodic = delay + CLOCK_SLACK_MS >= period;
+    app_data->clock_timer_id = app_data->clock_periodic ? g_timeout_add(period, clock_tick_cb, app_data)
+                                                        : g_timeout_add(delay, clock_tick_cb, app_data);
+    return FALSE;
+}
 
-    // Handle playing the next song if pending
-    if (app_data->next_song_pending && !app_data->backend->is_playing && !app_data->backend->is_shutting_down()) {
-        app_data->next_song_pending = false;
-        
-        GtkTreeIter iter;
-        gboolean valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(app_data->playlist_store), &iter);
-        while (valid) {
-            gchar *path = NULL;
-            gtk_tree_model_get(GTK_TREE_MODEL(app_data->playlist_store), &iter, 0, &path, -1);
-            // Use std::string comparison
-            if (path && app_data->next_song_path == path) {
-                GtkTreePath* tree_path = gtk_tree_model_get_path(GTK_TREE_MODEL(app_data->playlist_store), &iter);
-                gtk_tree_view_set_cursor(app_data->playlist_treeview, tree_path, NULL, FALSE);
-                gtk_tree_path_free(tree_path);
-                g_free(path);
-                break;
-            }
-            g_free(path);
-            valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(app_data->playlist_store), &iter);
-        }
-        //keepBTenabled();
-        app_data->backend->play_file(app_data->next_song_path.c_str());
-        return TRUE; // Return early
+// Run the clock only while there is a moving position to show. Every
+// event moves the position, so the clock is started again on each: a
+// one-shot to the next second boundary first, then a periodic timer
+// (see clock_tick_cb()), so the label changes when the second does.
+void update_clock_timer(AppData *app_data) {
+    const PlayerStatus &status = app_data->status;
+    bool ticking = !app_data->screen_off && app_data->dispUpdate && status.playing && !status.paused;
+    if (app_data->clock_timer_id > 0) {
+        g_source_remove(app_data->clock_timer_id);
+        app_data->clock_timer_id = 0;
     }
+    if (ticking) {
+        app_data->clock_periodic = false;
+        app_data->clock_timer_id = g_timeout_add(clock_delay_ms(app_data), clock_tick_cb, app_data);
+    }
+}
 
-
-    if (app_data->backend->is_playing || app_data->backend->is_paused) {
-        gint64 position = app_data->backend->get_position();
-        
-        char time_str[32];
-        int pos_seconds = position / GST_SECOND;
-        
-        if (app_data->backend->is_paused) {
-             snprintf(time_str, sizeof(time_str), (app_data->dispUpdate?"◫%02d:%02d":"  ◫  "), pos_seconds / 60, pos_seconds % 60);
-        } else {
-             snprintf(time_str, sizeof(time_str), (app_data->dispUpdate?"▷%02d:%02d":"  ▷  "), pos_seconds / 60, pos_seconds % 60);
-        }
-        gtk_label_set_text(app_data->time_label, time_str);
-        
-        // Update title only if it changes
-        const char* full_path = app_data->backend->get_current_filepath();
-        if (full_path && strlen(full_path) > 0) {
-            char* path_copy = g_strdup(full_path);
-            char* base = basename(path_copy); // basename might modify path_copy
-            
-            if (app_data->last_title != base) {
-                gtk_label_set_text(app_data->song_title_label, base);
-                app_data->last_title = base; // Update cache
+std::string get_config_path(const char* filename);
+bool read_playlist(AppData *app_data, const char *filename);
+
+// Take a new daemon status; NULL = daemon gone, show as stopped
+void apply_status(AppData *app_data, const PlayerStatus *status) {
+    if (status) {
+        // The daemon rewrote the playlist file: watched folders changed
+        if (app_data->playlist_version_known && status->playlist != app_data->playlist_version) {
+            if (app_data->importing) {
+                // Reloading now would drop the imported rows; it is done
+                // when the import ends, see finish_folder_import()
+                app_data->playlist_reload_pending = true;
+            } else {
+                read_playlist(app_data, get_config_path(".kinamp_playlist.m3u").c_str());
+                app_data->status_index = -1;
             }
-            g_free(path_copy);
         }
-
+        app_data->playlist_version = status->playlist;
+        app_data->playlist_version_known = true;
+        app_data->status = *status;
     } else {
-        // Stopped state
-        gtk_label_set_text(app_data->time_label, "▢--:--");
-        if (app_data->last_title != "No song playing") {
-            gtk_label_set_text(app_data->song_title_label, "No song playing");
-            app_data->last_title = "No song playing";
-        }
+        app_data->status.playing = false;
+        app_data->status.paused = false;
+        app_data->playlist_version_known = false;
     }
+    app_data->status_time = g_get_monotonic_time();
+    render_status(app_data);
+    update_clock_timer(app_data);
+}
 
-    return TRUE; // Continue calling this function
+void on_player_event(const PlayerStatus *status, void *data) {
+    apply_status((AppData*)data, status);
+}
+
+// Open the event connection next to the command one; the first event is
+// the current state
+void connect_events(AppData *app_data) {
+    if (app_data->events->connect(CONTROL_SOCKET_PATH) && app_data->events->subscribe(on_player_event, app_data)) {
+        return;
+    }
+    app_data->events->disconnect();
+    apply_status(app_data, NULL);
+}
+
+// --- Screensaver ---
+// Nothing is visible under the screensaver: stop the clock so the UI
+// process sleeps (events are only recorded), and catch up at once when
+// the screen comes back. The daemon switches to deep buffering on the same
+// powerd events.
+gboolean screen_off_idle_cb(gpointer data) {
+    AppData *app_data = (AppData*)data;
+    app_data->screen_off = true;
+    update_clock_timer(app_data);
+    return FALSE;
+}
+
+gboolean screen_on_idle_cb(gpointer data) {
+    AppData *app_data = (AppData*)data;
+    app_data->screen_off = false;
+    render_status(app_data);
+    update_clock_timer(app_data);
+    return FALSE;
+}
+
+// Called by LIPC, possibly on its own thread: defer to the GTK main loop
+LIPCcode on_powerd_event(LIPC *lipc, const char *name, LIPCevent *event, void *data) {
+    (void)lipc;
+    (void)event;
+    g_idle_add(strcmp(name, "goingToScreenSaver") == 0 ? screen_off_idle_cb : screen_on_idle_cb, data);
+    return LIPC_OK;
 }
 
 
@@ -251,24 +421,63 @@ std::string get_config_path(const char* filename) {
 }
 
 
-// --- State Management ---
-void save_state(AppData *app_data) {
-    std::string playlist_path = get_config_path(".kinamp_playlist.m3u");
-    std::ofstream outfile(playlist_path.c_str());
+// --- Playlist Sync ---
+void write_playlist(PlaylistModel *playlist, const char *filename) {
+    std::ofstream outfile(filename);
     if (outfile.is_open()) {
-        GtkTreeIter iter;
-        gboolean valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(app_data->playlist_store), &iter);
-        while (valid) {
-            gchar *path = NULL;
-            gtk_tree_model_get(GTK_TREE_MODEL(app_data->playlist_store), &iter, 0, &path, -1);
-            if (path) {
-                outfile << path << std::endl;
-                g_free(path);
-            }
-            valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(app_data->playlist_store), &iter);
+        gint count = playlist_model_length(playlist);
+        for (gint i = 0; i < count; ++i) {
+            outfile << playlist_model_path(playlist, i) << '\n';
         }
         outfile.close();
     }
+}
+
+// Replace the playlist with the entries of an M3U file. The file is read
+// in full before the model is touched, and the view is detached while the
+// rows are swapped in, so it does not follow them one by one.
+bool read_playlist(AppData *app_data, const char *filename) {
+    PathList paths;
+    if (!read_m3u(filename, &paths)) return false;
+
+    gtk_tree_view_set_model(app_data->playlist_treeview, NULL);
+    playlist_model_replace(app_data->playlist, &paths);
+    gtk_tree_view_set_model(app_data->playlist_treeview, GTK_TREE_MODEL(app_data->playlist));
+    return true;
+}
+
+// Hand the edited playlist to the daemon. It also (re)starts the loudness
+// scan there; files measured before are skipped, so this is cheap.
+void sync_playlist(AppData *app_data) {
+    std::string playlist_path = get_config_path(".kinamp_playlist.m3u");
+    write_playlist(app_data->playlist, playlist_path.c_str());
+    player_command(app_data, "load %s", playlist_path.c_str());
+}
+
+// --- Equalizer ---
+void apply_eq_preset(AppData *app_data, const std::string& name) {
+    const EqPreset *preset = eq_find_preset(app_data->eq_presets, name);
+    if (!preset) preset = &eq_builtin_presets()[0];
+    app_data->eq_preset = preset->name;
+    if (preset->bands.empty()) {
+        player_command(app_data, "eq");
+    } else {
+        player_command(app_data, "eq %s", eq_format_preset_line(*preset).c_str());
+    }
+}
+
+// Add `name` to the preset combo box unless it is already listed
+void add_eq_combo_entry(AppData *app_data, const std::string& name) {
+    if (std::find(app_data->eq_names.begin(), app_data->eq_names.end(), name) != app_data->eq_names.end()) return;
+    app_data->eq_names.push_back(name);
+    gtk_combo_box_append_text(GTK_COMBO_BOX(app_data->eq_combo), name.c_str());
+}
+
+// --- State Management ---
+void save_state(AppData *app_data) {
+    std::string playlist_path = get_config_path(".kinamp_playlist.m3u");
+    write_playlist(app_data->playlist, playlist_path.c_str());
+    app_data->track_info.save();
 
     int current_index = -1;
     GtkTreeSelection *selection = gtk_tree_view_get_selection(app_data->playlist_treeview);
@@ -290,25 +499,29 @@ void save_state(AppData *app_data) {
     if (conffile.is_open()) {
         conffile << "current_index=" << current_index << std::endl;
         conffile << "playback_strategy=" << app_data->current_strategy << std::endl;
+        conffile << "volume_db=" << gtk_range_get_value(GTK_RANGE(app_data->volume_scale)) << std::endl;
+        conffile << "replaygain_mode=" << app_data->replaygain_mode << std::endl;
+        conffile << "loudness_scan=" << (app_data->loudness_scan ? 1 : 0) << std::endl;
+        conffile << "eq_preset=" << app_data->eq_preset << std::endl;
+        int speed_index = gtk_combo_box_get_active(GTK_COMBO_BOX(app_data->speed_combo));
+        conffile << "speed=" << (speed_index >= 0 ? SPEED_STEPS[speed_index] : 1.0f) << std::endl;
+        int fade_index = gtk_combo_box_get_active(GTK_COMBO_BOX(app_data->crossfade_combo));
+        conffile << "crossfade=" << (fade_index >= 0 ? CROSSFADE_STEPS[fade_index] : 0) << std::endl;
+        conffile << "silence_trim=" << app_data->silence_trim << std::endl;
+        for (size_t i = 0; i < app_data->library_watch.size(); ++i) {
+            conffile << "library_watch=" << app_data->library_watch[i] << std::endl;
+        }
+        for (size_t i = 0; i < app_data->eq_presets.size(); ++i) {
+            conffile << eq_format_preset_line(app_data->eq_presets[i]) << std::endl;
+        }
         conffile.close();
     }
 }
 
 void load_state(AppData *app_data) {
+    app_data->track_info.load(get_config_path(".kinamp_tags.cache"));
     std::string playlist_path = get_config_path(".kinamp_playlist.m3u");
-    std::ifstream infile(playlist_path.c_str());
-    if (infile.is_open()) {
-        gtk_list_store_clear(app_data->playlist_store);
-        std::string line;
-        while (std::getline(infile, line)) {
-            if (!line.empty()) {
-                GtkTreeIter iter;
-                gtk_list_store_append(app_data->playlist_store, &iter);
-                gtk_list_store_set(app_data->playlist_store, &iter, 0, line.c_str(), -1);
-            }
-        }
-        infile.close();
-    }
+    read_playlist(app_data, playlist_path.c_str());
 
     std::string config_path = get_config_path(".kinamp.conf");
     std::ifstream conffile(config_path.c_str());
@@ -334,10 +547,69 @@ void load_state(AppData *app_data) {
                     set_button_icon(app_data->shuffle_button, shuffle_icon);
                     set_button_icon(app_data->repeat_button, repeat_icon);
                 }
+                player_command(app_data, "strategy %s", STRATEGY_NAMES[app_data->current_strategy]);
+            }
+            if (line.find("volume_db=") == 0) {
+                double volume = atof(line.substr(10).c_str());
+                // The scale's value-changed handler forwards this to the backend
+                gtk_range_set_value(GTK_RANGE(app_data->volume_scale), volume);
+            }
+            if (line.find("replaygain_mode=") == 0) {
+                int mode = atoi(line.substr(16).c_str());
+                if (mode >= REPLAYGAIN_OFF && mode <= REPLAYGAIN_ALBUM) {
+                    app_data->replaygain_mode = (ReplayGainMode)mode;
+                    player_command(app_data, "replaygain %s", REPLAYGAIN_NAMES[mode]);
+                }
+            }
+            if (line.find("library_watch=") == 0) {
+                // Only the daemon uses it; kept for the next save
+                app_data->library_watch.push_back(line.substr(14));
+            }
+            if (line.find("silence_trim=") == 0) {
+                int mode = atoi(line.substr(13).c_str());
+                if (mode >= SILENCE_OFF && mode <= SILENCE_SPEECH) {
+                    app_data->silence_trim = (SilenceMode)mode;
+                    player_command(app_data, "silence %s", SILENCE_NAMES[mode]);
+                }
+            }
+            if (line.find("loudness_scan=") == 0) {
+                app_data->loudness_scan = atoi(line.substr(14).c_str()) != 0;
+            }
+            if (line.find("eq_preset=") == 0) {
+                app_data->eq_preset = line.substr(10);
+            }
+            if (line.find("speed=") == 0) {
+                // Pick the closest step; on_speed_changed applies it
+                float speed = atof(line.substr(6).c_str());
+                int best = 0;
+                for (int i = 1; i < SPEED_STEP_COUNT; ++i) {
+                    if (fabsf(SPEED_STEPS[i] - speed) < fabsf(SPEED_STEPS[best] - speed)) best = i;
+                }
+                gtk_combo_box_set_active(GTK_COMBO_BOX(app_data->speed_combo), best);
+            }
+            if (line.find("crossfade=") == 0) {
+                // Closest step again; on_crossfade_changed applies it
+                float seconds = atof(line.substr(10).c_str());
+                int best = 0;
+                for (int i = 1; i < CROSSFADE_STEP_COUNT; ++i) {
+                    if (fabsf(CROSSFADE_STEPS[i] - seconds) < fabsf(CROSSFADE_STEPS[best] - seconds)) best = i;
+                }
+                gtk_combo_box_set_active(GTK_COMBO_BOX(app_data->crossfade_combo), best);
+            }
+            EqPreset preset;
+            if (eq_parse_preset_line(line, &preset)) {
+                app_data->eq_presets.push_back(preset);
+                add_eq_combo_entry(app_data, preset.name);
             }
         }
         conffile.close();
     }
+    // Selecting the entry applies the preset through on_eq_changed
+    std::vector<std::string>::iterator eq_it = std::find(app_data->eq_names.begin(), app_data->eq_names.end(), app_data->eq_preset);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app_data->eq_combo), eq_it != app_data->eq_names.end() ? (gint)(eq_it - app_data->eq_names.begin()) : 0);
+    // The daemon reads the same playlist file; make sure it has this one
+    player_command(app_data, "load %s", playlist_path.c_str());
+    player_command(app_data, "scan %d", app_data->loudness_scan ? 1 : 0);
     if (current_index != -1) {
         GtkTreePath *path = gtk_tree_path_new_from_indices(current_index, -1);
         if (path) {
@@ -345,6 +617,15 @@ void load_state(AppData *app_data) {
             gtk_tree_path_free(path);
         }
     }
+    // Background playback may have moved on since: show what the daemon
+    // plays, or where Play resumes
+    PlayerStatus status;
+    ResumePoint resume;
+    if (app_data->player->status(&status) && status.playing) {
+        select_song_path(app_data, status.index, status.filepath);
+    } else if (resume.load(get_config_path(".kinamp_resume"))) {
+        select_song_path(app_data, current_index, resume.get_filepath());
+    }
 }
 
 
@@ -355,60 +636,163 @@ void set_label_font(GtkWidget *label, const char *font_desc_str) {
     pango_font_description_free(font_desc);
 }
 
-// --- Helper function to recursively add files from a directory ---
-void add_directory_to_playlist(const char *dir_path, GtkListStore *playlist_store) {
-    DIR *dir = opendir(dir_path);
-    if (dir == NULL) {
-        return;
+// --- Playlist Titles ---
+// Tags are only read for the rows on screen, plus a page below and half a
+// page above for scrolling, on the loader's thread; until then rows show
+// their file name. Each scroll replaces the request, so rows scrolled past
+// are not read at all.
+
+void request_visible_titles(AppData *app_data) {
+    GtkTreePath *start, *end;
+    if (!gtk_tree_view_get_visible_range(app_data->playlist_treeview, &start, &end)) return;
+    int first = gtk_tree_path_get_indices(start)[0];
+    int last = gtk_tree_path_get_indices(end)[0];
+    gtk_tree_path_free(start);
+    gtk_tree_path_free(end);
+
+    int page = last - first + 1;
+    int count = playlist_model_length(app_data->playlist);
+    std::vector<int> rows;
+    for (int row = first; row <= last + page && row < count; ++row) rows.push_back(row);
+    for (int row = first - 1; row >= first - page / 2 && row >= 0; --row) rows.push_back(row);
+
+    std::vector<TrackInfoRequest> requests;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (playlist_model_has_title(app_data->playlist, rows[i])) continue;
+        TrackInfoRequest request;
+        request.row = rows[i];
+        request.path = playlist_model_path(app_data->playlist, rows[i]);
+        requests.push_back(request);
+    }
+    app_data->title_loader->request(requests);
+}
+
+// Once the view has laid out the rows, not on every scroll step
+gboolean titles_idle_cb(gpointer data) {
+    AppData *app_data = (AppData*)data;
+    app_data->titles_idle_id = 0;
+    request_visible_titles(app_data);
+    return FALSE;
+}
+
+void on_playlist_scrolled(GtkAdjustment *adjustment, gpointer data) {
+    (void)adjustment;
+    AppData *app_data = (AppData*)data;
+    if (app_data->titles_idle_id == 0) {
+        app_data->titles_idle_id = g_idle_add(titles_idle_cb, app_data);
     }
+}
 
-    std::vector<std::string> files;
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (entry->d_type == DT_DIR) {
-            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
-                std::string new_path = std::string(dir_path) + "/" + entry->d_name;
-                add_directory_to_playlist(new_path.c_str(), playlist_store);
-            }
-        }
-        else {
-            const char *ext = strrchr(entry->d_name, '.');
-            if (ext && (strcmp(ext, ".mp3") == 0 || strcmp(ext, ".flac") == 0 || strcmp(ext, ".wav") == 0)) {
-                files.push_back(std::string(dir_path) + "/" + entry->d_name);
-            }
+gboolean titles_loaded_idle_cb(gpointer data) {
+    AppData *app_data = (AppData*)data;
+    std::vector<TrackInfoResult> results;
+    app_data->title_loader->take_results(&results);
+    for (size_t i = 0; i < results.size(); ++i) {
+        // The playlist may have changed since the request
+        const char *path = playlist_model_path(app_data->playlist, results[i].row);
+        if (path && results[i].path == path) {
+            playlist_model_set_title(app_data->playlist, results[i].row, results[i].title.c_str());
         }
     }
-    closedir(dir);
+    return FALSE;
+}
+
+// Loader thread
+void on_titles_loaded(void *data) {
+    g_idle_add(titles_loaded_idle_cb, data);
+}
+
+// --- Folder Import ---
+// FolderScanner walks the folder on its own thread. The files it finds are
+// added here, on the main loop, a batch at a time, so the playlist fills
+// up while the interface stays usable. Meanwhile the Add Folder button
+// shows how far it got, and cancels the import.
 
-    std::sort(files.begin(), files.end());
+gboolean folder_import_idle_cb(gpointer data);
 
-    for (const auto& file_path : files) {
-        GtkTreeIter iter;
-        gtk_list_store_append(playlist_store, &iter);
-        gtk_list_store_set(playlist_store, &iter, 0, file_path.c_str(), -1);
+// Scan thread: pick the files up on the main loop
+void on_folder_scan_progress(void *data) {
+    g_idle_add(folder_import_idle_cb, data);
+}
+
+void stop_folder_import(AppData *app_data) {
+    if (!app_data->importing) return;
+    app_data->folder_scanner.stop();
+    app_data->importing = false;
+    app_data->imported.clear();
+    app_data->playlist_reload_pending = false;
+    gtk_button_set_label(GTK_BUTTON(app_data->add_folder_button), "Add Folder");
+}
+
+void start_folder_import(AppData *app_data, const char *folder_path) {
+    stop_folder_import(app_data);
+    app_data->importing = app_data->folder_scanner.start(folder_path);
+    if (app_data->importing) {
+        gtk_button_set_label(GTK_BUTTON(app_data->add_folder_button), "Stop import");
     }
 }
 
+// Stop the import and hand the playlist to the daemon. If the daemon
+// rewrote its playlist meanwhile, that one is taken and the imported files
+// are appended to it again, instead of pushing back the stale list.
+void finish_folder_import(AppData *app_data) {
+    PathList imported;
+    imported.swap(app_data->imported);
+    bool reload = app_data->playlist_reload_pending;
+    stop_folder_import(app_data);
+
+    PathList paths;
+    if (reload && read_m3u(get_config_path(".kinamp_playlist.m3u").c_str(), &paths)) {
+        for (int i = 0; i < imported.size(); ++i) paths.append(imported.get(i));
+        gtk_tree_view_set_model(app_data->playlist_treeview, NULL);
+        playlist_model_replace(app_data->playlist, &paths);
+        gtk_tree_view_set_model(app_data->playlist_treeview, GTK_TREE_MODEL(app_data->playlist));
+        app_data->status_index = -1;
+    }
+    sync_playlist(app_data);
+}
+
+gboolean folder_import_idle_cb(gpointer data) {
+    AppData *app_data = (AppData*)data;
+    if (!app_data->importing) return FALSE; // Cancelled meanwhile
+
+    // Checked first: once the scan is over, everything is in take_files()
+    bool done = !app_data->folder_scanner.is_running();
+    std::vector<std::string> files;
+    app_data->folder_scanner.take_files(&files);
+    for (size_t i = 0; i < files.size(); ++i) {
+        playlist_model_append(app_data->playlist, files[i].c_str());
+        app_data->imported.append(files[i].c_str());
+    }
+
+    if (done) {
+        finish_folder_import(app_data);
+    } else if (!files.empty()) {
+        gchar *text = g_strdup_printf("Stop import (%d)", app_data->folder_scanner.get_found_count());
+        gtk_button_set_label(GTK_BUTTON(app_data->add_folder_button), text);
+        g_free(text);
+    }
+    return FALSE;
+}
+
 // --- Playback Controls ---
-void play_selected_song(AppData* app_data) {
+// `resume`: continue from the saved position if it is for this song
+void play_selected_song(AppData* app_data, bool resume) {
     GtkTreeSelection *selection = gtk_tree_view_get_selection(app_data->playlist_treeview);
     GtkTreeIter iter;
     GtkTreeModel *model;
 
     if (gtk_tree_selection_get_selected(selection, &model, &iter)) {
-        gchar *file_path = NULL;
-        gtk_tree_model_get(model, &iter, 0, &file_path, -1);
+        int index = playlist_model_iter_index(&iter);
+        const char *file_path = playlist_model_path(app_data->playlist, index);
         if (file_path) {
-            app_data->backend->play_file(file_path);
             // Update title immediately on play
-            char* path_copy = g_strdup(file_path);
-            char* base = basename(path_copy);
-            gtk_label_set_text(app_data->song_title_label, base);
+            std::string title = song_title(app_data, file_path);
+            player_command(app_data, resume ? "play %d resume" : "play %d", index);
+            app_data->status_index = index;
+            gtk_label_set_text(app_data->song_title_label, title.c_str());
 
-            app_data->last_title = base; // Update cache
-            
-            g_free(path_copy);
-            g_free(file_path);
+            app_data->last_title = title; // Update cache
         }
     }
 }
@@ -423,7 +807,7 @@ void on_previous_clicked(GtkWidget *widget, gpointer data) {
         GtkTreePath *path = gtk_tree_model_get_path(model, &iter);
         if (gtk_tree_path_prev(path)) {
             gtk_tree_view_set_cursor(GTK_TREE_VIEW(app_data->playlist_treeview), path, NULL, FALSE);
-            play_selected_song(app_data);
+            play_selected_song(app_data, false);
         }
         gtk_tree_path_free(path);
     }
@@ -433,23 +817,18 @@ void on_play_pause_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     AppData *app_data = (AppData*)data;
 
-    if (app_data->backend->is_shutting_down()) {
-        g_print("UI: Backend is stopping, ignoring play/pause click.\n");
-        return;
-    }
-
-    if (app_data->backend->is_playing || app_data->backend->is_paused) {
-        app_data->backend->pause();
+    if (app_data->status.playing) {
+        player_command(app_data, "pause");
         return;
     }
     
-    play_selected_song(app_data);
+    play_selected_song(app_data, true);
 }
 
 void on_stop_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     AppData *app_data = (AppData*)data;
-    app_data->backend->stop();
+    player_command(app_data, "stop");
 }
 
 void on_next_clicked(GtkWidget *widget, gpointer data) {
@@ -465,7 +844,7 @@ void on_next_clicked(GtkWidget *widget, gpointer data) {
         // Check if the path is valid before using it
         if (gtk_tree_model_get_iter(model, &iter, path)) {
             gtk_tree_view_set_cursor(GTK_TREE_VIEW(app_data->playlist_treeview), path, NULL, FALSE);
-            play_selected_song(app_data);
+            play_selected_song(app_data, false);
         }
         gtk_tree_path_free(path);
     }
@@ -477,8 +856,12 @@ void on_background_clicked(GtkWidget *widget, gpointer data) {
     LipcSetIntProperty(lipcInstance,"com.lab126.powerd","flIntensity",app_data->flIntensity);
     enableSleep();
     closeLipcInstance();
+    // Keep what the import found, on top of the daemon's current playlist
+    if (app_data->importing) finish_folder_import(app_data);
+    app_data->title_loader->stop();
     save_state(app_data);
-    app_data->backend->stop();
+    // The daemon keeps playing; only the UI goes away
+    app_data->player->disconnect();
     gtk_main_quit();
     exit(10); // Special exit code to signal background mode
 }
@@ -490,8 +873,11 @@ void on_close_clicked(GtkWidget *widget, gpointer data) {
     LipcSetIntProperty(lipcInstance,"com.lab126.btfd","ensureBTconnection",0);
     enableSleep();
     closeLipcInstance();
+    // Keep what the import found, on top of the daemon's current playlist
+    if (app_data->importing) finish_folder_import(app_data);
+    app_data->title_loader->stop();
     save_state(app_data);
-    app_data->backend->stop();
+    player_command(app_data, "quit");
     gtk_main_quit();
 }
 
@@ -507,6 +893,7 @@ void on_shuffle_clicked(GtkWidget *widget, gpointer data) {
         set_button_icon(app_data->repeat_button, repeat_icon);
     }
     g_print("Shuffle mode toggled. New strategy: %d\n", app_data->current_strategy);
+    player_command(app_data, "strategy %s", STRATEGY_NAMES[app_data->current_strategy]);
 }
 
 void on_repeat_clicked(GtkWidget *widget, gpointer data) {
@@ -521,6 +908,7 @@ void on_repeat_clicked(GtkWidget *widget, gpointer data) {
         set_button_icon(app_data->shuffle_button, shuffle_icon);
     }
     g_print("Repeat mode toggled. New strategy: %d\n", app_data->current_strategy);
+    player_command(app_data, "strategy %s", STRATEGY_NAMES[app_data->current_strategy]);
 }
 
 void on_fl_clicked(GtkWidget *widget, gpointer data) {
@@ -536,17 +924,48 @@ void on_bluetooth_clicked(GtkWidget *widget, gpointer data) {
     LipcSetStringProperty(lipcInstance,"com.lab126.pillow","customDialog","{\"name\":\"bt_wizard_dialog\", \"clientParams\": {\"show\":true, \"winmgrModal\":true, \"replySrc\":\"\"}}");
 }
 
+void on_volume_changed(GtkRange *range, gpointer data) {
+    AppData *app_data = (AppData*)data;
+    player_command(app_data, "volume %.1f", gtk_range_get_value(range));
+}
+
+void on_eq_changed(GtkComboBox *combo, gpointer data) {
+    AppData *app_data = (AppData*)data;
+    gchar *name = gtk_combo_box_get_active_text(combo);
+    if (name) {
+        apply_eq_preset(app_data, name);
+        g_free(name);
+    }
+}
+
+void on_speed_changed(GtkComboBox *combo, gpointer data) {
+    AppData *app_data = (AppData*)data;
+    int index = gtk_combo_box_get_active(combo);
+    if (index >= 0 && index < SPEED_STEP_COUNT) {
+        player_command(app_data, "speed %.2f", SPEED_STEPS[index]);
+    }
+}
+
+void on_crossfade_changed(GtkComboBox *combo, gpointer data) {
+    AppData *app_data = (AppData*)data;
+    int index = gtk_combo_box_get_active(combo);
+    if (index >= 0 && index < CROSSFADE_STEP_COUNT) {
+        player_command(app_data, "crossfade %d", CROSSFADE_STEPS[index]);
+    }
+}
+
 void on_displayUpdate_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     AppData *app_data = (AppData*)data;
     app_data->dispUpdate = !(app_data->dispUpdate);
+    render_status(app_data);
+    update_clock_timer(app_data);
 }
 
 // --- Playlist Management Callbacks ---
 void on_add_file_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     AppData *app_data = (AppData*)data;
-    GtkListStore *playlist_store = app_data->playlist_store;
     GtkWidget *dialog = gtk_file_chooser_dialog_new("L:A_N:application_PC:TS_ID:com.kbarni.kinamp",
                                                   NULL,
                                                   GTK_FILE_CHOOSER_ACTION_OPEN,
@@ -566,12 +985,11 @@ void on_add_file_clicked(GtkWidget *widget, gpointer data) {
         GSList *filenames = gtk_file_chooser_get_filenames(GTK_FILE_CHOOSER(dialog));
         for (GSList *l = filenames; l != NULL; l = l->next) {
             char *file_path = (char*)l->data;
-            GtkTreeIter iter;
-            gtk_list_store_append(playlist_store, &iter);
-            gtk_list_store_set(playlist_store, &iter, 0, file_path, -1);
+            playlist_model_append(app_data->playlist, file_path);
             g_free(file_path);
         }
         g_slist_free(filenames);
+        sync_playlist(app_data);
     }
 
     gtk_widget_destroy(dialog);
@@ -579,7 +997,11 @@ void on_add_file_clicked(GtkWidget *widget, gpointer data) {
 void on_add_folder_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     AppData *app_data = (AppData*)data;
-    GtkListStore *playlist_store = app_data->playlist_store;
+    if (app_data->importing) {
+        // Keep what was found so far
+        finish_folder_import(app_data);
+        return;
+    }
     GtkWidget *dialog = gtk_file_chooser_dialog_new("L:A_N:application_PC:TS_ID:com.kbarni.kinamp",
                                                   NULL,
                                                   GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER,
@@ -589,7 +1011,7 @@ void on_add_folder_clicked(GtkWidget *widget, gpointer data) {
 
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         char *folder_path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
-        add_directory_to_playlist(folder_path, playlist_store);
+        start_folder_import(app_data, folder_path);
         g_free(folder_path);
     }
 
@@ -598,13 +1020,15 @@ void on_add_folder_clicked(GtkWidget *widget, gpointer data) {
 void on_clear_playlist_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     AppData *app_data = (AppData*)data;
-    GtkListStore *playlist_store = app_data->playlist_store;
-    gtk_list_store_clear(playlist_store);
+    stop_folder_import(app_data);
+    gtk_tree_view_set_model(app_data->playlist_treeview, NULL);
+    playlist_model_clear(app_data->playlist);
+    gtk_tree_view_set_model(app_data->playlist_treeview, GTK_TREE_MODEL(app_data->playlist));
+    sync_playlist(app_data);
 }
 void on_save_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     AppData *app_data = (AppData*)data;
-    GtkListStore *playlist_store = app_data->playlist_store;
     GtkWidget *dialog = gtk_file_chooser_dialog_new("L:A_N:application_PC:TS_ID:com.kbarni.kinamp",
                                                   NULL,
                                                   GTK_FILE_CHOOSER_ACTION_SAVE,
@@ -620,21 +1044,7 @@ void on_save_clicked(GtkWidget *widget, gpointer data) {
 
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
-        std::ofstream outfile(filename);
-        if (outfile.is_open()) {
-            GtkTreeIter iter;
-            gboolean valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(playlist_store), &iter);
-            while (valid) {
-                gchar *path = NULL;
-                gtk_tree_model_get(GTK_TREE_MODEL(playlist_store), &iter, 0, &path, -1);
-                if (path) {
-                    outfile << path << std::endl;
-                    g_free(path);
-                }
-                valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(playlist_store), &iter);
-            }
-            outfile.close();
-        }
+        write_playlist(app_data->playlist, filename);
         g_free(filename);
     }
 
@@ -643,7 +1053,6 @@ void on_save_clicked(GtkWidget *widget, gpointer data) {
 void on_load_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
     AppData *app_data = (AppData*)data;
-    GtkListStore *playlist_store = app_data->playlist_store;
     GtkWidget *dialog = gtk_file_chooser_dialog_new("L:A_N:application_PC:TS_ID:com.kbarni.kinamp",
                                                   NULL,
                                                   GTK_FILE_CHOOSER_ACTION_OPEN,
@@ -658,18 +1067,9 @@ void on_load_clicked(GtkWidget *widget, gpointer data) {
 
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         char *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
-        std::ifstream infile(filename);
-        if (infile.is_open()) {
-            gtk_list_store_clear(playlist_store);
-            std::string line;
-            while (std::getline(infile, line)) {
-                if (!line.empty()) {
-                    GtkTreeIter iter;
-                    gtk_list_store_append(playlist_store, &iter);
-                    gtk_list_store_set(playlist_store, &iter, 0, line.c_str(), -1);
-                }
-            }
-            infile.close();
+        stop_folder_import(app_data);
+        if (read_playlist(app_data, filename)) {
+            sync_playlist(app_data);
         }
         g_free(filename);
     }
@@ -682,15 +1082,37 @@ int main(int argc, char* argv[]) {
     gtk_init(&argc, &argv);
 
     // --- App Data ---
-    MusicBackend backend;
+    ControlClient player;
+    ControlClient events;
     AppData app_data;
-    app_data.backend = &backend;
+    TrackInfoLoader title_loader(&app_data.track_info);
+    app_data.player = &player;
+    app_data.events = &events;
+    app_data.title_loader = &title_loader;
+    app_data.titles_idle_id = 0;
+    app_data.status.playing = false;
+    app_data.status.paused = false;
+    app_data.status_time = 0;
+    app_data.status_index = -1;
+    app_data.playlist_version = 0;
+    app_data.playlist_version_known = false;
+    app_data.clock_timer_id = 0;
+    app_data.clock_periodic = false;
+    app_data.screen_off = false;
     app_data.current_strategy = NORMAL;
-    app_data.next_song_pending = false;
     app_data.flIntensity = 0;
     app_data.dispUpdate=true;
-
-    backend.set_eos_callback(on_eos_cb, &app_data);
+    app_data.loudness_scan = false;
+    app_data.replaygain_mode = REPLAYGAIN_TRACK;
+    app_data.silence_trim = SILENCE_OFF;
+    app_data.importing = false;
+    app_data.playlist_reload_pending = false;
+    app_data.folder_scanner.set_callback(on_folder_scan_progress, &app_data);
+    app_data.folder_scanner.set_index_path(get_config_path(".kinamp_library.idx"));
+    title_loader.set_callback(on_titles_loaded, &app_data);
+
+    // Attach to the playback daemon, or start it
+    connect_daemon(&player);
 
     openLipcInstance();
     disableSleep();
@@ -815,6 +1237,60 @@ int main(int argc, char* argv[]) {
     gtk_box_pack_start(GTK_BOX(row2_hbox), background_button, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(row2_hbox), close_button, FALSE, FALSE, 0);
 
+    // Row 3: Software volume / pre-amp (dB)
+    GtkWidget *volume_hbox = gtk_hbox_new(FALSE, 5);
+    gtk_box_pack_start(GTK_BOX(player_vbox), volume_hbox, FALSE, FALSE, 0);
+
+    GtkWidget *volume_label = gtk_label_new("Volume (dB)");
+    set_label_font(volume_label, "Sans 10");
+    gtk_box_pack_start(GTK_BOX(volume_hbox), volume_label, FALSE, FALSE, 0);
+
+    GtkWidget *volume_scale = gtk_hscale_new_with_range(GainStage::MIN_DB, GainStage::MAX_DB, 1);
+    gtk_scale_set_digits(GTK_SCALE(volume_scale), 0);
+    gtk_scale_set_value_pos(GTK_SCALE(volume_scale), GTK_POS_RIGHT);
+    // Only apply when the slider is released: avoids a redraw storm on eink
+    gtk_range_set_update_policy(GTK_RANGE(volume_scale), GTK_UPDATE_DISCONTINUOUS);
+    gtk_range_set_value(GTK_RANGE(volume_scale), 0);
+    app_data.volume_scale = volume_scale;
+    g_signal_connect(volume_scale, "value-changed", G_CALLBACK(on_volume_changed), &app_data);
+    gtk_box_pack_start(GTK_BOX(volume_hbox), volume_scale, TRUE, TRUE, 0);
+
+    GtkWidget *eq_label = gtk_label_new("EQ");
+    set_label_font(eq_label, "Sans 10");
+    gtk_box_pack_start(GTK_BOX(volume_hbox), eq_label, FALSE, FALSE, 0);
+
+    // Built-in presets first; user presets are appended by load_state()
+    GtkWidget *eq_combo = gtk_combo_box_new_text();
+    app_data.eq_combo = eq_combo;
+    const std::vector<EqPreset>& builtin_presets = eq_builtin_presets();
+    for (size_t i = 0; i < builtin_presets.size(); ++i) {
+        add_eq_combo_entry(&app_data, builtin_presets[i].name);
+    }
+    g_signal_connect(eq_combo, "changed", G_CALLBACK(on_eq_changed), &app_data);
+    gtk_box_pack_start(GTK_BOX(volume_hbox), eq_combo, FALSE, FALSE, 0);
+
+    GtkWidget *speed_combo = gtk_combo_box_new_text();
+    app_data.speed_combo = speed_combo;
+    for (int i = 0; i < SPEED_STEP_COUNT; ++i) {
+        gchar *text = g_strdup_printf("%.2fx", SPEED_STEPS[i]);
+        gtk_combo_box_append_text(GTK_COMBO_BOX(speed_combo), text);
+        g_free(text);
+        if (SPEED_STEPS[i] == 1.0f) gtk_combo_box_set_active(GTK_COMBO_BOX(speed_combo), i);
+    }
+    g_signal_connect(speed_combo, "changed", G_CALLBACK(on_speed_changed), &app_data);
+    gtk_box_pack_start(GTK_BOX(volume_hbox), speed_combo, FALSE, FALSE, 0);
+
+    GtkWidget *crossfade_combo = gtk_combo_box_new_text();
+    app_data.crossfade_combo = crossfade_combo;
+    for (int i = 0; i < CROSSFADE_STEP_COUNT; ++i) {
+        gchar *text = CROSSFADE_STEPS[i] ? g_strdup_printf("Fade %ds", CROSSFADE_STEPS[i]) : g_strdup("No fade");
+        gtk_combo_box_append_text(GTK_COMBO_BOX(crossfade_combo), text);
+        g_free(text);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(crossfade_combo), 0);
+    g_signal_connect(crossfade_combo, "changed", G_CALLBACK(on_crossfade_changed), &app_data);
+    gtk_box_pack_start(GTK_BOX(volume_hbox), crossfade_combo, FALSE, FALSE, 0);
+
 
     // --- Playlist Section ---
     GtkWidget *playlist_label = gtk_label_new("<b>Playlist</b>"); 
@@ -829,15 +1305,26 @@ int main(int argc, char* argv[]) {
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
     gtk_container_add(GTK_CONTAINER(playlist_frame), scrolled_window);
 
-    GtkListStore *playlist_store = gtk_list_store_new(1, G_TYPE_STRING);
-    app_data.playlist_store = playlist_store;
-    GtkWidget *playlist_treeview = gtk_tree_view_new_with_model(GTK_TREE_MODEL(playlist_store));
+    PlaylistModel *playlist = playlist_model_new();
+    app_data.playlist = playlist;
+    GtkWidget *playlist_treeview = gtk_tree_view_new_with_model(GTK_TREE_MODEL(playlist));
     app_data.playlist_treeview = GTK_TREE_VIEW(playlist_treeview);
     gtk_container_add(GTK_CONTAINER(scrolled_window), playlist_treeview);
 
+    // Fixed height rows: the view only reads the rows it shows, instead of
+    // measuring the whole playlist. Titles fill in as their tags are read,
+    // see request_visible_titles().
     GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
-    GtkTreeViewColumn *column = gtk_tree_view_column_new_with_attributes("Filename", renderer, "text", 0, NULL);
+    g_object_set(renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+    GtkTreeViewColumn *column = gtk_tree_view_column_new_with_attributes("Title", renderer, "text", PLAYLIST_COLUMN_TITLE, NULL);
+    gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_expand(column, TRUE);
     gtk_tree_view_append_column(GTK_TREE_VIEW(playlist_treeview), column);
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(playlist_treeview), TRUE);
+    // Scrolling, resizing and new rows all show up on the adjustment
+    GtkAdjustment *vadjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled_window));
+    g_signal_connect(vadjustment, "value-changed", G_CALLBACK(on_playlist_scrolled), &app_data);
+    g_signal_connect(vadjustment, "changed", G_CALLBACK(on_playlist_scrolled), &app_data);
 
 
     // --- Playlist Management Buttons ---
@@ -847,6 +1334,7 @@ int main(int argc, char* argv[]) {
     GtkWidget *add_file_button = gtk_button_new_with_label("Add file");
     gtk_container_set_border_width(GTK_CONTAINER(add_file_button), 5);
     GtkWidget *add_folder_button = gtk_button_new_with_label("Add Folder");
+    app_data.add_folder_button = add_folder_button;
     gtk_container_set_border_width(GTK_CONTAINER(add_folder_button), 5);
     GtkWidget *clear_playlist_button = gtk_button_new_with_label("Clear playlist");
     gtk_container_set_border_width(GTK_CONTAINER(clear_playlist_button), 5);
@@ -876,7 +1364,9 @@ int main(int argc, char* argv[]) {
 
     // --- Load State and Show Window ---
     load_state(&app_data);
-    g_timeout_add(500, update_progress_cb, &app_data);
+    connect_events(&app_data);
+    LipcSubscribeExt(lipcInstance, "com.lab126.powerd", "goingToScreenSaver", on_powerd_event, &app_data);
+    LipcSubscribeExt(lipcInstance, "com.lab126.powerd", "outOfScreenSaver", on_powerd_event, &app_data);
     gtk_widget_show_all(window);
     gtk_main();
 
@@ -0,0 +1,178 @@
+#include "path_list.h"
+#include <string.h>
+
+#include <utility>
+
+// Parent of top level directories / directory of bare file names
+static const uint32_t NO_DIR = 0xffffffff;
+// lookup_dir() result for a directory that is not in the list
+static const uint32_t UNKNOWN_DIR = 0xfffffffe;
+
+static uint32_t hash_child(uint32_t parent, const char* name, size_t len) {
+    // FNV-1a over the name, seeded with the parent
+    uint32_t h = 2166136261u ^ parent;
+    for (size_t i = 0; i < len; ++i) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+PathList::PathList() : last_dir(NO_DIR) {
+}
+
+void PathList::append(const char* path) {
+    const char* slash = strrchr(path, '/');
+    Entry entry;
+    entry.dir = NO_DIR;
+    if (slash) {
+        size_t len = slash - path;
+        if (last_dir != NO_DIR && last_dir_path.size() == len && memcmp(last_dir_path.data(), path, len) == 0) {
+            entry.dir = last_dir;
+        } else {
+            entry.dir = intern_dir(path, len);
+            last_dir = entry.dir;
+            last_dir_path.assign(path, len);
+        }
+    }
+    const char* base = slash ? slash + 1 : path;
+    entry.name = add_name(base, strlen(base));
+    entries.push_back(entry);
+}
+
+void PathList::clear() {
+    PathList empty;
+    swap(empty);
+}
+
+void PathList::swap(PathList& other) {
+    names.swap(other.names);
+    dirs.swap(other.dirs);
+    entries.swap(other.entries);
+    dir_slots.swap(other.dir_slots);
+    std::swap(last_dir, other.last_dir);
+    last_dir_path.swap(other.last_dir_path);
+}
+
+int PathList::size() const {
+    return (int)entries.size();
+}
+
+bool PathList::empty() const {
+    return entries.empty();
+}
+
+const char* PathList::get(int index) const {
+    const Entry& entry = entries[index];
+    buffer.clear();
+    if (entry.dir != NO_DIR) append_dir(entry.dir, &buffer);
+    buffer += &names[entry.name];
+    return buffer.c_str();
+}
+
+int PathList::find(const char* path, int hint) const {
+    if (hint >= 0 && hint < size() && strcmp(get(hint), path) == 0) return hint;
+
+    const char* slash = strrchr(path, '/');
+    uint32_t dir = NO_DIR;
+    if (slash) {
+        dir = lookup_dir(path, slash - path);
+        if (dir == UNKNOWN_DIR) return -1;
+    }
+    const char* base = slash ? slash + 1 : path;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].dir == dir && strcmp(&names[entries[i].name], base) == 0) return (int)i;
+    }
+    return -1;
+}
+
+size_t PathList::memory_used() const {
+    return sizeof(*this) + names.capacity() + dirs.capacity() * sizeof(Dir) + entries.capacity() * sizeof(Entry) +
+           dir_slots.capacity() * sizeof(uint32_t) + last_dir_path.capacity() + buffer.capacity();
+}
+
+// =================================================================================
+// Directory Trie
+// =================================================================================
+
+uint32_t PathList::add_name(const char* name, size_t len) {
+    uint32_t offset = (uint32_t)names.size();
+    names.insert(names.end(), name, name + len);
+    names.push_back('\0');
+    return offset;
+}
+
+// Directory ids of `dir_path` (the part of a path before its last slash)
+// are found component by component. An absolute path starts with an empty
+// component: a top level directory named "" that comes out as the leading
+// slash.
+uint32_t PathList::lookup_dir(const char* dir_path, size_t len) const {
+    uint32_t dir = NO_DIR;
+    size_t start = 0;
+    while (true) {
+        const char* end = (const char*)memchr(dir_path + start, '/', len - start);
+        size_t component = end ? (size_t)(end - dir_path) - start : len - start;
+        dir = lookup_child(dir, dir_path + start, component);
+        if (dir == UNKNOWN_DIR || !end) return dir;
+        start += component + 1;
+    }
+}
+
+uint32_t PathList::intern_dir(const char* dir_path, size_t len) {
+    uint32_t dir = NO_DIR;
+    size_t start = 0;
+    while (true) {
+        const char* end = (const char*)memchr(dir_path + start, '/', len - start);
+        size_t component = end ? (size_t)(end - dir_path) - start : len - start;
+        uint32_t child = lookup_child(dir, dir_path + start, component);
+        dir = child != UNKNOWN_DIR ? child : add_child(dir, dir_path + start, component);
+        if (!end) return dir;
+        start += component + 1;
+    }
+}
+
+uint32_t PathList::lookup_child(uint32_t parent, const char* name, size_t len) const {
+    if (dir_slots.empty()) return UNKNOWN_DIR;
+    size_t mask = dir_slots.size() - 1;
+    for (size_t slot = hash_child(parent, name, len) & mask; dir_slots[slot] != 0; slot = (slot + 1) & mask) {
+        const Dir& dir = dirs[dir_slots[slot] - 1];
+        const char* dir_name = &names[dir.name];
+        if (dir.parent == parent && strncmp(dir_name, name, len) == 0 && dir_name[len] == '\0') {
+            return dir_slots[slot] - 1;
+        }
+    }
+    return UNKNOWN_DIR;
+}
+
+uint32_t PathList::add_child(uint32_t parent, const char* name, size_t len) {
+    // Keep the table at most half full
+    if ((dirs.size() + 1) * 2 > dir_slots.size()) grow_dir_slots();
+    Dir dir;
+    dir.parent = parent;
+    dir.name = add_name(name, len);
+    uint32_t id = (uint32_t)dirs.size();
+    dirs.push_back(dir);
+
+    size_t mask = dir_slots.size() - 1;
+    size_t slot = hash_child(parent, name, len) & mask;
+    while (dir_slots[slot] != 0) slot = (slot + 1) & mask;
+    dir_slots[slot] = id + 1;
+    return id;
+}
+
+void PathList::grow_dir_slots() {
+    std::vector<uint32_t> slots(dir_slots.empty() ? 64 : dir_slots.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (uint32_t id = 0; id < dirs.size(); ++id) {
+        const char* name = &names[dirs[id].name];
+        size_t slot = hash_child(dirs[id].parent, name, strlen(name)) & mask;
+        while (slots[slot] != 0) slot = (slot + 1) & mask;
+        slots[slot] = id + 1;
+    }
+    dir_slots.swap(slots);
+}
+
+void PathList::append_dir(uint32_t dir, std::string* out) const {
+    if (dirs[dir].parent != NO_DIR) append_dir(dirs[dir].parent, out);
+    *out += &names[dirs[dir].name];
+    *out += '/';
+}
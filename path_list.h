@@ -0,0 +1,70 @@
+#ifndef PATH_LIST_H
+#define PATH_LIST_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// --- PathList Class ---
+// Compact list of file paths, for playlists of tens of thousands of songs.
+// Music libraries repeat the same few hundred directories over and over
+// ("/mnt/us/music/Artist/Album/"), so directories are interned as a trie:
+// each one is stored once, as its last component plus a link to its
+// parent. An entry is then just a directory id and its file name, and
+// costs 8 bytes plus the file name.
+//
+// Full paths are only put together on demand, into a buffer that is
+// reused by the next call. Paths round-trip exactly, relative ones and
+// doubled slashes included.
+//
+// Not thread safe, not even for reading (the shared buffer); threads
+// take their own copy.
+class PathList {
+public:
+    PathList();
+
+    void append(const char* path);
+    void clear();
+    void swap(PathList& other);
+
+    int size() const;
+    bool empty() const;
+
+    // Path of entry `index`; only valid until the next call
+    const char* get(int index) const;
+
+    // Index of `path`, preferring `hint` if it holds that path; -1 if not
+    // listed
+    int find(const char* path, int hint) const;
+
+    // Bytes held by the list, for diagnostics
+    size_t memory_used() const;
+
+private:
+    struct Dir {
+        uint32_t parent;    // NO_DIR for a top level directory
+        uint32_t name;      // Offset in `names`
+    };
+    struct Entry {
+        uint32_t dir;       // NO_DIR for a path without directory
+        uint32_t name;
+    };
+
+    std::vector<char> names;        // NUL-terminated components, back to back
+    std::vector<Dir> dirs;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> dir_slots; // Hash of `dirs` by (parent, name): id + 1, 0 = free
+    uint32_t last_dir;               // Directory of the last append, usually the next one's too
+    std::string last_dir_path;
+    mutable std::string buffer;
+
+    uint32_t add_name(const char* name, size_t len);
+    uint32_t lookup_dir(const char* dir_path, size_t len) const;
+    uint32_t intern_dir(const char* dir_path, size_t len);
+    uint32_t lookup_child(uint32_t parent, const char* name, size_t len) const;
+    uint32_t add_child(uint32_t parent, const char* name, size_t len);
+    void grow_dir_slots();
+    void append_dir(uint32_t dir, std::string* out) const;
+};
+
+#endif // PATH_LIST_H
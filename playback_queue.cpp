@@ -0,0 +1,84 @@
+#include "playback_queue.h"
+
+// peek_next() has not picked a track since the last change
+static const int NOT_PICKED = -2;
+
+PlaybackQueue::PlaybackQueue()
+    : strategy(NORMAL), current(-1), next(NOT_PICKED), random(std::random_device()())
+{
+}
+
+void PlaybackQueue::replace(PathList& new_tracks) {
+    int index = current >= 0 && current < size() ? current : -1;
+    if (index >= 0) {
+        std::string playing = tracks.get(index);
+        tracks.swap(new_tracks);
+        index = find(playing, index);
+    } else {
+        tracks.swap(new_tracks);
+    }
+    set_current(index);
+}
+
+const PathList& PlaybackQueue::get_tracks() const {
+    return tracks;
+}
+
+int PlaybackQueue::size() const {
+    return tracks.size();
+}
+
+bool PlaybackQueue::empty() const {
+    return tracks.empty();
+}
+
+const char* PlaybackQueue::get_path(int index) const {
+    return tracks.get(index);
+}
+
+void PlaybackQueue::set_strategy(PlaybackStrategy new_strategy) {
+    strategy = new_strategy;
+    next = NOT_PICKED;
+}
+
+PlaybackStrategy PlaybackQueue::get_strategy() const {
+    return strategy;
+}
+
+int PlaybackQueue::get_current() const {
+    return current;
+}
+
+void PlaybackQueue::set_current(int index) {
+    current = index;
+    next = NOT_PICKED;
+}
+
+int PlaybackQueue::peek_next() {
+    if (next != NOT_PICKED) return next;
+
+    next = -1;
+    switch (strategy) {
+        case NORMAL:
+            if (current + 1 < size()) next = current + 1;
+            break;
+        case REPEAT:
+            // Loop back to the start
+            if (!tracks.empty()) next = current + 1 < size() ? current + 1 : 0;
+            break;
+        case RANDOM:
+            if (!tracks.empty()) next = std::uniform_int_distribution<int>(0, size() - 1)(random);
+            break;
+    }
+    return next;
+}
+
+int PlaybackQueue::advance() {
+    int index = peek_next();
+    if (index >= 0) set_current(index);
+    return index;
+}
+
+int PlaybackQueue::find(const std::string& path, int hint) const {
+    return tracks.find(path.c_str(), hint);
+}
@@ -0,0 +1,65 @@
+#ifndef PLAYBACK_QUEUE_H
+#define PLAYBACK_QUEUE_H
+
+#include "path_list.h"
+#include <random>
+#include <string>
+
+// Order in which the playlist is played; saved as a number in .kinamp.conf
+enum PlaybackStrategy {
+    NORMAL,
+    REPEAT,
+    RANDOM
+};
+
+// --- PlaybackQueue Class ---
+// The daemon's playlist and where playback is in it. The current track is
+// a playlist index, never looked up by path, so moving on is O(1) whatever
+// the playlist size, and a file listed twice is still told apart by its
+// position. Paths are kept in a PathList, so a big library playlist costs
+// little more than its file names.
+//
+// The next track is picked once and kept until the position or strategy
+// changes: the song the backend crossfades into and the one played after
+// an end of stream are always the same, also when shuffling.
+class PlaybackQueue {
+public:
+    PlaybackQueue();
+
+    // Swap in a new playlist. The current track keeps its place if it is
+    // still listed: at the same index if that holds the same file,
+    // otherwise at the file's first occurrence; else the position is reset.
+    void replace(PathList& tracks);
+
+    const PathList& get_tracks() const;
+    int size() const;
+    bool empty() const;
+    // Only valid until the next call, see PathList::get()
+    const char* get_path(int index) const;
+
+    void set_strategy(PlaybackStrategy strategy);
+    PlaybackStrategy get_strategy() const;
+
+    // Playlist index of the current track, -1 = before the first one
+    int get_current() const;
+    void set_current(int index);
+
+    // Track after the current one, -1 at the end of the playlist
+    int peek_next();
+
+    // Make peek_next() the current track; -1 (and no change) at the end
+    int advance();
+
+    // Index of `path`, preferring `hint` if it holds that file; -1 if not
+    // listed. Only this is O(n), and only when the hint misses.
+    int find(const std::string& path, int hint) const;
+
+private:
+    PathList tracks;
+    PlaybackStrategy strategy;
+    int current;
+    int next;               // Picked next track, -2 = not picked yet
+    std::mt19937 random;
+};
+
+#endif // PLAYBACK_QUEUE_H
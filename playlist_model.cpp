@@ -0,0 +1,254 @@
+#include "playlist_model.h"
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+
+struct _PlaylistModel {
+    GObject parent;
+    gint stamp;             // Changes whenever existing iters become invalid
+    PathList* rows;
+    gint length;            // Rows the view knows about, see playlist_model_clear()
+    std::unordered_map<gint, std::string>* titles;  // Only rows with a title
+};
+
+struct _PlaylistModelClass {
+    GObjectClass parent_class;
+};
+
+static void playlist_model_tree_model_init(GtkTreeModelIface* iface);
+
+G_DEFINE_TYPE_WITH_CODE(PlaylistModel, playlist_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, playlist_model_tree_model_init))
+
+// =================================================================================
+// GObject
+// =================================================================================
+
+static void playlist_model_init(PlaylistModel* model) {
+    model->stamp = g_random_int();
+    model->rows = new PathList();
+    model->length = 0;
+    model->titles = new std::unordered_map<gint, std::string>();
+}
+
+static void playlist_model_finalize(GObject* object) {
+    delete PLAYLIST_MODEL(object)->rows;
+    delete PLAYLIST_MODEL(object)->titles;
+    G_OBJECT_CLASS(playlist_model_parent_class)->finalize(object);
+}
+
+static void playlist_model_class_init(PlaylistModelClass* klass) {
+    G_OBJECT_CLASS(klass)->finalize = playlist_model_finalize;
+}
+
+PlaylistModel* playlist_model_new(void) {
+    return PLAYLIST_MODEL(g_object_new(TYPE_PLAYLIST_MODEL, NULL));
+}
+
+// =================================================================================
+// Rows
+// =================================================================================
+
+// Only build paths and emit when a view is connected
+static bool has_listener(PlaylistModel* model, const char* signal) {
+    return g_signal_has_handler_pending(model, g_signal_lookup(signal, GTK_TYPE_TREE_MODEL), 0, FALSE);
+}
+
+static void fill_iter(PlaylistModel* model, gint index, GtkTreeIter* iter) {
+    iter->stamp = model->stamp;
+    iter->user_data = GINT_TO_POINTER(index);
+    iter->user_data2 = NULL;
+    iter->user_data3 = NULL;
+}
+
+void playlist_model_append(PlaylistModel* model, const char* path) {
+    model->rows->append(path);
+    gint index = model->length++;
+
+    if (!has_listener(model, "row-inserted")) return;
+    GtkTreeIter iter;
+    fill_iter(model, index, &iter);
+    GtkTreePath* tree_path = gtk_tree_path_new_from_indices(index, -1);
+    gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), tree_path, &iter);
+    gtk_tree_path_free(tree_path);
+}
+
+void playlist_model_clear(PlaylistModel* model) {
+    bool notify = has_listener(model, "row-deleted");
+
+    // Like GtkListStore: one row at a time, from the end, so a view never
+    // sees indices that no longer exist. The paths stay until the end, the
+    // view may still read the rows it has not been told about.
+    while (model->length > 0) {
+        --model->length;
+        if (!notify) continue;
+        GtkTreePath* tree_path = gtk_tree_path_new_from_indices(model->length, -1);
+        gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), tree_path);
+        gtk_tree_path_free(tree_path);
+    }
+    // Gives the memory back: a cleared playlist is usually replaced by
+    // another one of a different size
+    model->rows->clear();
+    std::unordered_map<gint, std::string>().swap(*model->titles);
+    ++model->stamp;
+}
+
+void playlist_model_replace(PlaylistModel* model, PathList* paths) {
+    playlist_model_clear(model);
+    model->rows->swap(*paths);
+    gint count = model->rows->size();
+
+    if (!has_listener(model, "row-inserted")) {
+        model->length = count;
+        return;
+    }
+    while (model->length < count) {
+        gint index = model->length++;
+        GtkTreeIter iter;
+        fill_iter(model, index, &iter);
+        GtkTreePath* tree_path = gtk_tree_path_new_from_indices(index, -1);
+        gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), tree_path, &iter);
+        gtk_tree_path_free(tree_path);
+    }
+}
+
+gint playlist_model_length(PlaylistModel* model) {
+    return model->length;
+}
+
+const char* playlist_model_path(PlaylistModel* model, gint index) {
+    if (index < 0 || index >= model->length) return NULL;
+    return model->rows->get(index);
+}
+
+void playlist_model_set_title(PlaylistModel* model, gint index, const char* title) {
+    if (index < 0 || index >= model->length) return;
+    (*model->titles)[index] = title;
+
+    if (!has_listener(model, "row-changed")) return;
+    GtkTreeIter iter;
+    fill_iter(model, index, &iter);
+    GtkTreePath* tree_path = gtk_tree_path_new_from_indices(index, -1);
+    gtk_tree_model_row_changed(GTK_TREE_MODEL(model), tree_path, &iter);
+    gtk_tree_path_free(tree_path);
+}
+
+gboolean playlist_model_has_title(PlaylistModel* model, gint index) {
+    return model->titles->count(index) > 0;
+}
+
+gint playlist_model_iter_index(const GtkTreeIter* iter) {
+    return GPOINTER_TO_INT(iter->user_data);
+}
+
+gint playlist_model_find(PlaylistModel* model, const char* path) {
+    return model->rows->find(path, -1);
+}
+
+// =================================================================================
+// GtkTreeModel Interface
+// =================================================================================
+
+static GtkTreeModelFlags get_flags(GtkTreeModel* tree_model) {
+    (void)tree_model;
+    return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint get_n_columns(GtkTreeModel* tree_model) {
+    (void)tree_model;
+    return PLAYLIST_N_COLUMNS;
+}
+
+static GType get_column_type(GtkTreeModel* tree_model, gint column) {
+    (void)tree_model;
+    (void)column;
+    return G_TYPE_STRING;
+}
+
+// Point `iter` at row `index`; false if there is none
+static gboolean set_iter(PlaylistModel* model, gint index, GtkTreeIter* iter) {
+    if (index < 0 || index >= playlist_model_length(model)) {
+        iter->stamp = 0;
+        return FALSE;
+    }
+    fill_iter(model, index, iter);
+    return TRUE;
+}
+
+static gboolean get_iter(GtkTreeModel* tree_model, GtkTreeIter* iter, GtkTreePath* path) {
+    if (gtk_tree_path_get_depth(path) != 1) return FALSE;
+    return set_iter(PLAYLIST_MODEL(tree_model), gtk_tree_path_get_indices(path)[0], iter);
+}
+
+static GtkTreePath* get_path(GtkTreeModel* tree_model, GtkTreeIter* iter) {
+    (void)tree_model;
+    return gtk_tree_path_new_from_indices(playlist_model_iter_index(iter), -1);
+}
+
+static void get_value(GtkTreeModel* tree_model, GtkTreeIter* iter, gint column, GValue* value) {
+    PlaylistModel* model = PLAYLIST_MODEL(tree_model);
+    gint index = playlist_model_iter_index(iter);
+    g_value_init(value, G_TYPE_STRING);
+    if (column == PLAYLIST_COLUMN_TITLE) {
+        std::unordered_map<gint, std::string>::const_iterator title = model->titles->find(index);
+        if (title != model->titles->end()) {
+            g_value_set_string(value, title->second.c_str());
+            return;
+        }
+    }
+    const char* path = playlist_model_path(model, index);
+    if (column == PLAYLIST_COLUMN_TITLE && path) {
+        // The file name, until the tags are read
+        const char* slash = strrchr(path, '/');
+        if (slash) path = slash + 1;
+    }
+    // Copied: the path is put together in a buffer that the next row reuses
+    g_value_set_string(value, path);
+}
+
+static gboolean iter_next(GtkTreeModel* tree_model, GtkTreeIter* iter) {
+    return set_iter(PLAYLIST_MODEL(tree_model), playlist_model_iter_index(iter) + 1, iter);
+}
+
+static gboolean iter_children(GtkTreeModel* tree_model, GtkTreeIter* iter, GtkTreeIter* parent) {
+    if (parent) return FALSE;
+    return set_iter(PLAYLIST_MODEL(tree_model), 0, iter);
+}
+
+static gboolean iter_has_child(GtkTreeModel* tree_model, GtkTreeIter* iter) {
+    (void)tree_model;
+    (void)iter;
+    return FALSE;
+}
+
+static gint iter_n_children(GtkTreeModel* tree_model, GtkTreeIter* iter) {
+    return iter ? 0 : playlist_model_length(PLAYLIST_MODEL(tree_model));
+}
+
+static gboolean iter_nth_child(GtkTreeModel* tree_model, GtkTreeIter* iter, GtkTreeIter* parent, gint n) {
+    if (parent) return FALSE;
+    return set_iter(PLAYLIST_MODEL(tree_model), n, iter);
+}
+
+static gboolean iter_parent(GtkTreeModel* tree_model, GtkTreeIter* iter, GtkTreeIter* child) {
+    (void)tree_model;
+    (void)iter;
+    (void)child;
+    return FALSE;
+}
+
+static void playlist_model_tree_model_init(GtkTreeModelIface* iface) {
+    iface->get_flags = get_flags;
+    iface->get_n_columns = get_n_columns;
+    iface->get_column_type = get_column_type;
+    iface->get_iter = get_iter;
+    iface->get_path = get_path;
+    iface->get_value = get_value;
+    iface->iter_next = iter_next;
+    iface->iter_children = iter_children;
+    iface->iter_has_child = iter_has_child;
+    iface->iter_n_children = iter_n_children;
+    iface->iter_nth_child = iter_nth_child;
+    iface->iter_parent = iter_parent;
+}
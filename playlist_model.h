@@ -0,0 +1,64 @@
+#ifndef PLAYLIST_MODEL_H
+#define PLAYLIST_MODEL_H
+
+#include <gtk/gtk.h>
+
+#include "path_list.h"
+
+// --- PlaylistModel ---
+// GtkTreeModel for the playlist: a flat list with two string columns, the
+// file path and what to show for it: the title set for the row, or the
+// file name until there is one. A GtkListStore keeps a node, a GValue and a g_strdup'd copy
+// per row; here the paths are kept in a PathList, which stores each
+// directory once, so a row costs its file name plus eight bytes.
+//
+// Rows are addressed by index: iters carry it directly, so row lookup is
+// O(1). The view only asks for the rows it draws when it runs in fixed
+// height mode.
+//
+// Rows can only be appended or all cleared. Changes are announced with the
+// usual row-inserted/row-deleted signals, but only if a view listens: for
+// bulk loads, detach the model from the view first.
+
+enum {
+    PLAYLIST_COLUMN_PATH,
+    PLAYLIST_COLUMN_TITLE,
+    PLAYLIST_N_COLUMNS
+};
+
+typedef struct _PlaylistModel PlaylistModel;
+typedef struct _PlaylistModelClass PlaylistModelClass;
+
+#define TYPE_PLAYLIST_MODEL (playlist_model_get_type())
+#define PLAYLIST_MODEL(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), TYPE_PLAYLIST_MODEL, PlaylistModel))
+
+GType playlist_model_get_type(void);
+
+PlaylistModel* playlist_model_new(void);
+
+
+void playlist_model_append(PlaylistModel* model, const char* path);
+void playlist_model_clear(PlaylistModel* model);
+
+// Replace all rows with `paths` in one go; `paths` is left empty. The list
+// is taken over as it is, not copied row by row.
+void playlist_model_replace(PlaylistModel* model, PathList* paths);
+
+gint playlist_model_length(PlaylistModel* model);
+
+// Path of row `index`, NULL if out of range. Only valid until the next
+// call.
+const char* playlist_model_path(PlaylistModel* model, gint index);
+
+// PLAYLIST_COLUMN_TITLE of row `index`, e.g. "Artist - Title". Only rows
+// that have been looked at get one; they go when the rows are cleared.
+void playlist_model_set_title(PlaylistModel* model, gint index, const char* title);
+gboolean playlist_model_has_title(PlaylistModel* model, gint index);
+
+// Row of an iter from this model
+gint playlist_model_iter_index(const GtkTreeIter* iter);
+
+// First row holding `path`, or -1
+gint playlist_model_find(PlaylistModel* model, const char* path);
+
+#endif // PLAYLIST_MODEL_H
@@ -0,0 +1,74 @@
+#include "replay_gain.h"
+#include "tag_reader.h"
+#include <stdlib.h>
+#include <string.h>
+
+// R128 gains are relative to -23 LUFS, ReplayGain 2.0 to -18 LUFS.
+static const float R128_TO_REPLAYGAIN_DB = 5.0f;
+
+// Parse "-6.54 dB" / "+1.2" / "0.987654". Accepts a decimal comma, which
+// some taggers write on localized systems.
+static bool parse_number(const char* value, float* out) {
+    char buf[32];
+    size_t n = 0;
+    while (*value == ' ') ++value;
+    for (; *value && n < sizeof(buf) - 1; ++value) {
+        char c = *value;
+        if (c == ',') c = '.';
+        if ((c < '0' || c > '9') && c != '.' && c != '-' && c != '+') break;
+        buf[n++] = c;
+    }
+    buf[n] = '\0';
+    if (n == 0) return false;
+    char* end = NULL;
+    *out = strtof(buf, &end);
+    return end != buf;
+}
+
+static void on_tag(const char* key, const char* value, void* user_data) {
+    ReplayGainInfo* info = static_cast<ReplayGainInfo*>(user_data);
+    float v;
+
+    if (strncmp(key, "REPLAYGAIN_", 11) == 0) {
+        const char* k = key + 11;
+        if (!parse_number(value, &v)) return;
+        if (strcmp(k, "TRACK_GAIN") == 0) { info->track_gain = v; info->has_track = 1; }
+        else if (strcmp(k, "TRACK_PEAK") == 0) info->track_peak = v;
+        else if (strcmp(k, "ALBUM_GAIN") == 0) { info->album_gain = v; info->has_album = 1; }
+        else if (strcmp(k, "ALBUM_PEAK") == 0) info->album_peak = v;
+    } else if (strncmp(key, "R128_", 5) == 0) {
+        // Q7.8 fixed point, in dB. Only used if no ReplayGain tag is present.
+        if (!parse_number(value, &v)) return;
+        float db = v / 256.0f + R128_TO_REPLAYGAIN_DB;
+        if (strcmp(key + 5, "TRACK_GAIN") == 0 && !info->has_track) {
+            info->track_gain = db;
+            info->has_track = 1;
+        } else if (strcmp(key + 5, "ALBUM_GAIN") == 0 && !info->has_album) {
+            info->album_gain = db;
+            info->has_album = 1;
+        }
+    }
+}
+
+bool read_replaygain_tags(const char* filepath, ReplayGainInfo* info) {
+    memset(info, 0, sizeof(*info));
+    read_text_tags(filepath, on_tag, info);
+    return info->has_track || info->has_album;
+}
+
+bool replaygain_select(const ReplayGainInfo& info, ReplayGainMode mode, float* gain_db, float* peak) {
+    if (mode == REPLAYGAIN_OFF) return false;
+
+    bool use_album = (mode == REPLAYGAIN_ALBUM) ? info.has_album : !info.has_track;
+    if (use_album && info.has_album) {
+        *gain_db = info.album_gain;
+        *peak = info.album_peak;
+        return true;
+    }
+    if (info.has_track) {
+        *gain_db = info.track_gain;
+        *peak = info.track_peak;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,34 @@
+#ifndef REPLAY_GAIN_H
+#define REPLAY_GAIN_H
+
+#include <stdint.h>
+
+enum ReplayGainMode {
+    REPLAYGAIN_OFF,
+    REPLAYGAIN_TRACK,
+    REPLAYGAIN_ALBUM
+};
+
+// Per-file loudness information, stored as-is in the gain cache.
+// Gains are in dB relative to the ReplayGain 2.0 reference (-18 LUFS),
+// peaks are linear sample peaks (0 = unknown).
+struct ReplayGainInfo {
+    float track_gain;
+    float track_peak;
+    float album_gain;
+    float album_peak;
+    uint8_t has_track;
+    uint8_t has_album;
+    uint8_t scanned;        // track_gain/peak came from the loudness scanner
+    uint8_t reserved;
+};
+
+// Parse REPLAYGAIN_* (ID3v2 TXXX / Vorbis comments) and R128_*_GAIN tags.
+// Always fills `info`; returns true if any gain value was found.
+bool read_replaygain_tags(const char* filepath, ReplayGainInfo* info);
+
+// Pick the gain/peak for `mode`, falling back to the other kind of gain
+// when the preferred one is missing. Returns false if nothing applies.
+bool replaygain_select(const ReplayGainInfo& info, ReplayGainMode mode, float* gain_db, float* peak);
+
+#endif // REPLAY_GAIN_H
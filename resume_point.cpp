@@ -0,0 +1,67 @@
+#include "resume_point.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// File layout: "<frame>\n<filepath>\n"
+
+ResumePoint::ResumePoint() : frame(0) {
+}
+
+bool ResumePoint::load(const std::string& resume_path) {
+    path = resume_path;
+    filepath.clear();
+    frame = 0;
+
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+
+    char line[4096];
+    bool ok = false;
+    if (fgets(line, sizeof(line), f)) {
+        char* end;
+        unsigned long long value = strtoull(line, &end, 10);
+        if (end != line && fgets(line, sizeof(line), f)) {
+            line[strcspn(line, "\n")] = '\0';
+            if (line[0] != '\0') {
+                filepath = line;
+                frame = value;
+                ok = true;
+            }
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+bool ResumePoint::save(const std::string& new_filepath, uint64_t new_frame) {
+    if (path.empty()) return false;
+    if (new_filepath == filepath && new_frame == frame) return true;
+    filepath = new_filepath;
+    frame = new_frame;
+
+    std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "w");
+    if (!f) {
+        perror("ResumePoint: Failed to write checkpoint");
+        return false;
+    }
+    bool ok = fprintf(f, "%llu\n%s\n", (unsigned long long)frame, filepath.c_str()) > 0;
+    if (fclose(f) != 0) ok = false;
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        perror("ResumePoint: Failed to write checkpoint");
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+const std::string& ResumePoint::get_filepath() const {
+    return filepath;
+}
+
+uint64_t ResumePoint::get_frame(const char* other) const {
+    return filepath == other ? frame : 0;
+}
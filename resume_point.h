@@ -0,0 +1,38 @@
+#ifndef RESUME_POINT_H
+#define RESUME_POINT_H
+
+#include <stdint.h>
+#include <string>
+
+// --- ResumePoint Class ---
+// Where playback last was: a file and a frame offset into it (44.1 kHz
+// output frames, after gapless trimming). Kept in a two-line text file so
+// KinAMP and KinAMP-minimal pick up where the other one stopped, also
+// across reboots.
+//
+// Writes are skipped when nothing changed, and replace the file atomically
+// so a crash or power loss mid-write keeps the previous checkpoint.
+class ResumePoint {
+public:
+    ResumePoint();
+
+    // Read the checkpoint from `path` and remember it for save().
+    // A missing or malformed file just yields no checkpoint.
+    bool load(const std::string& path);
+
+    // Record a new position and write it out.
+    bool save(const std::string& filepath, uint64_t frame);
+
+    // Checkpointed file, empty if none
+    const std::string& get_filepath() const;
+
+    // Checkpointed frame for `filepath`, 0 if the checkpoint is for another file
+    uint64_t get_frame(const char* filepath) const;
+
+private:
+    std::string path;
+    std::string filepath;
+    uint64_t frame;
+};
+
+#endif // RESUME_POINT_H
@@ -0,0 +1,207 @@
+#include "silence_trim.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SILENCE_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SILENCE_USE_SSE 1
+#endif
+
+// Detection window: 10 ms at 44.1 kHz
+static const size_t WINDOW = 441;
+
+// A window is silent below -60 dBFS RMS and -40 dBFS peak
+static const float RMS_THRESHOLD = 0.001f;
+static const float PEAK_THRESHOLD = 0.01f;
+
+// Silence kept next to the audio so soft attacks and decays survive (50 ms)
+static const size_t PAD = 2205;
+
+// Longest silent run held back waiting for the end of the file (10 s);
+// longer runs are passed on and only trimmed on later plays, from the cache
+static const size_t MAX_HOLD = 441000;
+
+// Pause length kept in SILENCE_SPEECH mode (0.4 s)
+static const size_t SPEECH_GAP = 17640;
+
+void silence_measure(const float* s, size_t n, float* peak, float* sum_sq) {
+    size_t i = 0;
+    const size_t n4 = n & ~(size_t)3;
+    float p = 0.0f, e = 0.0f;
+#if SILENCE_USE_SSE
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vp = _mm_setzero_ps(), ve = _mm_setzero_ps();
+    for (; i < n4; i += 4) {
+        __m128 v = _mm_loadu_ps(s + i);
+        vp = _mm_max_ps(vp, _mm_andnot_ps(sign, v));
+        ve = _mm_add_ps(ve, _mm_mul_ps(v, v));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vp);
+    for (int k = 0; k < 4; ++k) if (lanes[k] > p) p = lanes[k];
+    _mm_storeu_ps(lanes, ve);
+    e = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif SILENCE_USE_NEON
+    float32x4_t vp = vdupq_n_f32(0.0f), ve = vdupq_n_f32(0.0f);
+    for (; i < n4; i += 4) {
+        float32x4_t v = vld1q_f32(s + i);
+        vp = vmaxq_f32(vp, vabsq_f32(v));
+        ve = vmlaq_f32(ve, v, v);
+    }
+    float32x2_t mp = vpmax_f32(vget_low_f32(vp), vget_high_f32(vp));
+    p = vget_lane_f32(vpmax_f32(mp, mp), 0);
+    float32x2_t fe = vadd_f32(vget_low_f32(ve), vget_high_f32(ve));
+    e = vget_lane_f32(vpadd_f32(fe, fe), 0);
+#endif
+    for (; i < n; ++i) {
+        float a = s[i] < 0.0f ? -s[i] : s[i];
+        if (a > p) p = a;
+        e += s[i] * s[i];
+    }
+    *peak = p;
+    *sum_sq = e;
+}
+
+static bool window_is_silent(const float* samples, size_t frames) {
+    float peak, sum_sq;
+    silence_measure(samples, frames * 2, &peak, &sum_sq);
+    return peak < PEAK_THRESHOLD && sum_sq < RMS_THRESHOLD * RMS_THRESHOLD * (frames * 2);
+}
+
+SilenceTrimmer::SilenceTrimmer()
+    : mode(SILENCE_OFF), state(AUDIO), frame(0), overflowed(false), run_start(0),
+      has_leading(false), leading_frame(0), has_trailing(false), trailing_frame(0)
+{
+}
+
+void SilenceTrimmer::start(SilenceMode m, uint64_t first_frame, bool leading_done) {
+    mode = m;
+    state = leading_done ? AUDIO : LEADING;
+    frame = first_frame;
+    window.clear();
+    hold.clear();
+    overflowed = false;
+    run_start = 0;
+    has_leading = false;
+    leading_frame = 0;
+    has_trailing = false;
+    trailing_frame = 0;
+}
+
+bool SilenceTrimmer::is_active() const {
+    return mode != SILENCE_OFF;
+}
+
+void SilenceTrimmer::push_window(const float* samples, size_t frames, std::vector<float>* out) {
+    bool silent = window_is_silent(samples, frames);
+    const float* end = samples + frames * 2;
+
+    switch (state) {
+        case LEADING:
+            if (silent) {
+                // Only the last PAD frames can still end up in the output
+                hold.insert(hold.end(), samples, end);
+                if (hold.size() > PAD * 2) hold.erase(hold.begin(), hold.end() - PAD * 2);
+            } else {
+                has_leading = true;
+                leading_frame = frame - hold.size() / 2;
+                out->insert(out->end(), hold.begin(), hold.end());
+                out->insert(out->end(), samples, end);
+                hold.clear();
+                state = AUDIO;
+            }
+            break;
+
+        case AUDIO:
+            if (silent) {
+                state = SILENT_RUN;
+                run_start = frame;
+                overflowed = false;
+                hold.assign(samples, end);
+            } else {
+                out->insert(out->end(), samples, end);
+            }
+            break;
+
+        case SILENT_RUN:
+            if (!silent) {
+                // Audio resumed: it was a pause, not the end
+                out->insert(out->end(), hold.begin(), hold.end());
+                out->insert(out->end(), samples, end);
+                hold.clear();
+                state = AUDIO;
+            } else if (mode == SILENCE_SPEECH) {
+                if (hold.size() < SPEECH_GAP * 2) hold.insert(hold.end(), samples, end);
+            } else if (overflowed) {
+                out->insert(out->end(), samples, end);
+            } else if (hold.size() / 2 + frames > MAX_HOLD) {
+                out->insert(out->end(), hold.begin(), hold.end());
+                out->insert(out->end(), samples, end);
+                hold.clear();
+                overflowed = true;
+            } else {
+                hold.insert(hold.end(), samples, end);
+            }
+            break;
+    }
+    frame += frames;
+}
+
+void SilenceTrimmer::process(const float* in, size_t frames, std::vector<float>* out) {
+    if (mode == SILENCE_OFF) {
+        out->insert(out->end(), in, in + frames * 2);
+        frame += frames;
+        return;
+    }
+
+    // Top up a partial window first
+    if (!window.empty()) {
+        size_t need = WINDOW - window.size() / 2;
+        size_t n = frames < need ? frames : need;
+        window.insert(window.end(), in, in + n * 2);
+        in += n * 2;
+        frames -= n;
+        if (window.size() / 2 < WINDOW) return;
+        push_window(window.data(), WINDOW, out);
+        window.clear();
+    }
+    while (frames >= WINDOW) {
+        push_window(in, WINDOW, out);
+        in += WINDOW * 2;
+        frames -= WINDOW;
+    }
+    window.assign(in, in + frames * 2);
+}
+
+void SilenceTrimmer::finish(std::vector<float>* out) {
+    if (mode == SILENCE_OFF) return;
+    if (!window.empty()) {
+        push_window(window.data(), window.size() / 2, out);
+        window.clear();
+    }
+
+    if (state == SILENT_RUN) {
+        // Keep a short decay, drop the rest
+        if (!overflowed) {
+            size_t keep = hold.size() < PAD * 2 ? hold.size() : PAD * 2;
+            out->insert(out->end(), hold.begin(), hold.begin() + keep);
+        }
+        trailing_frame = run_start + PAD < frame ? run_start + PAD : frame;
+        has_trailing = true;
+    } else if (state == AUDIO) {
+        trailing_frame = frame;
+        has_trailing = true;
+    }
+    hold.clear();
+}
+
+bool SilenceTrimmer::leading_result(uint64_t* f) const {
+    if (has_leading) *f = leading_frame;
+    return has_leading;
+}
+
+bool SilenceTrimmer::trailing_result(uint64_t* f) const {
+    if (has_trailing) *f = trailing_frame;
+    return has_trailing;
+}
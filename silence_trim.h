@@ -0,0 +1,78 @@
+#ifndef SILENCE_TRIM_H
+#define SILENCE_TRIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+enum SilenceMode {
+    SILENCE_OFF,
+    SILENCE_EDGES,      // Drop leading and trailing silence
+    SILENCE_SPEECH      // Also shorten long pauses (podcasts, audiobooks)
+};
+
+// Per-file detection results, stored as-is in the silence cache.
+// Frame numbers are at the decoder's output rate, counted after gapless
+// trimming; 0 = unknown.
+struct SilenceInfo {
+    uint32_t audio_start;   // First frame to play
+    uint32_t audio_end;     // Frame after the last one to play
+    uint8_t has_start;
+    uint8_t has_end;
+    uint8_t reserved[2];
+};
+
+// Peak magnitude and sum of squares of `samples` floats (NEON / SSE /
+// scalar).
+void silence_measure(const float* samples, size_t count, float* peak, float* sum_sq);
+
+// --- SilenceTrimmer Class ---
+// Streams interleaved stereo float PCM through in 10 ms windows and drops
+// the silent ones at the start and end of a track. A window is silent when
+// both its RMS and its peak are below fixed thresholds, so faint noise
+// floors count as silence but quiet music does not.
+//
+// Trailing silence can only be recognised at the end of the file, so a
+// silent run is held back (up to MAX_HOLD) until audio resumes or the file
+// ends. In SILENCE_SPEECH mode only the start of each pause is kept.
+class SilenceTrimmer {
+public:
+    SilenceTrimmer();
+
+    // Set up for a track whose next input frame is `first_frame`.
+    // `leading_done`: the leading silence was already skipped (cached).
+    void start(SilenceMode mode, uint64_t first_frame, bool leading_done);
+
+    bool is_active() const;
+
+    // Append what survives of `frames` input frames to `out`.
+    void process(const float* in, size_t frames, std::vector<float>* out);
+
+    // End of input: flush, dropping trailing silence.
+    void finish(std::vector<float>* out);
+
+    // Input frame where audio starts / trailing silence begins (including
+    // the short pad kept around the edges). False until known.
+    bool leading_result(uint64_t* frame) const;
+    bool trailing_result(uint64_t* frame) const;
+
+private:
+    enum State { LEADING, AUDIO, SILENT_RUN };
+
+    SilenceMode mode;
+    State state;
+    uint64_t frame;             // Input frame of the next window
+    std::vector<float> window;  // Partial window
+    std::vector<float> hold;    // Held back silence
+    bool overflowed;            // Run outgrew the hold and was passed on
+    uint64_t run_start;
+
+    bool has_leading;
+    uint64_t leading_frame;
+    bool has_trailing;
+    uint64_t trailing_frame;
+
+    void push_window(const float* samples, size_t frames, std::vector<float>* out);
+};
+
+#endif // SILENCE_TRIM_H
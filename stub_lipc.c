@@ -1,32 +1,236 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
 
 // Helper types from openlipc.h
 typedef void LIPC;
-typedef enum { LIPC_OK = 0 } LIPCcode;
+typedef enum {
+    LIPC_OK = 0,
+    LIPC_ERROR_NO_SUCH_PROPERTY = 8,
+    LIPC_ERROR_ACCESS_NOT_ALLOWED = 9,
+    LIPC_ERROR_BUFFER_TOO_SMALL = 10,
+    LIPC_ERROR_OUT_OF_MEMORY = 5
+} LIPCcode;
+typedef LIPCcode (*LipcPropCallback)(LIPC *lipc, const char *property, void *value, void *data);
+typedef void LIPCevent;
+typedef LIPCcode (*LipcEventCallback)(LIPC *lipc, const char *name, LIPCevent *event, void *data);
+
+// Properties registered by our own service. Get/Set calls addressed to
+// it are dispatched to them, so a service can be exercised in-process.
+#define STUB_MAX_PROPERTIES 32
+
+struct StubProperty {
+    char name[64];
+    int is_string;
+    LipcPropCallback getter;
+    LipcPropCallback setter;
+    void *data;
+};
+
+static struct StubProperty stub_properties[STUB_MAX_PROPERTIES];
+static int stub_property_count = 0;
+static char stub_service[128] = "";
+
+static struct StubProperty *stub_find(const char *service, const char *property) {
+    int i;
+    if (strcmp(service, stub_service) != 0) return NULL;
+    for (i = 0; i < stub_property_count; ++i) {
+        if (strcmp(stub_properties[i].name, property) == 0) return &stub_properties[i];
+    }
+    return NULL;
+}
+
+static LIPCcode stub_register(const char *property, int is_string, LipcPropCallback getter,
+                              LipcPropCallback setter, void *data) {
+    struct StubProperty *p;
+    if (stub_property_count == STUB_MAX_PROPERTIES) return LIPC_ERROR_OUT_OF_MEMORY;
+    p = &stub_properties[stub_property_count++];
+    snprintf(p->name, sizeof(p->name), "%s", property);
+    p->is_string = is_string;
+    p->getter = getter;
+    p->setter = setter;
+    p->data = data;
+    return LIPC_OK;
+}
 
 // Stub functions
 LIPC *LipcOpen(const char *service) {
-    (void)service;
+    snprintf(stub_service, sizeof(stub_service), "%s", service ? service : "");
+    return (LIPC*)malloc(1);
+}
+
+LIPC *LipcOpenNoName(void) {
     return (LIPC*)malloc(1);
 }
 
+LIPC *LipcOpenEx(const char *service, LIPCcode *code) {
+    if (code) *code = LIPC_OK;
+    return LipcOpen(service);
+}
+
 void LipcClose(LIPC *lipc) {
     if (lipc) free(lipc);
 }
 
+const char *LipcGetErrorString(LIPCcode code) {
+    (void)code;
+    return "stub error";
+}
+
 LIPCcode LipcGetIntProperty(LIPC *lipc, const char *service, const char *property, int *value) {
-    (void)lipc; (void)service; (void)property;
+    struct StubProperty *p = stub_find(service, property);
+    if (p) {
+        if (!p->getter) return LIPC_ERROR_ACCESS_NOT_ALLOWED;
+        return p->getter(lipc, property, value, p->data);
+    }
     if (value) *value = 0;
     return LIPC_OK;
 }
 
 LIPCcode LipcSetIntProperty(LIPC *lipc, const char *service, const char *property, int value) {
-    (void)lipc; (void)service; (void)property; (void)value;
+    struct StubProperty *p = stub_find(service, property);
+    if (p) {
+        if (!p->setter) return LIPC_ERROR_ACCESS_NOT_ALLOWED;
+        return p->setter(lipc, property, (void*)(long int)value, p->data);
+    }
     return LIPC_OK;
 }
 
+LIPCcode LipcGetStringProperty(LIPC *lipc, const char *service, const char *property, char **value) {
+    struct StubProperty *p = stub_find(service, property);
+    int size = 16;
+    LIPCcode code;
+    *value = NULL;
+    if (!p) return LIPC_ERROR_NO_SUCH_PROPERTY;
+    if (!p->getter) return LIPC_ERROR_ACCESS_NOT_ALLOWED;
+    // Same retry protocol as the real library: start small, grow on demand
+    for (;;) {
+        int requested = size;
+        *value = (char*)realloc(*value, size);
+        code = p->getter(lipc, property, *value, &requested);
+        if (code != LIPC_ERROR_BUFFER_TOO_SMALL) break;
+        size = requested;
+    }
+    return code;
+}
+
 LIPCcode LipcSetStringProperty(LIPC *lipc, const char *service, const char *property, const char *value) {
-    (void)lipc; (void)service; (void)property; (void)value;
+    struct StubProperty *p = stub_find(service, property);
+    if (p) {
+        if (!p->setter) return LIPC_ERROR_ACCESS_NOT_ALLOWED;
+        return p->setter(lipc, property, (void*)value, p->data);
+    }
+    return LIPC_OK;
+}
+
+void LipcFreeString(char *string) {
+    free(string);
+}
+
+LIPCcode LipcRegisterIntProperty(LIPC *lipc, const char *property, LipcPropCallback getter,
+                                 LipcPropCallback setter, void *data) {
+    (void)lipc;
+    return stub_register(property, 0, getter, setter, data);
+}
+
+LIPCcode LipcRegisterStringProperty(LIPC *lipc, const char *property, LipcPropCallback getter,
+                                    LipcPropCallback setter, void *data) {
+    (void)lipc;
+    return stub_register(property, 1, getter, setter, data);
+}
+
+LIPCcode LipcUnregisterProperty(LIPC *lipc, const char *property, void **data) {
+    struct StubProperty *p = stub_find(stub_service, property);
+    (void)lipc;
+    if (!p) return LIPC_ERROR_NO_SUCH_PROPERTY;
+    if (data) *data = p->data;
+    *p = stub_properties[--stub_property_count];
+    return LIPC_OK;
+}
+
+// Subscriptions; LipcStubSendEvent() plays the role of the sending service
+#define STUB_MAX_SUBSCRIPTIONS 16
+
+struct StubSubscription {
+    LIPC *lipc;
+    char service[128];
+    char name[64];
+    LipcEventCallback callback;
+    void *data;
+};
+
+struct StubEvent {
+    int value;
+};
+
+static struct StubSubscription stub_subscriptions[STUB_MAX_SUBSCRIPTIONS];
+static int stub_subscription_count = 0;
+
+LIPCcode LipcSubscribeExt(LIPC *lipc, const char *service, const char *name, LipcEventCallback callback, void *data) {
+    struct StubSubscription *sub;
+    if (stub_subscription_count == STUB_MAX_SUBSCRIPTIONS) return LIPC_ERROR_OUT_OF_MEMORY;
+    sub = &stub_subscriptions[stub_subscription_count++];
+    sub->lipc = lipc;
+    snprintf(sub->service, sizeof(sub->service), "%s", service);
+    snprintf(sub->name, sizeof(sub->name), "%s", name ? name : "");
+    sub->callback = callback;
+    sub->data = data;
+    return LIPC_OK;
+}
+
+LIPCcode LipcUnsubscribeExt(LIPC *lipc, const char *service, const char *name, void **data) {
+    int i;
+    for (i = 0; i < stub_subscription_count; ++i) {
+        struct StubSubscription *sub = &stub_subscriptions[i];
+        if (sub->lipc == lipc && strcmp(sub->service, service) == 0 && strcmp(sub->name, name ? name : "") == 0) {
+            if (data) *data = sub->data;
+            *sub = stub_subscriptions[--stub_subscription_count];
+            return LIPC_OK;
+        }
+    }
+    return LIPC_ERROR_NO_SUCH_PROPERTY;
+}
+
+LIPCcode LipcGetIntParam(LIPCevent *event, int *value) {
+    *value = ((struct StubEvent*)event)->value;
+    return LIPC_OK;
+}
+
+// Test hook: deliver `service`.`name` with one integer parameter to every
+// matching subscriber, on the calling thread
+void LipcStubSendEvent(const char *service, const char *name, int value) {
+    struct StubEvent event;
+    int i;
+    event.value = value;
+    for (i = 0; i < stub_subscription_count; ++i) {
+        struct StubSubscription *sub = &stub_subscriptions[i];
+        if (strcmp(sub->service, service) == 0 && (sub->name[0] == '\0' || strcmp(sub->name, name) == 0)) {
+            sub->callback(sub->lipc, name, &event, sub->data);
+        }
+    }
+}
+
+// Events are printed instead of sent
+LIPCcode LipcCreateAndSendEvent(LIPC *lipc, const char *name) {
+    (void)lipc;
+    printf("LIPC event %s.%s\n", stub_service, name);
+    return LIPC_OK;
+}
+
+LIPCcode LipcCreateAndSendEventWithParameters(LIPC *lipc, const char *name, const char *format, ...) {
+    va_list ap;
+    const char *f;
+    (void)lipc;
+    printf("LIPC event %s.%s", stub_service, name);
+    va_start(ap, format);
+    for (f = format; *f; ++f) {
+        if (*f != '%') continue;
+        ++f;
+        if (*f == 'd') printf(" %d", va_arg(ap, int));
+        else if (*f == 's') printf(" \"%s\"", va_arg(ap, const char*));
+    }
+    va_end(ap);
+    printf("\n");
     return LIPC_OK;
 }
@@ -0,0 +1,566 @@
+#include "tag_reader.h"
+#include "mpeg_frame.h"
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Frames larger than this are never text we care about (cover art, lyrics
+// with embedded images...) and are skipped without reading.
+static const uint32_t MAX_TEXT_FRAME = 64 * 1024;
+
+// Tags with whole-tag unsynchronisation are read into memory at once; any
+// larger than this are skipped
+static const uint32_t MAX_UNSYNC_TAG = 4 * 1024 * 1024;
+
+// =================================================================================
+// Helpers
+// =================================================================================
+
+static void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xc0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += (char)(0xe0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else {
+        out += (char)(0xf0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3f));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+}
+
+// Decode one NUL-terminated ID3v2 string starting at `p` into UTF-8.
+// Returns a pointer just past the terminator (or `end`).
+static const unsigned char* decode_id3_string(const unsigned char* p, const unsigned char* end,
+                                              int encoding, std::string& out) {
+    out.clear();
+    if (encoding == 1 || encoding == 2) {
+        // UTF-16 with BOM (1) or big-endian without BOM (2)
+        bool big_endian = (encoding == 2);
+        if (encoding == 1 && p + 1 < end) {
+            if (p[0] == 0xff && p[1] == 0xfe) { big_endian = false; p += 2; }
+            else if (p[0] == 0xfe && p[1] == 0xff) { big_endian = true; p += 2; }
+        }
+        while (p + 1 < end) {
+            uint32_t u = big_endian ? ((p[0] << 8) | p[1]) : ((p[1] << 8) | p[0]);
+            p += 2;
+            if (u == 0) return p;
+            if (u >= 0xd800 && u < 0xdc00 && p + 1 < end) {
+                uint32_t lo = big_endian ? ((p[0] << 8) | p[1]) : ((p[1] << 8) | p[0]);
+                if (lo >= 0xdc00 && lo < 0xe000) {
+                    p += 2;
+                    u = 0x10000 + ((u - 0xd800) << 10) + (lo - 0xdc00);
+                }
+            }
+            append_utf8(out, u);
+        }
+        return end;
+    }
+
+    while (p < end) {
+        unsigned char c = *p++;
+        if (c == 0) return p;
+        if (encoding == 3 || c < 0x80) out += (char)c; // UTF-8 or ASCII
+        else append_utf8(out, c);                      // ISO-8859-1
+    }
+    return end;
+}
+
+static void upper_ascii(std::string& s) {
+    for (size_t i = 0; i < s.size(); ++i) {
+        s[i] = (char)toupper((unsigned char)s[i]);
+    }
+}
+
+// Remove ID3v2 unsynchronisation (0xFF 0x00 -> 0xFF) in place.
+static size_t remove_unsync(unsigned char* data, size_t len) {
+    size_t o = 0;
+    for (size_t i = 0; i < len; ++i) {
+        data[o++] = data[i];
+        if (data[i] == 0xff && i + 1 < len && data[i + 1] == 0x00) ++i;
+    }
+    return o;
+}
+
+// Bytes read from the start of the file in one go; the text frames of a
+// typical ID3v2 tag, a FLAC header or a WAV header fit in it
+static const size_t HEAD_BYTES = 16 * 1024;
+
+// The start of a file, with reads elsewhere going to the file
+struct HeadReader {
+    int fd;
+    int64_t file_size;
+    unsigned char head[HEAD_BYTES];
+    size_t head_len;
+
+    // Copy `len` bytes at `pos` to `out`; false past the end of the file
+    bool read(int64_t pos, void* out, size_t len) {
+        if (pos < 0) return false;
+        if (pos + (int64_t)len <= (int64_t)head_len) {
+            memcpy(out, head + pos, len);
+            return true;
+        }
+        return pread(fd, out, len, pos) == (ssize_t)len;
+    }
+};
+
+// Open `filepath` and read its head
+static bool open_head(const char* filepath, HeadReader* reader) {
+    reader->fd = open(filepath, O_RDONLY);
+    if (reader->fd < 0) return false;
+    struct stat st;
+    reader->file_size = fstat(reader->fd, &st) == 0 ? (int64_t)st.st_size : 0;
+    ssize_t got = pread(reader->fd, reader->head, HEAD_BYTES, 0);
+    reader->head_len = got > 0 ? (size_t)got : 0;
+    return true;
+}
+
+// =================================================================================
+// ID3v2
+// =================================================================================
+
+static void handle_id3_frame(const char* id, const unsigned char* data, size_t len,
+                             TagCallback callback, void* user_data) {
+    if (len < 2) return;
+    int encoding = data[0];
+    const unsigned char* end = data + len;
+
+    if (strcmp(id, "TXXX") == 0 || strcmp(id, "TXX") == 0) {
+        // <encoding> <description> \0 <value>
+        std::string key, value;
+        const unsigned char* p = decode_id3_string(data + 1, end, encoding, key);
+        decode_id3_string(p, end, encoding, value);
+        upper_ascii(key);
+        if (!key.empty()) callback(key.c_str(), value.c_str(), user_data);
+    } else if ((strcmp(id, "COMM") == 0 || strcmp(id, "COM") == 0) && len > 4) {
+        // <encoding> <language[3]> <description> \0 <text>
+        // iTunes keeps its private values (iTunSMPB...) here, keyed by the
+        // description. Plain comments have no description and are ignored.
+        std::string key, value;
+        const unsigned char* p = decode_id3_string(data + 4, end, encoding, key);
+        decode_id3_string(p, end, encoding, value);
+        upper_ascii(key);
+        if (!key.empty()) callback(key.c_str(), value.c_str(), user_data);
+    }
+}
+
+// Picks the frames walk_id3v2() hands out, by id
+typedef bool (*Id3FrameFilter)(const char* id);
+
+// Gets a wanted frame's data, with unsynchronisation and the v2.4 data
+// length indicator already removed
+typedef void (*Id3FrameFunc)(const char* id, const unsigned char* data, size_t len, void* user_data);
+
+// Walk the frames of the ID3v2 tag at the start of the file and pass the
+// wanted ones to `frame_func`. Returns the offset of the first byte after
+// the tag (0 if there is none).
+static int64_t walk_id3v2(HeadReader& reader, Id3FrameFilter wanted, Id3FrameFunc frame_func, void* user_data) {
+    if (reader.head_len < 10 || memcmp(reader.head, "ID3", 3) != 0) return 0;
+    int version = reader.head[3];
+    int flags = reader.head[5];
+    uint32_t tag_size = syncsafe32(reader.head + 6);
+    int64_t tag_end = 10 + (int64_t)tag_size + ((flags & 0x10) ? 10 : 0); // v2.4 footer
+    if (version < 2 || version > 4) return tag_end;
+
+    // The header may claim up to 256 MB; nothing past the end of the file
+    // is read or allocated for
+    if ((int64_t)tag_size > reader.file_size - 10) {
+        tag_size = reader.file_size > 10 ? (uint32_t)(reader.file_size - 10) : 0;
+    }
+
+    // v2.2/2.3 apply unsynchronisation to the whole tag; read it in one go.
+    // This is rare in practice, so the simple path is fine.
+    bool unsync = (flags & 0x80) && version < 4;
+    std::vector<unsigned char> whole;
+    if (unsync) {
+        if (tag_size > MAX_UNSYNC_TAG) return tag_end;
+        whole.resize(tag_size);
+        if (!reader.read(10, whole.data(), tag_size)) return tag_end;
+        whole.resize(remove_unsync(whole.data(), tag_size));
+    }
+    int64_t limit = unsync ? (int64_t)whole.size() : 10 + (int64_t)tag_size;
+    int64_t pos = unsync ? 0 : 10;
+
+    // Skip the extended header
+    if (flags & 0x40) {
+        unsigned char ext[4];
+        if (unsync) {
+            if (whole.size() < 4) return tag_end;
+            memcpy(ext, whole.data(), 4);
+        } else if (!reader.read(pos, ext, 4)) {
+            return tag_end;
+        }
+        pos += (version == 4) ? syncsafe32(ext) : be32(ext) + 4;
+    }
+
+    const size_t hdr_len = (version == 2) ? 6 : 10;
+    std::vector<unsigned char> frame;
+    while (pos + (int64_t)hdr_len <= limit) {
+        unsigned char fh[10];
+        if (unsync) {
+            memcpy(fh, whole.data() + pos, hdr_len);
+        } else if (!reader.read(pos, fh, hdr_len)) {
+            break;
+        }
+        pos += hdr_len;
+        if (fh[0] == 0) break; // Padding
+
+        char id[5] = {0};
+        uint32_t size;
+        int frame_flags = 0;
+        if (version == 2) {
+            memcpy(id, fh, 3);
+            size = ((uint32_t)fh[3] << 16) | ((uint32_t)fh[4] << 8) | fh[5];
+        } else {
+            memcpy(id, fh, 4);
+            size = (version == 4) ? syncsafe32(fh + 4) : be32(fh + 4);
+            frame_flags = (fh[8] << 8) | fh[9];
+        }
+
+        bool take = wanted(id) && size > 0 && size <= MAX_TEXT_FRAME && pos + size <= limit;
+        // Compressed or encrypted frames are not worth supporting here
+        if (version == 3 && (frame_flags & 0x00c0)) take = false;
+        if (version == 4 && (frame_flags & 0x000c)) take = false;
+        if (take) {
+            frame.resize(size);
+            if (unsync) {
+                memcpy(frame.data(), whole.data() + pos, size);
+            } else if (!reader.read(pos, frame.data(), size)) {
+                break;
+            }
+            size_t len = size;
+            const unsigned char* data = frame.data();
+            if (version == 4) {
+                if (frame_flags & 0x0002) len = remove_unsync(frame.data(), len);
+                if (frame_flags & 0x0001) { data += 4; len = (len >= 4) ? len - 4 : 0; } // Data length indicator
+            }
+            frame_func(id, data, len, user_data);
+        }
+        pos += size;
+    }
+    return tag_end;
+}
+
+static bool is_text_tag_frame(const char* id) {
+    return strcmp(id, "TXXX") == 0 || strcmp(id, "TXX") == 0 || strcmp(id, "COMM") == 0 || strcmp(id, "COM") == 0;
+}
+
+struct TextTagSink {
+    TagCallback callback;
+    void* user_data;
+};
+
+static void text_tag_frame(const char* id, const unsigned char* data, size_t len, void* user_data) {
+    TextTagSink* sink = static_cast<TextTagSink*>(user_data);
+    handle_id3_frame(id, data, len, sink->callback, sink->user_data);
+}
+
+// =================================================================================
+// FLAC Vorbis comments
+// =================================================================================
+
+// Gets one "KEY=value" comment; neither is NUL-terminated
+typedef void (*VorbisCommentFunc)(const char* key, size_t key_len, const char* value, size_t value_len,
+                                  void* user_data);
+
+// Walk the comments of a VORBIS_COMMENT block. Every length is checked
+// against what is left of the block; a block that runs short ends the walk.
+static void walk_vorbis_comments(const unsigned char* p, size_t len, VorbisCommentFunc comment_func,
+                                 void* user_data) {
+    const unsigned char* end = p + len;
+    if (end - p < 4) return;
+    uint32_t vendor_len = le32(p);
+    p += 4;
+    // vendor_len + 4 can wrap: compare against what is left instead
+    if (end - p < 4 || vendor_len > (uint32_t)(end - p) - 4) return;
+    p += vendor_len;
+    uint32_t count = le32(p);
+    p += 4;
+
+    for (uint32_t i = 0; i < count && end - p >= 4; ++i) {
+        uint32_t clen = le32(p);
+        p += 4;
+        if ((uint32_t)(end - p) < clen) return;
+        const char* field = (const char*)p;
+        const char* eq = (const char*)memchr(p, '=', clen);
+        p += clen;
+        if (eq) comment_func(field, eq - field, eq + 1, (const char*)p - (eq + 1), user_data);
+    }
+}
+
+static void text_tag_comment(const char* key, size_t key_len, const char* value, size_t value_len,
+                             void* user_data) {
+    TextTagSink* sink = static_cast<TextTagSink*>(user_data);
+    std::string upper_key(key, key_len);
+    upper_ascii(upper_key);
+    std::string text(value, value_len);
+    sink->callback(upper_key.c_str(), text.c_str(), sink->user_data);
+}
+
+static void read_flac_comments(HeadReader& reader, int64_t pos, TagCallback callback, void* user_data) {
+    unsigned char magic[4];
+    if (!reader.read(pos, magic, 4) || memcmp(magic, "fLaC", 4) != 0) return;
+    pos += 4;
+
+    std::vector<unsigned char> block;
+    bool last = false;
+    while (!last) {
+        unsigned char bh[4];
+        if (!reader.read(pos, bh, 4)) return;
+        last = (bh[0] & 0x80) != 0;
+        int type = bh[0] & 0x7f;
+        uint32_t len = ((uint32_t)bh[1] << 16) | ((uint32_t)bh[2] << 8) | bh[3];
+        pos += 4;
+
+        if (type != 4 || len > MAX_TEXT_FRAME * 4) {
+            pos += len;
+            continue;
+        }
+
+        block.resize(len);
+        if (!reader.read(pos, block.data(), len)) return;
+        TextTagSink sink = { callback, user_data };
+        walk_vorbis_comments(block.data(), len, text_tag_comment, &sink);
+        return; // Only one comment block is allowed
+    }
+}
+
+// =================================================================================
+// Track Info
+// =================================================================================
+
+// How far past the ID3v2 tag to look for the first MPEG frame
+static const size_t FRAME_SEARCH_BYTES = 4096;
+
+static void set_if_empty(std::string& field, const std::string& value) {
+    if (field.empty()) field = value;
+}
+
+// "3/12" -> 3
+static void set_number_if_unknown(int& field, const char* value) {
+    if (field == 0) field = atoi(value);
+}
+
+// ID3v1 and WAV INFO text: ISO-8859-1, padded with NULs or spaces
+static std::string latin1_field(const unsigned char* p, size_t len) {
+    while (len > 0 && (p[len - 1] == 0 || p[len - 1] == ' ')) --len;
+    std::string out;
+    for (size_t i = 0; i < len && p[i] != 0; ++i) append_utf8(out, p[i]);
+    return out;
+}
+
+static void handle_info_frame(const char* id, const unsigned char* data, size_t len, TrackInfo* info,
+                              std::string& album_artist) {
+    if (len < 2) return;
+    std::string value;
+    decode_id3_string(data + 1, data + len, data[0], value);
+    if (value.empty()) return;
+
+    // v2.3/2.4 ids, then v2.2
+    if (strcmp(id, "TIT2") == 0 || strcmp(id, "TT2") == 0) set_if_empty(info->title, value);
+    else if (strcmp(id, "TPE1") == 0 || strcmp(id, "TP1") == 0) set_if_empty(info->artist, value);
+    else if (strcmp(id, "TPE2") == 0 || strcmp(id, "TP2") == 0) set_if_empty(album_artist, value);
+    else if (strcmp(id, "TALB") == 0 || strcmp(id, "TAL") == 0) set_if_empty(info->album, value);
+    else if (strcmp(id, "TRCK") == 0 || strcmp(id, "TRK") == 0) set_number_if_unknown(info->track, value.c_str());
+    else if (strcmp(id, "TPOS") == 0 || strcmp(id, "TPA") == 0) set_number_if_unknown(info->disc, value.c_str());
+    else if ((strcmp(id, "TLEN") == 0 || strcmp(id, "TLE") == 0) && info->duration_ms == 0) {
+        info->duration_ms = (unsigned)strtoul(value.c_str(), NULL, 10);
+    }
+}
+
+static bool is_info_frame(const char* id) {
+    static const char* const IDS[] = { "TIT2", "TPE1", "TPE2", "TALB", "TRCK", "TPOS", "TLEN",
+                                       "TT2", "TP1", "TP2", "TAL", "TRK", "TPA", "TLE" };
+    for (size_t i = 0; i < sizeof(IDS) / sizeof(IDS[0]); ++i) {
+        if (strcmp(id, IDS[i]) == 0) return true;
+    }
+    return false;
+}
+
+struct InfoSink {
+    TrackInfo* info;
+    std::string* album_artist;
+};
+
+static void info_frame(const char* id, const unsigned char* data, size_t len, void* user_data) {
+    InfoSink* sink = static_cast<InfoSink*>(user_data);
+    handle_info_frame(id, data, len, sink->info, *sink->album_artist);
+}
+
+// Fills in what ID3v2 did not have. Returns true if the file has a tag.
+static bool read_id3v1_info(HeadReader& reader, TrackInfo* info) {
+    unsigned char tag[128];
+    if (reader.file_size < 128 || !reader.read(reader.file_size - 128, tag, 128)) return false;
+    if (memcmp(tag, "TAG", 3) != 0) return false;
+    set_if_empty(info->title, latin1_field(tag + 3, 30));
+    set_if_empty(info->artist, latin1_field(tag + 33, 30));
+    set_if_empty(info->album, latin1_field(tag + 63, 30));
+    // ID3v1.1: track number in the last byte of the comment
+    if (info->track == 0 && tag[125] == 0 && tag[126] != 0) info->track = tag[126];
+    return true;
+}
+
+static void info_comment(const char* key, size_t key_len, const char* value, size_t value_len, void* user_data) {
+    InfoSink* sink = static_cast<InfoSink*>(user_data);
+    TrackInfo* info = sink->info;
+    std::string text(value, value_len);
+    if (key_len == 5 && strncasecmp(key, "TITLE", 5) == 0) set_if_empty(info->title, text);
+    else if (key_len == 6 && strncasecmp(key, "ARTIST", 6) == 0) set_if_empty(info->artist, text);
+    else if (key_len == 11 && strncasecmp(key, "ALBUMARTIST", 11) == 0) set_if_empty(*sink->album_artist, text);
+    else if (key_len == 5 && strncasecmp(key, "ALBUM", 5) == 0) set_if_empty(info->album, text);
+    else if (key_len == 11 && strncasecmp(key, "TRACKNUMBER", 11) == 0) set_number_if_unknown(info->track, text.c_str());
+    else if (key_len == 10 && strncasecmp(key, "DISCNUMBER", 10) == 0) set_number_if_unknown(info->disc, text.c_str());
+}
+
+static void read_flac_info(HeadReader& reader, int64_t pos, TrackInfo* info, std::string& album_artist) {
+    InfoSink sink = { info, &album_artist };
+    bool last = false;
+    std::vector<unsigned char> block;
+    pos += 4; // fLaC
+    while (!last) {
+        unsigned char bh[4];
+        if (!reader.read(pos, bh, 4)) return;
+        last = (bh[0] & 0x80) != 0;
+        int type = bh[0] & 0x7f;
+        uint32_t len = ((uint32_t)bh[1] << 16) | ((uint32_t)bh[2] << 8) | bh[3];
+        pos += 4;
+
+        if (type == 0 && len >= 18) {
+            // STREAMINFO: 20 bit sample rate, ..., 36 bit total samples
+            unsigned char si[18];
+            if (!reader.read(pos, si, 18)) return;
+            uint32_t rate = ((uint32_t)si[10] << 12) | ((uint32_t)si[11] << 4) | (si[12] >> 4);
+            uint64_t samples = ((uint64_t)(si[13] & 0x0f) << 32) | be32(si + 14);
+            if (rate > 0) info->duration_ms = (unsigned)(samples * 1000 / rate);
+        } else if (type == 4 && len <= MAX_TEXT_FRAME * 4) {
+            block.resize(len);
+            if (!reader.read(pos, block.data(), len)) return;
+            walk_vorbis_comments(block.data(), len, info_comment, &sink);
+        }
+        pos += len;
+    }
+}
+
+static void read_wav_info(HeadReader& reader, TrackInfo* info) {
+    uint32_t byte_rate = 0;
+    uint64_t data_size = 0;
+    std::vector<unsigned char> list;
+    int64_t pos = 12; // RIFF <size> WAVE
+    unsigned char ch[8];
+    while (reader.read(pos, ch, 8)) {
+        uint32_t len = le32(ch + 4);
+        pos += 8;
+        if (memcmp(ch, "fmt ", 4) == 0 && len >= 12) {
+            unsigned char fmt[12];
+            if (reader.read(pos, fmt, 12)) byte_rate = le32(fmt + 8);
+        } else if (memcmp(ch, "data", 4) == 0) {
+            data_size = len;
+        } else if (memcmp(ch, "LIST", 4) == 0 && len >= 4 && len <= MAX_TEXT_FRAME) {
+            list.resize(len);
+            if (reader.read(pos, list.data(), len) && memcmp(list.data(), "INFO", 4) == 0) {
+                for (size_t off = 4; off + 8 <= len;) {
+                    const unsigned char* sub = list.data() + off;
+                    uint32_t sub_len = le32(sub + 4);
+                    if (sub_len > len - off - 8) break;
+                    std::string value = latin1_field(sub + 8, sub_len);
+                    if (memcmp(sub, "INAM", 4) == 0) set_if_empty(info->title, value);
+                    else if (memcmp(sub, "IART", 4) == 0) set_if_empty(info->artist, value);
+                    else if (memcmp(sub, "IPRD", 4) == 0) set_if_empty(info->album, value);
+                    else if (memcmp(sub, "ITRK", 4) == 0) set_number_if_unknown(info->track, value.c_str());
+                    off += 8 + sub_len + (sub_len & 1);
+                }
+            }
+        }
+        pos += len + (len & 1);
+    }
+    if (byte_rate > 0 && data_size > 0) info->duration_ms = (unsigned)(data_size * 1000 / byte_rate);
+}
+
+// Duration from the first MPEG audio frame after `audio_start`
+static void read_mp3_duration(HeadReader& reader, int64_t audio_start, int64_t audio_end, TrackInfo* info) {
+    unsigned char buf[FRAME_SEARCH_BYTES];
+    size_t len = (size_t)std::min<int64_t>(sizeof(buf), audio_end - audio_start);
+    if (audio_start >= audio_end || !reader.read(audio_start, buf, len)) return;
+
+    MpegHeader header;
+    size_t frame = find_mpeg_frame(buf, len, &header);
+    if (frame == len) return;
+
+    // VBR files say how many frames they have
+    uint32_t frames = 0;
+    XingHeader xing;
+    if (parse_xing_header(buf, len, frame, header, &xing)) frames = xing.frame_count;
+    size_t vbri = frame + 4 + 32;
+    if (frames == 0 && vbri + 18 <= len && memcmp(buf + vbri, "VBRI", 4) == 0) {
+        frames = be32(buf + vbri + 14);
+    }
+    if (frames > 0) {
+        info->duration_ms = (unsigned)((uint64_t)frames * header.frame_samples * 1000 / header.sample_rate);
+    } else {
+        // CBR: bits / (kbit/s) = ms
+        info->duration_ms = (unsigned)((uint64_t)(audio_end - audio_start - frame) * 8 / header.kbps);
+    }
+}
+
+// =================================================================================
+// Public API
+// =================================================================================
+
+bool read_text_tags(const char* filepath, TagCallback callback, void* user_data) {
+    HeadReader reader;
+    if (!open_head(filepath, &reader)) return false;
+
+    TextTagSink sink = { callback, user_data };
+    int64_t audio_start = walk_id3v2(reader, is_text_tag_frame, text_tag_frame, &sink);
+    read_flac_comments(reader, audio_start, callback, user_data);
+
+    close(reader.fd);
+    return true;
+}
+
+bool read_track_info(const char* filepath, TrackInfo* info) {
+    info->title.clear();
+    info->artist.clear();
+    info->album.clear();
+    info->track = 0;
+    info->disc = 0;
+    info->duration_ms = 0;
+
+    HeadReader reader;
+    if (!open_head(filepath, &reader)) return false;
+
+    std::string album_artist;
+    unsigned char magic[4];
+    if (reader.head_len >= 12 && memcmp(reader.head, "RIFF", 4) == 0 && memcmp(reader.head + 8, "WAVE", 4) == 0) {
+        read_wav_info(reader, info);
+    } else {
+        InfoSink sink = { info, &album_artist };
+        int64_t audio_start = walk_id3v2(reader, is_info_frame, info_frame, &sink);
+        if (reader.read(audio_start, magic, 4) && memcmp(magic, "fLaC", 4) == 0) {
+            read_flac_info(reader, audio_start, info, album_artist);
+        } else {
+            int64_t audio_end = reader.file_size;
+            bool need_tags = info->title.empty() || info->artist.empty() || info->album.empty();
+            if ((need_tags || info->duration_ms == 0) && read_id3v1_info(reader, info)) audio_end -= 128;
+            if (info->duration_ms == 0) read_mp3_duration(reader, audio_start, audio_end, info);
+        }
+    }
+    set_if_empty(info->artist, album_artist);
+
+    close(reader.fd);
+    return true;
+}
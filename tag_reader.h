@@ -0,0 +1,37 @@
+#ifndef TAG_READER_H
+#define TAG_READER_H
+
+#include <string>
+
+// Called once per text tag found. `key` is upper-case ASCII (the TXXX/COMM
+// description for ID3v2 user frames, the field name for Vorbis comments),
+// `value` is UTF-8. Both are only valid for the duration of the call.
+typedef void (*TagCallback)(const char* key, const char* value, void* user_data);
+
+// Read the text tags of an audio file without decoding any audio.
+// Understands ID3v2.2/2.3/2.4 (at the start of MP3/FLAC files) and FLAC
+// Vorbis comment blocks. Large binary frames (cover art) are skipped, not
+// read, so only the tag headers and text frames cost any I/O.
+// Returns false if the file could not be opened.
+bool read_text_tags(const char* filepath, TagCallback callback, void* user_data);
+
+// What the playlist shows of a song. Strings are UTF-8, empty if unknown.
+struct TrackInfo {
+    std::string title;
+    std::string artist;         // Falls back to the album artist
+    std::string album;
+    int track;                  // 0 = unknown
+    int disc;
+    unsigned duration_ms;       // 0 = unknown
+};
+
+// Read the TrackInfo of an MP3, FLAC or WAV file from its headers alone:
+// ID3v2 frames (ID3v1 at the end of the file fills in what is missing),
+// FLAC STREAMINFO and Vorbis comments, WAV fmt/data chunks and LIST INFO
+// tags. MP3 durations come from TLEN, else the Xing/VBRI frame count, else
+// the bit rate of the first frame (CBR). Usually a single 16 KB read, plus
+// one for ID3v1; big frames such as cover art are skipped, not read.
+// Returns false if the file could not be opened.
+bool read_track_info(const char* filepath, TrackInfo* info);
+
+#endif // TAG_READER_H
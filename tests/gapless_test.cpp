@@ -0,0 +1,229 @@
+// Gapless playback check: one continuous sine is split into an "album" of
+// tracks of uneven length, each stored as an MP3 with encoder delay and
+// padding around it. Every track goes through read_gapless_info() and a
+// GaplessTrimmer like Decoder::decode_loop() does, and the joined output
+// must be the original sine again: same length, and no jump at any seam.
+//
+// There is no MP3 encoder in the build, so the files only carry the real
+// headers (Info frame with LAME extension, or an iTunSMPB comment). What
+// the decoder makes of them is generated here, sample for sample: the
+// silent Info frame, the 529 sample decoder delay, the encoder delay, the
+// audio and the padding.
+//
+// Usage: gapless_test [directory for the generated files]
+#include "gapless_info.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+static const unsigned SAMPLE_RATE = 44100;
+static const unsigned FRAME_SAMPLES = 1152;     // MPEG-1 Layer III
+static const unsigned DECODER_DELAY = 529;
+static const unsigned ENCODER_DELAY = 576;      // What LAME writes
+static const double FREQUENCY = 441.7;          // No whole periods per track
+static const double AMPLITUDE = 0.5;
+
+// Track lengths in frames, cut anywhere in the sine's period
+static const unsigned TRACK_FRAMES[] = { 200000, 123457, 99999, 300001, 44100, 1, 77777 };
+static const int TRACK_COUNT = sizeof(TRACK_FRAMES) / sizeof(TRACK_FRAMES[0]);
+
+// Decoder block sizes, cycled, so seams fall anywhere within a block
+static const size_t BLOCK_FRAMES[] = { 4096, 1152, 37, 2048, 1 };
+static const int BLOCK_SIZES = sizeof(BLOCK_FRAMES) / sizeof(BLOCK_FRAMES[0]);
+
+enum HeaderKind {
+    HEADER_LAME,        // Info frame with LAME extension
+    HEADER_ITUNSMPB,    // Info frame without it, iTunSMPB comment
+    HEADER_DECODER      // LAME header, but the decoder trims by itself
+};
+
+static const char* HEADER_NAMES[] = { "LAME header", "iTunSMPB tag", "decoder trims" };
+
+static double sine(uint64_t frame) {
+    return AMPLITUDE * sin(2.0 * M_PI * FREQUENCY * (double)frame / SAMPLE_RATE);
+}
+
+static void append_be32(std::vector<unsigned char>* data, uint32_t value) {
+    data->push_back((unsigned char)(value >> 24));
+    data->push_back((unsigned char)(value >> 16));
+    data->push_back((unsigned char)(value >> 8));
+    data->push_back((unsigned char)value);
+}
+
+// ID3v2.3 tag with an iTunSMPB comment, as iTunes writes it
+static void append_itunsmpb(std::vector<unsigned char>* data, unsigned delay, unsigned padding, uint64_t length) {
+    char value[64];
+    snprintf(value, sizeof(value), " 00000000 %08X %08X %016llX", delay, padding, (unsigned long long)length);
+
+    std::vector<unsigned char> body;
+    body.push_back(0);                                      // ISO-8859-1
+    body.insert(body.end(), { 'e', 'n', 'g' });
+    const char* description = "iTunSMPB";
+    body.insert(body.end(), description, description + strlen(description) + 1);
+    body.insert(body.end(), value, value + strlen(value));
+
+    std::vector<unsigned char> frame = { 'C', 'O', 'M', 'M' };
+    append_be32(&frame, (uint32_t)body.size());
+    frame.push_back(0);
+    frame.push_back(0);
+    frame.insert(frame.end(), body.begin(), body.end());
+
+    uint32_t size = (uint32_t)frame.size();
+    unsigned char header[10] = { 'I', 'D', '3', 3, 0, 0, (unsigned char)((size >> 21) & 0x7f),
+                                 (unsigned char)((size >> 14) & 0x7f), (unsigned char)((size >> 7) & 0x7f),
+                                 (unsigned char)(size & 0x7f) };
+    data->insert(data->end(), header, header + 10);
+    data->insert(data->end(), frame.begin(), frame.end());
+}
+
+// An MP3 holding `mpeg_frames` frames of audio after its Info frame. Only
+// the headers matter; the frames themselves are left empty.
+static bool write_track(const std::string& path, HeaderKind kind, unsigned mpeg_frames, unsigned padding,
+                        uint64_t length) {
+    std::vector<unsigned char> data;
+    if (kind == HEADER_ITUNSMPB) append_itunsmpb(&data, ENCODER_DELAY, padding, length);
+
+    // MPEG-1 Layer III, 128 kbit/s, 44.1 kHz, stereo: 417 bytes per frame
+    size_t frame_start = data.size();
+    data.insert(data.end(), { 0xff, 0xfb, 0x90, 0x00 });
+    data.resize(frame_start + 4 + 32, 0);                   // Side information
+    data.insert(data.end(), { 'I', 'n', 'f', 'o' });
+    append_be32(&data, 1);                                  // Frame count follows
+    append_be32(&data, mpeg_frames);
+    if (kind != HEADER_ITUNSMPB) {
+        size_t lame = data.size();
+        const char* encoder = "LAME3.100";
+        data.insert(data.end(), encoder, encoder + 9);
+        data.resize(lame + 36, 0);
+        data[lame + 21] = (unsigned char)(ENCODER_DELAY >> 4);
+        data[lame + 22] = (unsigned char)(((ENCODER_DELAY & 0x0f) << 4) | (padding >> 8));
+        data[lame + 23] = (unsigned char)(padding & 0xff);
+    }
+    data.resize(frame_start + 417, 0);
+    data.resize(data.size() + (size_t)mpeg_frames * 417, 0);
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        perror("gapless_test: Failed to write track");
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (fclose(f) != 0) ok = false;
+    return ok;
+}
+
+// Interleaved stereo, as miniaudio hands it to the decoder thread
+static void decode_track(HeaderKind kind, unsigned mpeg_frames, uint64_t first_frame, unsigned length,
+                         std::vector<float>* pcm) {
+    unsigned info_frame = kind == HEADER_DECODER ? 0 : FRAME_SAMPLES;
+    unsigned lead = kind == HEADER_DECODER ? 0 : DECODER_DELAY + ENCODER_DELAY;
+    unsigned total = kind == HEADER_DECODER ? length : info_frame + mpeg_frames * FRAME_SAMPLES;
+
+    pcm->clear();
+    for (unsigned i = 0; i < total; ++i) {
+        float value;
+        if (i < info_frame) {
+            value = 0.0f;                                   // The Info frame is digital silence
+        } else if (i < info_frame + lead) {
+            value = 0.01f * (float)sin(i * 0.37);           // Encoder warm-up, not silent
+        } else if (i < info_frame + lead + length) {
+            value = (float)sine(first_frame + i - info_frame - lead);
+        } else {
+            value = 0.02f;                                  // Padding
+        }
+        pcm->push_back(value);
+        pcm->push_back(value);
+    }
+}
+
+// Join the album through the trimmer and check every seam. Returns the
+// number of failed checks.
+static int check_album(const std::string& directory, HeaderKind kind) {
+    printf("%s:\n", HEADER_NAMES[kind]);
+    std::string path = directory + "/gapless_test.mp3";
+    std::vector<float> joined;
+    std::vector<uint64_t> seams;
+    std::vector<float> pcm;
+    uint64_t expected = 0;
+    int block = 0;
+
+    for (int track = 0; track < TRACK_COUNT; ++track) {
+        unsigned length = TRACK_FRAMES[track];
+        // LAME pads at least the decoder delay, which shifts the end out
+        unsigned mpeg_frames = (ENCODER_DELAY + length + DECODER_DELAY + FRAME_SAMPLES - 1) / FRAME_SAMPLES;
+        unsigned padding = mpeg_frames * FRAME_SAMPLES - ENCODER_DELAY - length;
+        if (!write_track(path, kind, mpeg_frames, padding, length)) return 1;
+
+        GaplessInfo info;
+        if (!read_gapless_info(path.c_str(), &info)) {
+            printf("  track %d: no gapless info found\n", track + 1);
+            return 1;
+        }
+        decode_track(kind, mpeg_frames, expected, length, &pcm);
+
+        GaplessTrimmer trimmer;
+        trimmer.start(&info, SAMPLE_RATE);
+        size_t frames = pcm.size() / 2;
+        for (size_t pos = 0; pos < frames && !trimmer.finished();) {
+            size_t count = BLOCK_FRAMES[block++ % BLOCK_SIZES];
+            if (count > frames - pos) count = frames - pos;
+            size_t offset;
+            size_t keep = trimmer.process(&pcm[pos * 2], count, &offset);
+            joined.insert(joined.end(), pcm.begin() + (pos + offset) * 2, pcm.begin() + (pos + offset + keep) * 2);
+            pos += count;
+        }
+        expected += length;
+        if (track + 1 < TRACK_COUNT) seams.push_back(expected);
+    }
+
+    int failures = 0;
+    uint64_t frames = joined.size() / 2;
+    if (frames != expected) {
+        printf("  FAIL: %llu frames joined, %llu expected\n", (unsigned long long)frames,
+               (unsigned long long)expected);
+        return 1;
+    }
+
+    // Largest step between two samples of the sine, plus float rounding
+    double max_step = 2.0 * M_PI * FREQUENCY / SAMPLE_RATE * AMPLITUDE + 1e-6;
+    for (size_t i = 0; i < seams.size(); ++i) {
+        uint64_t seam = seams[i];
+        double step = fabs((double)joined[seam * 2] - joined[(seam - 1) * 2]);
+        // A gap or overlap of even one sample shows as an error against the
+        // continuous sine around the seam
+        double error = 0.0;
+        for (uint64_t f = seam >= 64 ? seam - 64 : 0; f < seam + 64 && f < frames; ++f) {
+            error = fmax(error, fabs(joined[f * 2] - sine(f)));
+            error = fmax(error, fabs(joined[f * 2 + 1] - sine(f)));
+        }
+        bool ok = step <= max_step && error < 1e-6;
+        printf("  seam %d at frame %llu: step %.5f (sine at most %.5f), error %.1e %s\n", (int)i + 1,
+               (unsigned long long)seam, step, max_step, error, ok ? "ok" : "FAIL");
+        if (!ok) ++failures;
+    }
+
+    double error = 0.0;
+    for (uint64_t f = 0; f < frames; ++f) error = fmax(error, fabs(joined[f * 2] - sine(f)));
+    printf("  %llu frames, largest error %.1e %s\n", (unsigned long long)frames, error, error < 1e-6 ? "ok" : "FAIL");
+    if (error >= 1e-6) ++failures;
+
+    remove(path.c_str());
+    return failures;
+}
+
+int main(int argc, char* argv[]) {
+    std::string directory = argc > 1 ? argv[1] : ".";
+    int failures = 0;
+    failures += check_album(directory, HEADER_LAME);
+    failures += check_album(directory, HEADER_ITUNSMPB);
+    failures += check_album(directory, HEADER_DECODER);
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All seams are gapless\n");
+    return 0;
+}
@@ -0,0 +1,162 @@
+// Tag reader check on generated files: a well-formed FLAC must give its
+// title and text tags back, and truncated or hostile ones (lengths that
+// run past the block, or wrap around in 32 bits) must be rejected without
+// reading outside the data. Run it under ASan to catch reads that do not crash.
+//
+// Usage: tag_reader_test [directory for the generated files]
+#include "tag_reader.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+static void append_le32(std::vector<unsigned char>* data, uint32_t value) {
+    data->push_back((unsigned char)value);
+    data->push_back((unsigned char)(value >> 8));
+    data->push_back((unsigned char)(value >> 16));
+    data->push_back((unsigned char)(value >> 24));
+}
+
+static void append_comment(std::vector<unsigned char>* data, const char* comment) {
+    append_le32(data, (uint32_t)strlen(comment));
+    data->insert(data->end(), comment, comment + strlen(comment));
+}
+
+static void append_block_header(std::vector<unsigned char>* data, int type, bool last, uint32_t len) {
+    data->push_back((unsigned char)((last ? 0x80 : 0) | type));
+    data->push_back((unsigned char)(len >> 16));
+    data->push_back((unsigned char)(len >> 8));
+    data->push_back((unsigned char)len);
+}
+
+// fLaC, STREAMINFO for 10 s at 44.1 kHz, then `comments` as the
+// VORBIS_COMMENT block
+static std::vector<unsigned char> make_flac(const std::vector<unsigned char>& comments) {
+    std::vector<unsigned char> data = { 'f', 'L', 'a', 'C' };
+    append_block_header(&data, 0, false, 34);
+    size_t info = data.size();
+    data.resize(info + 34, 0);
+    uint32_t rate = 44100;
+    uint64_t samples = 441000;
+    data[info + 10] = (unsigned char)(rate >> 12);
+    data[info + 11] = (unsigned char)(rate >> 4);
+    data[info + 12] = (unsigned char)((rate & 0x0f) << 4);
+    data[info + 13] = (unsigned char)((samples >> 32) & 0x0f);
+    data[info + 14] = (unsigned char)(samples >> 24);
+    data[info + 15] = (unsigned char)(samples >> 16);
+    data[info + 16] = (unsigned char)(samples >> 8);
+    data[info + 17] = (unsigned char)samples;
+    append_block_header(&data, 4, true, (uint32_t)comments.size());
+    data.insert(data.end(), comments.begin(), comments.end());
+    return data;
+}
+
+static std::vector<unsigned char> good_comments() {
+    std::vector<unsigned char> data;
+    append_comment(&data, "reference libFLAC 1.4.3");
+    append_le32(&data, 4);
+    append_comment(&data, "TITLE=Song");
+    append_comment(&data, "ARTIST=Band");
+    append_comment(&data, "TRACKNUMBER=3/12");
+    append_comment(&data, "REPLAYGAIN_TRACK_GAIN=-6.50 dB");
+    return data;
+}
+
+static bool write_file(const std::string& path, const std::vector<unsigned char>& data) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        perror("tag_reader_test: Failed to write file");
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    if (fclose(f) != 0) ok = false;
+    return ok;
+}
+
+static void collect_tag(const char* key, const char* value, void* user_data) {
+    std::string* tags = static_cast<std::string*>(user_data);
+    *tags += std::string(key) + "=" + value + ";";
+}
+
+struct Case {
+    const char* name;
+    std::vector<unsigned char> data;
+    const char* title;      // Expected from read_track_info()
+    const char* tags;       // Expected from read_text_tags()
+};
+
+int main(int argc, char* argv[]) {
+    std::string directory = argc > 1 ? argv[1] : ".";
+    std::string path = directory + "/tag_reader_test.flac";
+    std::vector<Case> cases;
+
+    cases.push_back({ "well-formed", make_flac(good_comments()), "Song",
+                      "TITLE=Song;ARTIST=Band;TRACKNUMBER=3/12;REPLAYGAIN_TRACK_GAIN=-6.50 dB;" });
+
+    // Vendor lengths that wrap vendor_len + 4 to 0..3
+    const uint32_t wrapping[] = { 0xfffffffc, 0xfffffffd, 0xffffffff };
+    for (size_t i = 0; i < sizeof(wrapping) / sizeof(wrapping[0]); ++i) {
+        std::vector<unsigned char> comments;
+        append_le32(&comments, wrapping[i]);
+        append_le32(&comments, 1);
+        append_comment(&comments, "TITLE=Wrapped");
+        cases.push_back({ "vendor length wraps", make_flac(comments), "", "" });
+    }
+
+    // Vendor string longer than the block
+    std::vector<unsigned char> long_vendor;
+    append_le32(&long_vendor, 100);
+    append_le32(&long_vendor, 0);
+    cases.push_back({ "vendor past the block", make_flac(long_vendor), "", "" });
+
+    // Comment lengths past the block, and one that wraps a 32-bit sum
+    std::vector<unsigned char> long_comment;
+    append_comment(&long_comment, "vendor");
+    append_le32(&long_comment, 2);
+    append_comment(&long_comment, "TITLE=First");
+    append_le32(&long_comment, 0xffffffff);
+    long_comment.insert(long_comment.end(), { 'A', '=', 'B' });
+    cases.push_back({ "comment past the block", make_flac(long_comment), "First", "TITLE=First;" });
+
+    // More comments announced than there are
+    std::vector<unsigned char> short_count;
+    append_comment(&short_count, "vendor");
+    append_le32(&short_count, 0xffffffff);
+    append_comment(&short_count, "TITLE=Only");
+    cases.push_back({ "comment count too high", make_flac(short_count), "Only", "TITLE=Only;" });
+
+    // Block shorter than its vendor length field, and files cut anywhere
+    // inside the comment block
+    std::vector<unsigned char> tiny = { 1, 0 };
+    cases.push_back({ "block of 2 bytes", make_flac(tiny), "", "" });
+    std::vector<unsigned char> good = make_flac(good_comments());
+    for (size_t cut = good.size() - good_comments().size() - 4; cut < good.size(); cut += 7) {
+        cases.push_back({ "truncated", std::vector<unsigned char>(good.begin(), good.begin() + cut), "", "" });
+    }
+
+    int failures = 0;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const Case& c = cases[i];
+        if (!write_file(path, c.data)) return 1;
+
+        TrackInfo info;
+        std::string tags;
+        bool ok = read_track_info(path.c_str(), &info) && read_text_tags(path.c_str(), collect_tag, &tags);
+        ok = ok && info.title == c.title && tags == c.tags;
+        if (!ok) {
+            printf("  %s (%zu bytes): title \"%s\", tags \"%s\" FAIL\n", c.name, c.data.size(), info.title.c_str(),
+                   tags.c_str());
+            ++failures;
+        }
+    }
+    remove(path.c_str());
+
+    if (failures > 0) {
+        printf("%d of %zu case(s) failed\n", failures, cases.size());
+        return 1;
+    }
+    printf("All %zu FLAC cases ok\n", cases.size());
+    return 0;
+}
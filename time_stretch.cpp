@@ -0,0 +1,231 @@
+#include "time_stretch.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define STRETCH_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define STRETCH_USE_SSE 1
+#endif
+
+constexpr float TimeStretch::MIN_SPEED;
+constexpr float TimeStretch::MAX_SPEED;
+
+// Output hop and overlap length (~11.6 ms at 44.1 kHz). Segments are two
+// hops long, so every output frame is a cross-fade of two segments.
+static const size_t HOP = 512;
+
+// How far (in frames) from the nominal position the best match is searched
+static const size_t TOLERANCE = 384;
+
+// The search first tries every COARSE_STEP-th offset, then refines around
+// the best one. Cross-correlation of music is smooth enough for this and it
+// cuts the search cost by ~4x.
+static const size_t COARSE_STEP = 4;
+
+// Buffered input is compacted once this many frames are no longer needed
+static const size_t COMPACT_THRESHOLD = 8192;
+
+TimeStretch::TimeStretch()
+    : speed(1.0f), input_frames(0), input_offset(0.0), started(false), prev(0), nominal(0.0)
+{
+    fade_in.resize(HOP);
+    for (size_t i = 0; i < HOP; ++i) {
+        double s = sin(M_PI / 2.0 * (i + 0.5) / HOP);
+        fade_in[i] = (float)(s * s);
+    }
+}
+
+void TimeStretch::set_speed(float s) {
+    if (s < MIN_SPEED) s = MIN_SPEED;
+    if (s > MAX_SPEED) s = MAX_SPEED;
+    // Snap values that round to 1.0x so the pass-through path is used
+    if (fabsf(s - 1.0f) < 0.005f) s = 1.0f;
+    speed = s;
+}
+
+float TimeStretch::get_speed() const {
+    return speed;
+}
+
+double TimeStretch::media_position() const {
+    if (!started) return input_offset;
+    return input_offset + prev + HOP;
+}
+
+void TimeStretch::reset() {
+    input.clear();
+    mono.clear();
+    input_frames = 0;
+    input_offset = 0.0;
+    started = false;
+    prev = 0;
+    nominal = 0.0;
+}
+
+// Cross-correlation of `a` and `b`, and energy of `b`, over n samples
+static void correlate(const float* a, const float* b, size_t n, float* corr, float* energy) {
+    size_t i = 0;
+    const size_t n4 = n & ~(size_t)3;
+    float c = 0.0f, e = 0.0f;
+#if STRETCH_USE_SSE
+    __m128 vc = _mm_setzero_ps(), ve = _mm_setzero_ps();
+    for (; i < n4; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vb = _mm_loadu_ps(b + i);
+        vc = _mm_add_ps(vc, _mm_mul_ps(va, vb));
+        ve = _mm_add_ps(ve, _mm_mul_ps(vb, vb));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vc);
+    c = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_ps(lanes, ve);
+    e = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif STRETCH_USE_NEON
+    float32x4_t vc = vdupq_n_f32(0.0f), ve = vdupq_n_f32(0.0f);
+    for (; i < n4; i += 4) {
+        float32x4_t va = vld1q_f32(a + i);
+        float32x4_t vb = vld1q_f32(b + i);
+        vc = vmlaq_f32(vc, va, vb);
+        ve = vmlaq_f32(ve, vb, vb);
+    }
+    float32x2_t fc = vadd_f32(vget_low_f32(vc), vget_high_f32(vc));
+    float32x2_t fe = vadd_f32(vget_low_f32(ve), vget_high_f32(ve));
+    c = vget_lane_f32(vpadd_f32(fc, fc), 0);
+    e = vget_lane_f32(vpadd_f32(fe, fe), 0);
+#endif
+    for (; i < n; ++i) {
+        c += a[i] * b[i];
+        e += b[i] * b[i];
+    }
+    *corr = c;
+    *energy = e;
+}
+
+// Offset in [lo, hi] whose first hop best matches the one at `target`
+size_t TimeStretch::best_offset(size_t target, size_t lo, size_t hi) const {
+    const float* ref = &mono[target];
+    size_t best = lo;
+    float best_score = -HUGE_VALF;
+
+    for (size_t pos = lo; pos <= hi; pos += COARSE_STEP) {
+        float corr, energy;
+        correlate(ref, &mono[pos], HOP, &corr, &energy);
+        float score = corr / sqrtf(energy + 1e-9f);
+        if (score > best_score) {
+            best_score = score;
+            best = pos;
+        }
+    }
+
+    size_t fine_lo = best > lo + COARSE_STEP ? best - COARSE_STEP + 1 : lo;
+    size_t fine_hi = best + COARSE_STEP - 1 < hi ? best + COARSE_STEP - 1 : hi;
+    size_t coarse_best = best;
+    for (size_t pos = fine_lo; pos <= fine_hi; ++pos) {
+        if (pos == coarse_best) continue;
+        float corr, energy;
+        correlate(ref, &mono[pos], HOP, &corr, &energy);
+        float score = corr / sqrtf(energy + 1e-9f);
+        if (score > best_score) {
+            best_score = score;
+            best = pos;
+        }
+    }
+    return best;
+}
+
+// Output one hop: fade out the previous segment, fade in the one at `pos`
+void TimeStretch::emit_hop(size_t pos, std::vector<float>* out) {
+    size_t base = out->size();
+    out->resize(base + HOP * 2);
+    float* dst = &(*out)[base];
+    const float* from = &input[(prev + HOP) * 2];
+    const float* to = &input[pos * 2];
+    for (size_t i = 0; i < HOP; ++i) {
+        float f = fade_in[i];
+        dst[i * 2] = from[i * 2] + (to[i * 2] - from[i * 2]) * f;
+        dst[i * 2 + 1] = from[i * 2 + 1] + (to[i * 2 + 1] - from[i * 2 + 1]) * f;
+    }
+}
+
+// Output all buffered input from `from` on as-is and leave stretch mode
+void TimeStretch::emit_raw(size_t from, std::vector<float>* out) {
+    if (from < input_frames) {
+        out->insert(out->end(), input.begin() + from * 2, input.begin() + input_frames * 2);
+    }
+    input_offset += input_frames;
+    input.clear();
+    mono.clear();
+    input_frames = 0;
+    started = false;
+    prev = 0;
+    nominal = 0.0;
+}
+
+void TimeStretch::discard_before(size_t pos) {
+    if (pos < COMPACT_THRESHOLD) return;
+    input.erase(input.begin(), input.begin() + pos * 2);
+    mono.erase(mono.begin(), mono.begin() + pos);
+    input_frames -= pos;
+    input_offset += pos;
+    prev -= pos;
+    nominal -= pos;
+}
+
+void TimeStretch::process(const float* in, size_t frames, std::vector<float>* out) {
+    float s = speed;
+
+    if (!started && input_frames == 0 && s == 1.0f) {
+        out->insert(out->end(), in, in + frames * 2);
+        input_offset += frames;
+        return;
+    }
+
+    input.insert(input.end(), in, in + frames * 2);
+    mono.resize(input_frames + frames);
+    for (size_t i = 0; i < frames; ++i) {
+        mono[input_frames + i] = in[i * 2] + in[i * 2 + 1];
+    }
+    input_frames += frames;
+
+    if (!started) {
+        // The first hop is played as-is and becomes the "previous segment"
+        if (input_frames < HOP * 2) return;
+        out->insert(out->end(), input.begin(), input.begin() + HOP * 2);
+        started = true;
+        prev = 0;
+        nominal = 0.0;
+    }
+
+    while (true) {
+        s = speed;
+        if (s == 1.0f) {
+            // The natural continuation of the last segment is exactly the
+            // unstretched signal, so dropping back to 1.0x is seamless.
+            emit_raw(prev + HOP, out);
+            return;
+        }
+
+        double next = nominal + HOP * s;
+        size_t target = (size_t)(next + 0.5);
+        size_t lo = target > TOLERANCE ? target - TOLERANCE : 0;
+        size_t hi = target + TOLERANCE;
+        if (hi + HOP > input_frames || prev + HOP * 2 > input_frames) break;
+
+        size_t pos = best_offset(prev + HOP, lo, hi);
+        emit_hop(pos, out);
+        prev = pos;
+        nominal = next;
+    }
+
+    size_t keep = prev + HOP;
+    size_t lowest_next = nominal > TOLERANCE ? (size_t)nominal - TOLERANCE : 0;
+    if (lowest_next < keep) keep = lowest_next;
+    discard_before(keep);
+}
+
+void TimeStretch::flush(std::vector<float>* out) {
+    emit_raw(started ? prev + HOP : 0, out);
+}
@@ -0,0 +1,59 @@
+#ifndef TIME_STRETCH_H
+#define TIME_STRETCH_H
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+// --- TimeStretch Class ---
+// Pitch-preserving speed change (WSOLA) for interleaved stereo float PCM.
+// Each output hop cross-fades the natural continuation of the previous
+// segment with the input segment, near the nominal read position, that
+// matches it best. At speed 1.0 the stage is a plain pass-through.
+class TimeStretch {
+public:
+    static constexpr float MIN_SPEED = 0.5f;
+    static constexpr float MAX_SPEED = 2.0f;
+
+    TimeStretch();
+
+    // Playback speed (1.0 = normal). Safe to call from any thread; the
+    // audio thread picks it up on the next hop, without restarting.
+    void set_speed(float speed);
+    float get_speed() const;
+
+    // Consume `frames` input frames and append the stretched output to `out`
+    // (interleaved stereo). Audio thread only.
+    void process(const float* in, size_t frames, std::vector<float>* out);
+
+    // End of input: append whatever is still buffered to `out`.
+    void flush(std::vector<float>* out);
+
+    // Media (input) frame that the next output frame corresponds to.
+    double media_position() const;
+
+    // Drop all buffered audio and restart at media frame 0.
+    void reset();
+
+private:
+    std::atomic<float> speed;
+
+    // Input not yet fully consumed, stereo and mono (L+R) for the search
+    std::vector<float> input;
+    std::vector<float> mono;
+    size_t input_frames;
+    double input_offset;    // Media frame of input[0]
+
+    bool started;           // False while passing through at 1.0x
+    size_t prev;            // Start of the last segment used (input frames)
+    double nominal;         // Ideal start of the next segment
+
+    std::vector<float> fade_in;
+
+    size_t best_offset(size_t target, size_t lo, size_t hi) const;
+    void emit_hop(size_t pos, std::vector<float>* out);
+    void emit_raw(size_t from, std::vector<float>* out);
+    void discard_before(size_t pos);
+};
+
+#endif // TIME_STRETCH_H
@@ -0,0 +1,95 @@
+// Build step of the "icons" target: dither a PNG icon to the 16 gray
+// levels of the Kindle's e-ink panel before gdk-pixbuf-csource turns it
+// into pixdata.
+//
+// The icons are black shapes with antialiased alpha edges. Blended over
+// the white UI, an edge pixel with an arbitrary alpha lands between two
+// panel levels, and the display controller rounds it to one of them: the
+// edges come out banded or lose their thinnest pixels. Here the gray and
+// the alpha channel are both error-diffused (Floyd-Steinberg) to multiples
+// of 17, so every blended pixel is a level the panel can show as is, and
+// the average coverage along an edge is kept.
+//
+// Usage: icon_dither <in.png> <out.png>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+// 0, 17, ..., 255
+static const int PANEL_LEVELS = 16;
+static const int LEVEL_STEP = 255 / (PANEL_LEVELS - 1);
+
+// Error-diffuse one channel of the image to the panel levels, in place.
+// Values and errors are kept in 1/16ths, the denominator of the
+// Floyd-Steinberg weights.
+static void dither_channel(guchar* pixels, int width, int height, int rowstride, int n_channels, int channel) {
+    std::vector<int> error(width + 2, 0), next_error(width + 2, 0);
+    for (int y = 0; y < height; ++y) {
+        guchar* p = pixels + y * rowstride + channel;
+        for (int x = 0; x < width; ++x, p += n_channels) {
+            int value = *p * 16 + error[x + 1];
+            int level = (value + LEVEL_STEP * 8) / (LEVEL_STEP * 16);
+            *p = (guchar)(CLAMP(level, 0, PANEL_LEVELS - 1) * LEVEL_STEP);
+            int diff = value - *p * 16;
+            error[x + 2] += diff * 7 / 16;
+            next_error[x] += diff * 3 / 16;
+            next_error[x + 1] += diff * 5 / 16;
+            next_error[x + 2] += diff / 16;
+        }
+        error.swap(next_error);
+        std::fill(next_error.begin(), next_error.end(), 0);
+    }
+}
+
+// The panel is gray only: keep the luminance in all three color channels
+static void make_gray(guchar* pixels, int width, int height, int rowstride, int n_channels) {
+    for (int y = 0; y < height; ++y) {
+        guchar* p = pixels + y * rowstride;
+        for (int x = 0; x < width; ++x, p += n_channels) {
+            guchar gray = (guchar)((p[0] * 299 + p[1] * 587 + p[2] * 114 + 500) / 1000);
+            p[0] = p[1] = p[2] = gray;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: icon_dither <in.png> <out.png>\n");
+        return 2;
+    }
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+    g_type_init();
+#endif
+
+    GError* error = NULL;
+    GdkPixbuf* pixbuf = gdk_pixbuf_new_from_file(argv[1], &error);
+    if (!pixbuf) {
+        fprintf(stderr, "icon_dither: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    guchar* pixels = gdk_pixbuf_get_pixels(pixbuf);
+    int width = gdk_pixbuf_get_width(pixbuf);
+    int height = gdk_pixbuf_get_height(pixbuf);
+    int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    int n_channels = gdk_pixbuf_get_n_channels(pixbuf);
+    make_gray(pixels, width, height, rowstride, n_channels);
+    dither_channel(pixels, width, height, rowstride, n_channels, 0);
+    for (int y = 0; y < height; ++y) {
+        guchar* p = pixels + y * rowstride;
+        for (int x = 0; x < width; ++x, p += n_channels) p[1] = p[2] = p[0];
+    }
+    if (gdk_pixbuf_get_has_alpha(pixbuf)) dither_channel(pixels, width, height, rowstride, n_channels, 3);
+
+    bool saved = gdk_pixbuf_save(pixbuf, argv[2], "png", &error, NULL);
+    g_object_unref(pixbuf);
+    if (!saved) {
+        fprintf(stderr, "icon_dither: %s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include "track_cache.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+// File layout (host byte order, the cache never leaves the device):
+//   header : "KCCH" | version u32 | record_type u32 | record_size u32 | count u32
+//   entry  : path_len u16 | path | mtime i64 | size i64 | record[record_size]
+// With record_size 0, every record is preceded by its length (u16).
+static const char CACHE_MAGIC[4] = { 'K', 'C', 'C', 'H' };
+static const uint32_t CACHE_VERSION = 1;
+
+// Entries kept at most; a store beyond it drops an arbitrary old one. Far
+// more songs than a Kindle holds, but it bounds what a corrupt count or a
+// churning library can cost.
+static const size_t MAX_ENTRIES = 100000;
+
+static bool stat_file(const char* filepath, int64_t* mtime, int64_t* size) {
+    struct stat st;
+    if (stat(filepath, &st) != 0) return false;
+    *mtime = (int64_t)st.st_mtime;
+    *size = (int64_t)st.st_size;
+    return true;
+}
+
+TrackCache::TrackCache(uint32_t record_type, uint32_t record_size)
+    : record_type(record_type), record_size(record_size), dirty(false), pruned(false)
+{
+}
+
+bool TrackCache::load(const std::string& path) {
+    std::lock_guard<std::mutex> guard(lock);
+    cache_path = path;
+    entries.clear();
+    dirty = false;
+    pruned = false;
+
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    char magic[4];
+    uint32_t header[4];
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, CACHE_MAGIC, 4) != 0 ||
+        fread(header, sizeof(uint32_t), 4, f) != 4 ||
+        header[0] != CACHE_VERSION || header[1] != record_type || header[2] != record_size) {
+        fclose(f);
+        return false;
+    }
+
+    // The count is not trusted for allocation: a corrupt one just ends at
+    // the end of the file
+    uint32_t count = header[3];
+    std::vector<char> path_buf;
+    for (uint32_t i = 0; i < count && entries.size() < MAX_ENTRIES; ++i) {
+        uint16_t path_len;
+        Entry entry;
+        if (fread(&path_len, sizeof(path_len), 1, f) != 1) break;
+        path_buf.resize(path_len);
+        if (fread(path_buf.data(), 1, path_len, f) != path_len ||
+            fread(&entry.mtime, sizeof(entry.mtime), 1, f) != 1 ||
+            fread(&entry.size, sizeof(entry.size), 1, f) != 1) {
+            break; // Truncated file: keep what we have
+        }
+        uint16_t data_len = (uint16_t)record_size;
+        if (record_size == 0 && fread(&data_len, sizeof(data_len), 1, f) != 1) break;
+        entry.data.resize(data_len);
+        if (data_len > 0 && fread(&entry.data[0], 1, data_len, f) != data_len) break;
+        entries[std::string(path_buf.data(), path_len)] = entry;
+    }
+    fclose(f);
+    return true;
+}
+
+// `lock` is only held to copy the table and to apply the result: the loudness
+// scanner saves from its idle-priority thread, and a playback thread in
+// lookup()/store() must not wait behind its stats and writes to flash.
+bool TrackCache::save() {
+    std::lock_guard<std::mutex> save_guard(save_lock);
+    std::unordered_map<std::string, Entry> snapshot;
+    std::string path;
+    bool changed, prune;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (cache_path.empty()) return true;
+        changed = dirty;
+        // Once per load: it stats every file
+        prune = !pruned;
+        if (!changed && !prune) return true;
+        snapshot = entries;
+        path = cache_path;
+        pruned = true;
+        dirty = false; // A store() from here on marks it again
+    }
+
+    // Drop the entries of files that are gone or changed since they were
+    // stored; nothing else ever removes them
+    if (prune) {
+        std::vector<std::string> stale;
+        for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+            int64_t mtime, size;
+            if (!stat_file(it->first.c_str(), &mtime, &size) || mtime != it->second.mtime || size != it->second.size) {
+                stale.push_back(it->first);
+            }
+        }
+        if (!stale.empty()) {
+            std::lock_guard<std::mutex> guard(lock);
+            for (size_t i = 0; i < stale.size(); ++i) {
+                // Unless it was stored again in the meantime
+                auto it = entries.find(stale[i]);
+                const Entry& old = snapshot[stale[i]];
+                if (it != entries.end() && it->second.mtime == old.mtime && it->second.size == old.size) {
+                    entries.erase(it);
+                }
+                snapshot.erase(stale[i]);
+            }
+            changed = true;
+        }
+        if (!changed) return true;
+    }
+
+    std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    bool ok = f != NULL;
+    if (f) {
+        uint32_t header[4] = { CACHE_VERSION, record_type, record_size, (uint32_t)snapshot.size() };
+        ok = fwrite(CACHE_MAGIC, 1, 4, f) == 4 && fwrite(header, sizeof(uint32_t), 4, f) == 4;
+        for (auto it = snapshot.begin(); ok && it != snapshot.end(); ++it) {
+            uint16_t path_len = (uint16_t)it->first.size();
+            uint16_t data_len = (uint16_t)it->second.data.size();
+            ok = fwrite(&path_len, sizeof(path_len), 1, f) == 1 &&
+                 fwrite(it->first.data(), 1, path_len, f) == path_len &&
+                 fwrite(&it->second.mtime, sizeof(int64_t), 1, f) == 1 &&
+                 fwrite(&it->second.size, sizeof(int64_t), 1, f) == 1 &&
+                 (record_size != 0 || fwrite(&data_len, sizeof(data_len), 1, f) == 1) &&
+                 fwrite(it->second.data.data(), 1, data_len, f) == data_len;
+        }
+        if (fclose(f) != 0) ok = false;
+    }
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        perror("TrackCache: Failed to write cache");
+        unlink(tmp_path.c_str());
+        std::lock_guard<std::mutex> guard(lock);
+        dirty = true; // Try again on the next save
+        return false;
+    }
+    return true;
+}
+
+bool TrackCache::lookup(const char* filepath, void* record) {
+    int64_t mtime, size;
+    if (!stat_file(filepath, &mtime, &size)) return false;
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = entries.find(filepath);
+    if (it == entries.end() || it->second.mtime != mtime || it->second.size != size) {
+        return false;
+    }
+    memcpy(record, it->second.data.data(), record_size);
+    return true;
+}
+
+void TrackCache::store(const char* filepath, const void* record) {
+    Entry entry;
+    if (!stat_file(filepath, &entry.mtime, &entry.size)) return;
+    if (strlen(filepath) > 0xffff) return;
+    entry.data.assign((const char*)record, record_size);
+
+    std::lock_guard<std::mutex> guard(lock);
+    insert(filepath, entry);
+}
+
+bool TrackCache::lookup(const char* filepath, std::string* record) {
+    int64_t mtime, size;
+    if (!stat_file(filepath, &mtime, &size)) return false;
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = entries.find(filepath);
+    if (it == entries.end() || it->second.mtime != mtime || it->second.size != size) {
+        return false;
+    }
+    *record = it->second.data;
+    return true;
+}
+
+void TrackCache::store(const char* filepath, const std::string& record) {
+    Entry entry;
+    if (!stat_file(filepath, &entry.mtime, &entry.size)) return;
+    if (strlen(filepath) > 0xffff || record.size() > 0xffff) return;
+    entry.data = record;
+
+    std::lock_guard<std::mutex> guard(lock);
+    insert(filepath, entry);
+}
+
+void TrackCache::insert(const char* filepath, const Entry& entry) {
+    if (entries.size() >= MAX_ENTRIES && entries.find(filepath) == entries.end()) {
+        entries.erase(entries.begin());
+    }
+    entries[filepath] = entry;
+    dirty = true;
+}
+
+size_t TrackCache::size() {
+    std::lock_guard<std::mutex> guard(lock);
+    return entries.size();
+}
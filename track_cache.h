@@ -0,0 +1,68 @@
+#ifndef TRACK_CACHE_H
+#define TRACK_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+// --- TrackCache Class ---
+// Small persistent table of per-file analysis results (ReplayGain values,
+// loudness scans, ...). Entries are keyed by path and only returned while
+// the file's mtime and size still match, so edited files get re-analysed.
+// Records are opaque fixed-size blobs owned by the caller, or, with a
+// record size of 0, blobs of any size up to 64 KB (text tags). Entries of
+// files that are gone or changed are dropped on the first save after a
+// load, and the table is capped in size.
+//
+// All methods are thread-safe. save() does its file I/O without blocking
+// lookup() and store().
+class TrackCache {
+public:
+    // `record_type` is a tag stored in the file header; a cache file written
+    // for another record type (or another record size) is ignored on load.
+    TrackCache(uint32_t record_type, uint32_t record_size);
+
+    // Load entries from `cache_path` and remember it for save().
+    // A missing or incompatible file just yields an empty cache.
+    bool load(const std::string& cache_path);
+
+    // Write the table back if it changed since the last load/save.
+    // The file is replaced atomically. The first save after a load stats
+    // every file to prune stale entries.
+    bool save();
+
+    // Copy the record for `filepath` into `record` (record_size bytes).
+    // Returns false if unknown or if the file changed on disk.
+    bool lookup(const char* filepath, void* record);
+
+    // Insert or replace the record for `filepath`.
+    void store(const char* filepath, const void* record);
+
+    // Same for a cache of variable-size records (record_size 0)
+    bool lookup(const char* filepath, std::string* record);
+    void store(const char* filepath, const std::string& record);
+
+    size_t size();
+
+private:
+    struct Entry {
+        int64_t mtime;
+        int64_t size;
+        std::string data;
+    };
+
+    // With `lock` held
+    void insert(const char* filepath, const Entry& entry);
+
+    const uint32_t record_type;
+    const uint32_t record_size;
+    std::string cache_path;
+    std::unordered_map<std::string, Entry> entries;
+    bool dirty;
+    bool pruned;            // Since the last load
+    std::mutex lock;        // Guards everything above
+    std::mutex save_lock;   // One save() at a time; taken before `lock`
+};
+
+#endif // TRACK_CACHE_H
@@ -0,0 +1,80 @@
+#include "track_info_cache.h"
+#include <stdint.h>
+#include <string.h>
+
+// Record type tag for the tag cache file ("TIv1")
+static const uint32_t TAG_CACHE_TYPE = 0x31764954;
+
+// Record layout (host byte order):
+//   duration_ms u32 | track u16 | disc u16 | title \0 | artist \0 | album \0
+static const size_t RECORD_HEADER = 8;
+
+TrackInfoCache::TrackInfoCache()
+    : cache(TAG_CACHE_TYPE, 0)
+{
+}
+
+bool TrackInfoCache::load(const std::string& cache_path) {
+    return cache.load(cache_path);
+}
+
+bool TrackInfoCache::save() {
+    return cache.save();
+}
+
+bool TrackInfoCache::lookup(const char* filepath, TrackInfo* info) {
+    std::string record;
+    return cache.lookup(filepath, &record) && unpack(record, info);
+}
+
+bool TrackInfoCache::get(const char* filepath, TrackInfo* info) {
+    if (lookup(filepath, info)) return true;
+    if (!read_track_info(filepath, info)) return false;
+    cache.store(filepath, pack(*info));
+    return true;
+}
+
+size_t TrackInfoCache::size() {
+    return cache.size();
+}
+
+std::string TrackInfoCache::pack(const TrackInfo& info) {
+    uint32_t duration = info.duration_ms;
+    uint16_t numbers[2] = { (uint16_t)info.track, (uint16_t)info.disc };
+    std::string record((const char*)&duration, 4);
+    record.append((const char*)numbers, 4);
+    record.append(info.title.c_str(), info.title.size() + 1);
+    record.append(info.artist.c_str(), info.artist.size() + 1);
+    record.append(info.album.c_str(), info.album.size() + 1);
+    return record;
+}
+
+bool TrackInfoCache::unpack(const std::string& record, TrackInfo* info) {
+    if (record.size() < RECORD_HEADER + 3 || record[record.size() - 1] != '\0') return false;
+    uint32_t duration;
+    uint16_t numbers[2];
+    memcpy(&duration, record.data(), 4);
+    memcpy(numbers, record.data() + 4, 4);
+    info->duration_ms = duration;
+    info->track = numbers[0];
+    info->disc = numbers[1];
+
+    const char* p = record.c_str() + RECORD_HEADER;
+    const char* end = record.c_str() + record.size();
+    std::string* fields[3] = { &info->title, &info->artist, &info->album };
+    for (int i = 0; i < 3; ++i) {
+        if (p >= end) return false;
+        fields[i]->assign(p);
+        p += fields[i]->size() + 1;
+    }
+    return true;
+}
+
+std::string track_display_name(const TrackInfo& info, const char* filepath) {
+    if (info.title.empty()) {
+        const char* slash = strrchr(filepath, '/');
+        return slash ? slash + 1 : filepath;
+    }
+    if (info.artist.empty()) return info.title;
+    return info.artist + " - " + info.title;
+}
@@ -0,0 +1,44 @@
+#ifndef TRACK_INFO_CACHE_H
+#define TRACK_INFO_CACHE_H
+
+#include <string>
+
+#include "tag_reader.h"
+#include "track_cache.h"
+
+// --- TrackInfoCache Class ---
+// Titles, artists, albums and durations of music files, kept in a
+// TrackCache (~/.kinamp_tags.cache) so the playlist can show them without
+// opening the files again. Entries are keyed by path and only used while
+// the file's mtime and size are unchanged.
+//
+// All methods are thread-safe.
+class TrackInfoCache {
+public:
+    TrackInfoCache();
+
+    // Load the cache file and remember it for save()
+    bool load(const std::string& cache_path);
+    bool save();
+
+    // Cached info only; false if the file is unknown or changed
+    bool lookup(const char* filepath, TrackInfo* info);
+
+    // Cached info, or read from the file and remembered. False if the file
+    // cannot be read.
+    bool get(const char* filepath, TrackInfo* info);
+
+    size_t size();
+
+private:
+    TrackCache cache;
+
+    static std::string pack(const TrackInfo& info);
+    static bool unpack(const std::string& record, TrackInfo* info);
+};
+
+// "Artist - Title", the title alone, or the file name if the tags have no
+// title
+std::string track_display_name(const TrackInfo& info, const char* filepath);
+
+#endif // TRACK_INFO_CACHE_H
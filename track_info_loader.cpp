@@ -0,0 +1,88 @@
+#include "track_info_loader.h"
+#include <stdio.h>
+
+TrackInfoLoader::TrackInfoLoader(TrackInfoCache* cache)
+    : cache(cache), thread_id(0), stop_flag(false), callback(NULL), callback_user_data(NULL)
+{
+}
+
+TrackInfoLoader::~TrackInfoLoader() {
+    stop();
+}
+
+void TrackInfoLoader::set_callback(TrackInfoLoadedCallback cb, void* user_data) {
+    callback = cb;
+    callback_user_data = user_data;
+}
+
+void TrackInfoLoader::request(const std::vector<TrackInfoRequest>& requests) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        // Stale requests (rows scrolled away from) go
+        pending.assign(requests.begin(), requests.end());
+    }
+    wake.notify_one();
+
+    if (thread_id == 0 && !requests.empty()) {
+        stop_flag = false;
+        if (pthread_create(&thread_id, NULL, thread_func, this) != 0) {
+            perror("TrackInfoLoader: Failed to create thread");
+            thread_id = 0;
+        }
+    }
+}
+
+void TrackInfoLoader::take_results(std::vector<TrackInfoResult>* out) {
+    std::lock_guard<std::mutex> guard(lock);
+    out->insert(out->end(), results.begin(), results.end());
+    results.clear();
+}
+
+void TrackInfoLoader::stop() {
+    if (thread_id == 0) return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stop_flag = true;
+        pending.clear();
+    }
+    wake.notify_one();
+    pthread_join(thread_id, NULL);
+    thread_id = 0;
+
+    std::lock_guard<std::mutex> guard(lock);
+    results.clear();
+}
+
+void* TrackInfoLoader::thread_func(void* arg) {
+    static_cast<TrackInfoLoader*>(arg)->load_loop();
+    return NULL;
+}
+
+void TrackInfoLoader::load_loop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        while (!stop_flag && pending.empty()) wake.wait(guard);
+        if (stop_flag) return;
+
+        TrackInfoRequest item = pending.front();
+        pending.pop_front();
+        guard.unlock();
+
+        TrackInfo info;
+        if (!cache->get(item.path.c_str(), &info)) info.title.clear();
+        TrackInfoResult result;
+        result.row = item.row;
+        result.title = track_display_name(info, item.path.c_str());
+        result.path.swap(item.path);
+
+        guard.lock();
+        // One wake-up per batch: the main loop takes everything at once
+        bool first = results.empty();
+        results.push_back(result);
+        if (first && callback) {
+            guard.unlock();
+            callback(callback_user_data);
+            guard.lock();
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef TRACK_INFO_LOADER_H
+#define TRACK_INFO_LOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "track_info_cache.h"
+
+// A playlist row whose title is wanted
+struct TrackInfoRequest {
+    int row;
+    std::string path;
+};
+
+// Title found for a requested row
+struct TrackInfoResult {
+    int row;
+    std::string path;       // To check the row still holds this file
+    std::string title;      // track_display_name()
+};
+
+// Called on the loader thread when results are waiting in take_results().
+// Must not block: hand over to the main loop (g_idle_add).
+typedef void (*TrackInfoLoadedCallback)(void* user_data);
+
+// --- TrackInfoLoader Class ---
+// Reads the tags of playlist rows on a background thread, so the view
+// never waits on the disk. The view asks for the rows it shows (and a
+// little around them); each request replaces the previous one, so rows
+// that were scrolled past before their turn are never read. Requests are
+// served in order, visible rows first.
+//
+// Tags come from the TrackInfoCache when it has them, else from the file,
+// and are added to the cache.
+class TrackInfoLoader {
+public:
+    explicit TrackInfoLoader(TrackInfoCache* cache);
+    ~TrackInfoLoader();
+
+    void set_callback(TrackInfoLoadedCallback callback, void* user_data);
+
+    // Load `requests` in order, instead of whatever was still pending. The
+    // thread is started on the first call.
+    void request(const std::vector<TrackInfoRequest>& requests);
+
+    // Move the results since the last call to the end of `results`
+    void take_results(std::vector<TrackInfoResult>* results);
+
+    // Stop the thread; pending requests and results are dropped
+    void stop();
+
+private:
+    TrackInfoCache* cache;
+    pthread_t thread_id;
+    bool stop_flag;                         // Guarded by `lock`
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<TrackInfoRequest> pending;
+    std::vector<TrackInfoResult> results;
+
+    TrackInfoLoadedCallback callback;
+    void* callback_user_data;
+
+    static void* thread_func(void* arg);
+    void load_loop();
+};
+
+#endif // TRACK_INFO_LOADER_H